@@ -1,44 +1,184 @@
 #include "BVH.h"
 #include <algorithm>
+#include <cstdint>
 
-BVHNode::BVHNode(const std::vector<shared_ptr<hittable>>& src_objects, size_t start, size_t end)
+BVHNode::BVHNode(const std::vector<shared_ptr<hittable>>& src_objects, size_t start, size_t end, 
+	BVHSplitMethod method, size_t maxLeafSize)
 {
-	// 复制一份
-	auto objects = src_objects;
+	// 复制一份, 之后的划分都在这份副本上原地进行, 建好后由所有叶子共享
+	auto objects = make_shared<PrimitiveArray>(src_objects.begin() + start, src_objects.begin() + end);
+	// LinearBVH 等展开后的节点用 16 位保存叶子的图元数, 与 BVHBuilder 相同地限制上限
+	Build(objects, 0, objects->size(), method, std::min<size_t>(std::max<size_t>(maxLeafSize, 1), UINT16_MAX));
+}
+
+void BVHNode::Build(const shared_ptr<PrimitiveArray>& objects, size_t start, size_t end,
+	BVHSplitMethod method, size_t maxLeafSize)
+{
+	auto& array = *objects;
+	size_t obj_span = end - start;
+
+	for (size_t i = start; i < end; ++i)
+		bbox = AABB(bbox, array[i]->BoundingBox());
+
+	size_t mid = start;
+	bool makeLeaf = obj_span <= maxLeafSize;
+	if (method == BVHSplitMethod::SAH && obj_span > 1)
+	{
+		double splitCost;
+		mid = SplitSAH(array, start, end, bbox, splitCost);
+		// 图元数不超过上限时, 只有划分比逐个求交更划算才继续划分
+		makeLeaf = makeLeaf && IntersectionCost * obj_span <= splitCost;
+	}
+	else if (!makeLeaf)
+	{
+		mid = SplitMedian(array, start, end);
+	}
+
+	if (makeLeaf)
+	{
+		primitives = objects;
+		primitiveStart = start;
+		primitiveCount = obj_span;
+		return;
+	}
 
+	left = shared_ptr<BVHNode>(new BVHNode());
+	right = shared_ptr<BVHNode>(new BVHNode());
+	left->Build(objects, start, mid, method, maxLeafSize);
+	right->Build(objects, mid, end, method, maxLeafSize);
+}
+
+size_t BVHNode::SplitMedian(PrimitiveArray& objects, size_t start, size_t end)
+{
 	int axis = random_int(0, 2);
 	auto comparator = (axis == 0) ? box_x_compare :
 						(axis == 1) ? box_y_compare :
 						box_z_compare;
-	
-	size_t obj_span = end - start;
 
-	if (obj_span == 1) 
+	std::sort(objects.begin() + start, objects.begin() + end, comparator);
+	return start + (end - start) / 2;
+}
+
+size_t BVHNode::SplitSAH(PrimitiveArray& objects, size_t start, size_t end, const AABB& bounds, double& cost)
+{
+	constexpr int kBinCount = 16;
+
+	struct Bin
+	{
+		AABB bounds;
+		size_t count = 0;
+	};
+
+	// 按图元包围盒中心分桶
+	AABB centroidBounds;
+	for (size_t i = start; i < end; ++i)
 	{
-		left = right = objects[start];
+		auto c = objects[i]->BoundingBox().Centroid();
+		centroidBounds = AABB(centroidBounds, AABB(c, c));
 	}
-	else if (obj_span == 2) 
+
+	auto binIndex = [&](const point3& c, int axis)
+	{
+		const interval& extent = centroidBounds.axis(axis);
+		int b = static_cast<int>(kBinCount * (c[axis] - extent.min) / extent.size());
+		return std::min(b, kBinCount - 1);
+	};
+
+	double bestCost = infinity;
+	int bestAxis = -1;
+	int bestBin = 0;
+
+	for (int axis = 0; axis < 3; ++axis)
 	{
-		if (comparator(objects[start], objects[start + 1])) 
+		if (centroidBounds.axis(axis).size() <= 0)
+			continue;
+
+		Bin bins[kBinCount];
+		for (size_t i = start; i < end; ++i)
 		{
-			left = objects[start];
-			right = objects[start + 1];
+			auto box = objects[i]->BoundingBox();
+			auto& bin = bins[binIndex(box.Centroid(), axis)];
+			bin.bounds = AABB(bin.bounds, box);
+			bin.count++;
 		}
-		else 
+
+		// 从右往左累计右侧的面积和图元数
+		double rightArea[kBinCount];
+		size_t rightCount[kBinCount];
+		AABB accum;
+		size_t count = 0;
+		for (int b = kBinCount - 1; b > 0; --b)
 		{
-			left = objects[start + 1];
-			right = objects[start];
+			accum = AABB(accum, bins[b].bounds);
+			count += bins[b].count;
+			rightArea[b] = accum.SurfaceArea();
+			rightCount[b] = count;
+		}
+
+		// 再从左往右扫描, 在第 b 个桶之后划分
+		accum = AABB();
+		count = 0;
+		for (int b = 0; b < kBinCount - 1; ++b)
+		{
+			accum = AABB(accum, bins[b].bounds);
+			count += bins[b].count;
+			if (count == 0 || rightCount[b + 1] == 0)
+				continue;
+
+			double cost = count * accum.SurfaceArea() + rightCount[b + 1] * rightArea[b + 1];
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestAxis = axis;
+				bestBin = b;
+			}
 		}
 	}
-	else 
+
+	size_t mid = start + (end - start) / 2;
+	double area = bounds.SurfaceArea();
+	cost = (bestAxis >= 0 && area > 0) ? TraversalCost + IntersectionCost * bestCost / area : infinity;
+	if (bestAxis < 0)
+		return mid;	// 所有中心重合, 任意划分都一样
+
+	auto it = std::partition(objects.begin() + start, objects.begin() + end,
+		[&](const shared_ptr<hittable>& object)
+		{
+			return binIndex(object->BoundingBox().Centroid(), bestAxis) <= bestBin;
+		});
+	size_t split = static_cast<size_t>(it - objects.begin());
+
+	return (split == start || split == end) ? mid : split;
+}
+
+double BVHNode::SAHCost() const
+{
+	return NodeCost() / bbox.SurfaceArea();
+}
+
+void BVHNode::Refit()
+{
+	if (IsLeaf())
 	{
-		std::sort(objects.begin() + start, objects.begin() + end, comparator);
-		auto mid = start + obj_span / 2;
-		left = make_shared<BVHNode>(objects, start, mid);
-		right = make_shared<BVHNode>(objects, mid, end);
+		bbox = AABB();
+		for (size_t i = 0; i < primitiveCount; ++i)
+			bbox = AABB(bbox, (*primitives)[primitiveStart + i]->BoundingBox());
+		return;
 	}
+
+	left->Refit();
+	right->Refit();
 	bbox = AABB(left->BoundingBox(), right->BoundingBox());
+}
 
+double BVHNode::NodeCost() const
+{
+	double area = bbox.SurfaceArea();
+	double cost = TraversalCost * area;
+
+	if (IsLeaf())
+		return cost + IntersectionCost * primitiveCount * area;
+	return cost + left->NodeCost() + right->NodeCost();
 }
 
 bool BVHNode::hit(const Ray& r, interval ray_t, hit_record& rec) const
@@ -46,6 +186,20 @@ bool BVHNode::hit(const Ray& r, interval ray_t, hit_record& rec) const
 	if (!bbox.hit(r, ray_t))
 		return false;
 
+	if (IsLeaf())
+	{
+		bool hitAnything = false;
+		for (size_t i = 0; i < primitiveCount; ++i)
+		{
+			if ((*primitives)[primitiveStart + i]->hit(r, ray_t, rec))
+			{
+				hitAnything = true;
+				ray_t.max = rec.t;
+			}
+		}
+		return hitAnything;
+	}
+
 	bool hitLeft = left->hit(r, ray_t, rec);
 	bool hitRight = right->hit(r, 
 		interval(ray_t.min, hitLeft ? rec.t : ray_t.max),
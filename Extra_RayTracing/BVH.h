@@ -5,24 +5,65 @@
 
 #include "hittable_list.h"
 
-class BVHNode :public hittable 
+// 划分策略
+enum class BVHSplitMethod
+{
+	Median,	// 随机选轴, 按包围盒最小值排序后从中间分开
+	SAH,	// 分桶表面积启发式 (binned surface area heuristic)
+};
+
+class BVHNode :public hittable
 {
 public:
-	BVHNode(const hittable_list& list)
-		: BVHNode(list.objects, 0, list.objects.size()){}
-	BVHNode(const std::vector<shared_ptr<hittable>>& src_objects, size_t start, size_t end);
+	// maxLeafSize: 叶子节点最多容纳的图元数
+	// Median 划分会一直分到不超过该值为止, SAH 只在划分比逐个求交更划算时才继续划分
+	BVHNode(const hittable_list& list, BVHSplitMethod method = BVHSplitMethod::Median,
+		size_t maxLeafSize = DefaultMaxLeafSize)
+		: BVHNode(list.objects, 0, list.objects.size(), method, maxLeafSize){}
+	BVHNode(const std::vector<shared_ptr<hittable>>& src_objects, size_t start, size_t end,
+		BVHSplitMethod method = BVHSplitMethod::Median, size_t maxLeafSize = DefaultMaxLeafSize);
 
 	bool hit(const Ray& r, interval ray_t, hit_record& rec)const;
 	AABB BoundingBox()const override { return bbox; }
 
+	// 整棵树的 SAH 代价: 每个节点按 面积/根节点面积 的概率被访问,
+	// 访问一次花费一次包围盒测试加上对子图元的求交
+	double SAHCost()const;
+
+	// 图元移动后保持拓扑不变, 自底向上重新计算包围盒, 避免重新复制和排序整个图元数组
+	// 是否需要重建由调用者根据 SAHCost() 的变化决定
+	void Refit();
+
+	bool IsLeaf()const { return primitiveCount > 0; }
+
+	static constexpr double TraversalCost = 1.0;
+	static constexpr double IntersectionCost = 1.0;
+	static constexpr size_t DefaultMaxLeafSize = 4;
+
 private:
+	friend class LinearBVH;
+
+	BVHNode() = default;
+
+	using PrimitiveArray = std::vector<shared_ptr<hittable>>;
+
+	// 在 objects 上原地划分, 构建 [start, end) 的子树
+	void Build(const shared_ptr<PrimitiveArray>& objects, size_t start, size_t end,
+		BVHSplitMethod method, size_t maxLeafSize);
+
+	static size_t SplitMedian(PrimitiveArray& objects, size_t start, size_t end);
+	// cost 返回最佳划分的 SAH 代价 (相对于本节点面积), 没有可用划分时为 infinity
+	static size_t SplitSAH(PrimitiveArray& objects, size_t start, size_t end, const AABB& bounds, double& cost);
+
+	double NodeCost()const;
+
 	static bool box_compare(
-		const shared_ptr<hittable> a, const shared_ptr<hittable> b, int axis_index) 
+		const shared_ptr<hittable> a, const shared_ptr<hittable> b, int axis_index)
 	{
 		return a->BoundingBox().axis(axis_index).min < b->BoundingBox().axis(axis_index).min;
 	}
 	static bool box_x_compare(
-		const shared_ptr<hittable> a, const shared_ptr<hittable> b) 
+		const shared_ptr<hittable> a, const shared_ptr<hittable> b)
 	{
 		return box_compare(a, b, 0);
 	}
@@ -38,8 +79,15 @@ private:
 	}
 
 private:
-	shared_ptr<hittable> left;
-	shared_ptr<hittable> right;
+	// 内部节点
+	shared_ptr<BVHNode> left;
+	shared_ptr<BVHNode> right;
+
+	// 叶子节点: 引用所有叶子共享的有序图元数组中的一段
+	shared_ptr<const PrimitiveArray> primitives;
+	size_t primitiveStart = 0;
+	size_t primitiveCount = 0;
+
 	AABB bbox;
 };
 
@@ -0,0 +1,372 @@
+#include "BVHBuilder.h"
+#include "Common/ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <memory>
+
+namespace
+{
+	constexpr int kBinCount = 16;
+	// 图元数超过该值的子树作为单独的任务交给线程池
+	constexpr uint32_t kParallelThreshold = 16 * 1024;
+	// 并行计算图元包围盒时每个任务处理的图元数
+	constexpr size_t kBoundsChunkSize = 64 * 1024;
+
+	constexpr float kFloatInfinity = std::numeric_limits<float>::infinity();
+
+	// 表面积的一半, 只用来比较大小
+	float HalfArea(const float boundsMin[3], const float boundsMax[3])
+	{
+		float dx = boundsMax[0] - boundsMin[0];
+		float dy = boundsMax[1] - boundsMin[1];
+		float dz = boundsMax[2] - boundsMin[2];
+		return dx * dy + dy * dz + dz * dx;
+	}
+}
+
+float RoundDown(double v)
+{
+	float f = static_cast<float>(v);
+	return (f > v) ? std::nextafter(f, -kFloatInfinity) : f;
+}
+
+float RoundUp(double v)
+{
+	float f = static_cast<float>(v);
+	return (f < v) ? std::nextafter(f, kFloatInfinity) : f;
+}
+
+void RefitLinearBVH(std::vector<LinearBVHNode>& nodes, const std::function<AABB(size_t)>& primitiveBounds)
+{
+	// 深度优先排列中子节点总在父节点之后, 倒序遍历即可保证先处理子节点
+	for (size_t i = nodes.size(); i-- > 0;)
+	{
+		auto& node = nodes[i];
+		if (node.primitiveCount > 0)
+		{
+			AABB box = primitiveBounds(node.primitivesOffset);
+			for (uint32_t k = 1; k < node.primitiveCount; ++k)
+				box = AABB(box, primitiveBounds(node.primitivesOffset + k));
+			for (int a = 0; a < 3; ++a)
+			{
+				node.boundsMin[a] = RoundDown(box.axis(a).min);
+				node.boundsMax[a] = RoundUp(box.axis(a).max);
+			}
+		}
+		else
+		{
+			const auto& first = nodes[i + 1];
+			const auto& second = nodes[node.secondChildOffset];
+			for (int a = 0; a < 3; ++a)
+			{
+				node.boundsMin[a] = std::min(first.boundsMin[a], second.boundsMin[a]);
+				node.boundsMax[a] = std::max(first.boundsMax[a], second.boundsMax[a]);
+			}
+		}
+	}
+}
+
+double LinearBVHSAHCost(const std::vector<LinearBVHNode>& nodes)
+{
+	if (nodes.empty())
+		return 0;
+
+	double cost = 0;
+	for (const auto& node : nodes)
+		cost += HalfArea(node.boundsMin, node.boundsMax) * (BVHNode::TraversalCost + BVHNode::IntersectionCost * node.primitiveCount);
+	return cost / HalfArea(nodes[0].boundsMin, nodes[0].boundsMax);
+}
+
+BVHBuilder::BVHBuilder(BVHSplitMethod method, size_t maxLeafSize, int threadCount)
+	:method(method), maxLeafSize(std::min<size_t>(std::max<size_t>(maxLeafSize, 1), UINT16_MAX)),
+	threadCount(threadCount)
+{
+}
+
+void BVHBuilder::Build(size_t primitiveCount, const std::function<AABB(size_t)>& primitiveBounds,
+	std::vector<LinearBVHNode>& nodes, std::vector<uint32_t>& primitiveIndices)
+{
+	auto startTime = std::chrono::steady_clock::now();
+	stats = BVHBuildStats();
+	nodes.clear();
+	primitiveIndices.resize(primitiveCount);
+	if (primitiveCount == 0)
+		return;
+
+	// 图元数不到 kParallelThreshold 时不会产生并行的子树, 直接在当前线程构建,
+	// 每帧 Rebuild() 的小场景和 PackSpheres() 不必每次启动和回收全部硬件线程
+	std::unique_ptr<ThreadPool> threadPool;
+	if (primitiveCount >= kParallelThreshold)
+	{
+		threadPool = std::make_unique<ThreadPool>(threadCount);
+		pool = threadPool.get();
+	}
+
+	// 每个图元的包围盒只取一次, 转成 float 保存
+	primitives.resize(primitiveCount);
+	auto fetchBounds = [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; ++i)
+		{
+			auto box = primitiveBounds(i);
+			for (int a = 0; a < 3; ++a)
+			{
+				primitives[i].boundsMin[a] = RoundDown(box.axis(a).min);
+				primitives[i].boundsMax[a] = RoundUp(box.axis(a).max);
+			}
+			primitives[i].index = static_cast<uint32_t>(i);
+		}
+	};
+	if (pool)
+	{
+		for (size_t begin = 0; begin < primitiveCount; begin += kBoundsChunkSize)
+		{
+			size_t end = std::min(begin + kBoundsChunkSize, primitiveCount);
+			pool->Submit([&, begin, end] { fetchBounds(begin, end); });
+		}
+		pool->Wait();
+	}
+	else
+	{
+		fetchBounds(0, primitiveCount);
+	}
+
+	// n 个图元最多 2n - 1 个节点; 数组不做初始化, 只有实际用到的节点才占用物理内存
+	buildNodes.reset(new BuildNode[2 * primitiveCount - 1]);
+	nodeCounter = 1;
+	leafCounter = 0;
+	maxDepth = 0;
+
+	if (pool)
+	{
+		pool->Submit([this, primitiveCount] { BuildRecursive(0, 0, static_cast<uint32_t>(primitiveCount), 1); });
+		pool->Wait();
+	}
+	else
+	{
+		BuildRecursive(0, 0, static_cast<uint32_t>(primitiveCount), 1);
+	}
+
+	uint32_t nodeCount = nodeCounter;
+	nodes.reserve(nodeCount);
+	Emit(0, nodes);
+
+	stats.nodeCount = nodeCount;
+	stats.leafCount = leafCounter;
+	stats.maxDepth = maxDepth;
+	for (size_t i = 0; i < primitiveCount; ++i)
+		primitiveIndices[i] = primitives[i].index;
+
+	stats.peakBytes = primitives.size() * sizeof(PrimitiveRef)
+		+ primitiveIndices.size() * sizeof(uint32_t)
+		+ nodeCount * sizeof(BuildNode)
+		+ nodes.capacity() * sizeof(LinearBVHNode);
+
+	primitives.clear();
+	primitives.shrink_to_fit();
+	buildNodes.reset();
+	pool = nullptr;
+
+	stats.buildSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+void BVHBuilder::BuildRecursive(uint32_t nodeIndex, uint32_t start, uint32_t end, int depth)
+{
+	float boundsMin[3] = { kFloatInfinity, kFloatInfinity, kFloatInfinity };
+	float boundsMax[3] = { -kFloatInfinity, -kFloatInfinity, -kFloatInfinity };
+	float centroidMin[3] = { kFloatInfinity, kFloatInfinity, kFloatInfinity };
+	float centroidMax[3] = { -kFloatInfinity, -kFloatInfinity, -kFloatInfinity };
+	for (uint32_t i = start; i < end; ++i)
+	{
+		const auto& primitive = primitives[i];
+		for (int a = 0; a < 3; ++a)
+		{
+			float c = 0.5f * (primitive.boundsMin[a] + primitive.boundsMax[a]);
+			boundsMin[a] = std::min(boundsMin[a], primitive.boundsMin[a]);
+			boundsMax[a] = std::max(boundsMax[a], primitive.boundsMax[a]);
+			centroidMin[a] = std::min(centroidMin[a], c);
+			centroidMax[a] = std::max(centroidMax[a], c);
+		}
+	}
+
+	auto& node = buildNodes[nodeIndex];
+	for (int a = 0; a < 3; ++a)
+	{
+		node.boundsMin[a] = boundsMin[a];
+		node.boundsMax[a] = boundsMax[a];
+	}
+	node.pad = 0;
+
+	int prevDepth = maxDepth;
+	while (prevDepth < depth && !maxDepth.compare_exchange_weak(prevDepth, depth)) {}
+
+	int axis = 0;
+	uint32_t mid = Split(start, end, boundsMin, boundsMax, centroidMin, centroidMax, axis);
+	if (mid == start)
+	{
+		node.firstChildOrPrimitive = start;
+		node.primitiveCount = static_cast<uint16_t>(end - start);
+		node.axis = 0;
+		leafCounter++;
+		return;
+	}
+
+	// 两个子节点一起领取, 保证相邻
+	uint32_t child = nodeCounter.fetch_add(2);
+	node.firstChildOrPrimitive = child;
+	node.primitiveCount = 0;
+	node.axis = static_cast<uint8_t>(axis);
+
+	if (pool && end - start >= kParallelThreshold)
+	{
+		pool->Submit([this, child, mid, end, depth] { BuildRecursive(child + 1, mid, end, depth + 1); });
+		BuildRecursive(child, start, mid, depth + 1);
+	}
+	else
+	{
+		BuildRecursive(child, start, mid, depth + 1);
+		BuildRecursive(child + 1, mid, end, depth + 1);
+	}
+}
+
+uint32_t BVHBuilder::Split(uint32_t start, uint32_t end, const float boundsMin[3], const float boundsMax[3],
+	const float centroidMin[3], const float centroidMax[3], int& axis)
+{
+	uint32_t span = end - start;
+	bool canBeLeaf = span <= maxLeafSize;
+
+	// 中心分布最宽的轴
+	axis = 0;
+	for (int a = 1; a < 3; ++a)
+		if (centroidMax[a] - centroidMin[a] > centroidMax[axis] - centroidMin[axis])
+			axis = a;
+
+	auto centroid = [](const PrimitiveRef& primitive, int a)
+	{
+		return 0.5f * (primitive.boundsMin[a] + primitive.boundsMax[a]);
+	};
+	auto first = primitives.begin() + start;
+	auto last = primitives.begin() + end;
+	auto splitAtMiddle = [&](int a)
+	{
+		uint32_t mid = start + span / 2;
+		std::nth_element(first, primitives.begin() + mid, last,
+			[&](const PrimitiveRef& lhs, const PrimitiveRef& rhs) { return centroid(lhs, a) < centroid(rhs, a); });
+		return mid;
+	};
+
+	if (span == 1)
+		return start;
+	if (centroidMax[axis] <= centroidMin[axis])
+		return canBeLeaf ? start : start + span / 2;	// 所有中心重合, 任意划分都一样
+
+	if (method == BVHSplitMethod::Median)
+		return canBeLeaf ? start : splitAtMiddle(axis);
+
+	// 分桶 SAH, 只沿中心分布最宽的轴分桶 (与 PBRT 相同), 对大规模场景每层少遍历两个轴
+	struct Bin
+	{
+		float boundsMin[3] = { kFloatInfinity, kFloatInfinity, kFloatInfinity };
+		float boundsMax[3] = { -kFloatInfinity, -kFloatInfinity, -kFloatInfinity };
+		uint32_t count = 0;
+
+		void Add(const float otherMin[3], const float otherMax[3], uint32_t n)
+		{
+			for (int k = 0; k < 3; ++k)
+			{
+				boundsMin[k] = std::min(boundsMin[k], otherMin[k]);
+				boundsMax[k] = std::max(boundsMax[k], otherMax[k]);
+			}
+			count += n;
+		}
+	};
+	Bin bins[kBinCount];
+
+	float scale = kBinCount / (centroidMax[axis] - centroidMin[axis]);
+	auto binIndex = [&](const PrimitiveRef& primitive)
+	{
+		int b = static_cast<int>((centroid(primitive, axis) - centroidMin[axis]) * scale);
+		return std::min(b, kBinCount - 1);
+	};
+
+	for (uint32_t i = start; i < end; ++i)
+		bins[binIndex(primitives[i])].Add(primitives[i].boundsMin, primitives[i].boundsMax, 1);
+
+	// 从右往左累计右侧的面积和图元数
+	float rightArea[kBinCount];
+	uint32_t rightCount[kBinCount];
+	Bin accum;
+	for (int b = kBinCount - 1; b > 0; --b)
+	{
+		accum.Add(bins[b].boundsMin, bins[b].boundsMax, bins[b].count);
+		rightArea[b] = accum.count > 0 ? HalfArea(accum.boundsMin, accum.boundsMax) : 0;
+		rightCount[b] = accum.count;
+	}
+
+	// 再从左往右扫描, 在第 b 个桶之后划分
+	double bestCost = infinity;
+	int bestBin = -1;
+	accum = Bin();
+	for (int b = 0; b < kBinCount - 1; ++b)
+	{
+		accum.Add(bins[b].boundsMin, bins[b].boundsMax, bins[b].count);
+		if (accum.count == 0 || rightCount[b + 1] == 0)
+			continue;
+
+		double cost = static_cast<double>(accum.count) * HalfArea(accum.boundsMin, accum.boundsMax)
+			+ static_cast<double>(rightCount[b + 1]) * rightArea[b + 1];
+		if (cost < bestCost)
+		{
+			bestCost = cost;
+			bestBin = b;
+		}
+	}
+
+	// 与 BVHNode 相同的代价模型: 只有划分比逐个求交更划算才继续划分
+	double area = HalfArea(boundsMin, boundsMax);
+	double splitCost = (bestBin >= 0 && area > 0) ?
+		BVHNode::TraversalCost + BVHNode::IntersectionCost * bestCost / area : infinity;
+	if (canBeLeaf && BVHNode::IntersectionCost * span <= splitCost)
+		return start;
+	if (bestBin < 0)
+		return splitAtMiddle(axis);
+
+	auto it = std::partition(first, last,
+		[&](const PrimitiveRef& primitive) { return binIndex(primitive) <= bestBin; });
+	auto mid = static_cast<uint32_t>(it - primitives.begin());
+
+	return (mid == start || mid == end) ? splitAtMiddle(axis) : mid;
+}
+
+uint32_t BVHBuilder::Emit(uint32_t buildIndex, std::vector<LinearBVHNode>& nodes) const
+{
+	const auto& src = buildNodes[buildIndex];
+
+	auto index = static_cast<uint32_t>(nodes.size());
+	nodes.emplace_back();
+	{
+		auto& node = nodes[index];
+		for (int a = 0; a < 3; ++a)
+		{
+			node.boundsMin[a] = src.boundsMin[a];
+			node.boundsMax[a] = src.boundsMax[a];
+		}
+		node.primitiveCount = src.primitiveCount;
+		node.axis = src.axis;
+		node.pad = 0;
+	}
+
+	if (src.primitiveCount > 0)
+	{
+		nodes[index].primitivesOffset = src.firstChildOrPrimitive;
+		return index;
+	}
+
+	// 构建时左子节点总是沿划分轴较小的一侧, 直接作为第一个子节点
+	Emit(src.firstChildOrPrimitive, nodes);
+	auto second = Emit(src.firstChildOrPrimitive + 1, nodes);
+	nodes[index].secondChildOffset = second;
+	return index;
+}
@@ -0,0 +1,243 @@
+#ifndef BVH_BUILDER_H
+#define BVH_BUILDER_H
+
+#include "Common/common.h"
+#include "Common/AABB.h"
+
+#include "BVH.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <vector>
+
+class ThreadPool;
+
+// 32 字节的扁平 BVH 节点, 按深度优先顺序存放:
+// 内部节点的第一个子节点紧跟在自身之后, 第二个子节点由 secondChildOffset 给出;
+// 叶子节点引用图元数组中 [primitivesOffset, primitivesOffset + primitiveCount)
+struct LinearBVHNode
+{
+	float boundsMin[3];
+	float boundsMax[3];
+	union
+	{
+		uint32_t primitivesOffset;	// 叶子节点
+		uint32_t secondChildOffset;	// 内部节点
+	};
+	uint16_t primitiveCount;		// 0 表示内部节点
+	uint8_t axis;					// 内部节点的划分轴, 用于决定先访问哪个子节点
+	uint8_t pad;
+};
+static_assert(sizeof(LinearBVHNode) == 32, "LinearBVHNode should be 32 bytes");
+
+// 把 double 转换成 float 时向外取整, 保证 float 包围盒不会比原包围盒小
+float RoundDown(double v);
+float RoundUp(double v);
+
+// 用 float 做 slab 测试时放大 tMax, 抵消舍入误差 (PBRT 中的 1 + 2 * gamma(3))
+constexpr float kFloatMachineEpsilon = std::numeric_limits<float>::epsilon() * 0.5f;
+constexpr float kSlabTMaxScale = 1 + 2 * (3 * kFloatMachineEpsilon) / (1 - 3 * kFloatMachineEpsilon);
+
+// 射线与 LinearBVHNode 包围盒的 slab 测试, invDir 和 dirIsNeg 由调用者预先算好
+inline bool HitLinearBVHNode(const LinearBVHNode& node, const float orig[3], const float invDir[3], const int dirIsNeg[3],
+	float tMin, float tMax)
+{
+	for (int a = 0; a < 3; ++a)
+	{
+		// 射线方向为负时近处的面是 max
+		float t0 = ((dirIsNeg[a] ? node.boundsMax[a] : node.boundsMin[a]) - orig[a]) * invDir[a];
+		float t1 = ((dirIsNeg[a] ? node.boundsMin[a] : node.boundsMax[a]) - orig[a]) * invDir[a];
+		t1 *= kSlabTMaxScale;
+
+		tMin = t0 > tMin ? t0 : tMin;
+		tMax = t1 < tMax ? t1 : tMax;
+		if (tMax < tMin)
+			return false;
+	}
+	return true;
+}
+
+// 按深度优先顺序遍历扁平 BVH, 射线穿过的每个叶子调用一次 leafFn(node, ray_t)
+// leafFn 对叶子中的图元求交, 命中时把 ray_t.max 缩短到交点并返回 true; 整个遍历有命中时返回 true
+// maxDepth 是树高, 栈深度不会超过它
+template <typename LeafFn>
+bool TraverseLinearBVH(const std::vector<LinearBVHNode>& nodes, int maxDepth, const Ray& r, interval& ray_t, LeafFn&& leafFn)
+{
+	if (nodes.empty())
+		return false;
+
+	float orig[3], invDir[3];
+	int dirIsNeg[3];
+	for (int a = 0; a < 3; ++a)
+	{
+		orig[a] = static_cast<float>(r.GetOrigin()[a]);
+		invDir[a] = static_cast<float>(r.GetInvDirection()[a]);
+		dirIsNeg[a] = r.GetSign(a);
+	}
+
+	// 极端不平衡的树才需要堆上分配
+	constexpr int kLocalStackSize = 64;
+	uint32_t localStack[kLocalStackSize];
+	std::vector<uint32_t> heapStack;
+	uint32_t* stack = localStack;
+	if (maxDepth > kLocalStackSize)
+	{
+		heapStack.resize(maxDepth);
+		stack = heapStack.data();
+	}
+
+	bool hitAnything = false;
+	int stackSize = 0;
+	uint32_t current = 0;
+
+	while (true)
+	{
+		const auto& node = nodes[current];
+		if (HitLinearBVHNode(node, orig, invDir, dirIsNeg, static_cast<float>(ray_t.min), static_cast<float>(ray_t.max)))
+		{
+			if (node.primitiveCount > 0)
+			{
+				if (leafFn(node, ray_t))
+					hitAnything = true;
+				if (stackSize == 0)
+					break;
+				current = stack[--stackSize];
+			}
+			else if (dirIsNeg[node.axis])
+			{
+				// 先访问沿射线方向较近的子节点
+				stack[stackSize++] = current + 1;
+				current = node.secondChildOffset;
+			}
+			else
+			{
+				stack[stackSize++] = node.secondChildOffset;
+				current = current + 1;
+			}
+		}
+		else
+		{
+			if (stackSize == 0)
+				break;
+			current = stack[--stackSize];
+		}
+	}
+
+	return hitAnything;
+}
+
+// 保持拓扑不变, 按图元的当前包围盒自底向上重新计算深度优先排列的节点包围盒
+// primitiveBounds(i) 返回叶子顺序中第 i 个图元的包围盒
+void RefitLinearBVH(std::vector<LinearBVHNode>& nodes, const std::function<AABB(size_t)>& primitiveBounds);
+// 与 BVHNode::SAHCost() 相同的代价, 用于衡量 refit 之后树的质量
+double LinearBVHSAHCost(const std::vector<LinearBVHNode>& nodes);
+
+// refit 之后 SAH 代价超过上次重建时的这个倍数就重建
+constexpr double kDefaultRebuildCostRatio = 1.3;
+
+// 动画场景每帧的更新策略, LinearBVH / WideBVH / TopLevelBVH 的 Update() 共用:
+// 先 Refit(), SAH 代价超过上次重建时的 maxCostRatio 倍再 Rebuild(), 返回是否重建
+template <typename Tree>
+bool RefitOrRebuild(Tree& tree, double builtCost, double maxCostRatio)
+{
+	tree.Refit();
+	if (tree.SAHCost() <= maxCostRatio * builtCost)
+		return false;
+	tree.Rebuild();
+	return true;
+}
+
+// 所有对象当前包围盒的并集, 即 Refit() 和 Rebuild() 之后整棵树的包围盒
+template <typename T>
+AABB UnionBounds(const std::vector<shared_ptr<T>>& objects)
+{
+	AABB box;
+	for (const auto& object : objects)
+		box = AABB(box, object->BoundingBox());
+	return box;
+}
+
+// 按 BVHBuilder 输出的叶子顺序重排图元
+// 结果写入新的数组, objects 可以就是随后被替换的图元数组本身, Rebuild() 因此能直接用它作为输入
+template <typename T>
+std::vector<shared_ptr<T>> ReorderPrimitives(const std::vector<shared_ptr<T>>& objects, const std::vector<uint32_t>& order)
+{
+	std::vector<shared_ptr<T>> sorted;
+	sorted.reserve(order.size());
+	for (auto i : order)
+		sorted.push_back(objects[i]);
+	return sorted;
+}
+
+struct BVHBuildStats
+{
+	double buildSeconds = 0;	// 构建耗时
+	size_t nodeCount = 0;
+	size_t leafCount = 0;
+	int maxDepth = 0;
+	size_t peakBytes = 0;		// 构建过程中构建器自身占用的最大内存
+};
+
+// 只依赖图元包围盒的 BVH 构建器
+// 所有划分都在同一个图元下标数组上原地进行, 节点从一次性分配的数组中按原子计数领取,
+// 较大的子树作为任务交给线程池并行构建, 最后按深度优先顺序重排成 LinearBVHNode
+class BVHBuilder
+{
+public:
+	// threadCount <= 0 时使用全部硬件线程
+	BVHBuilder(BVHSplitMethod method = BVHSplitMethod::SAH,
+		size_t maxLeafSize = BVHNode::DefaultMaxLeafSize, int threadCount = 0);
+
+	// primitiveBounds(i) 返回第 i 个图元的包围盒, 会被并行调用; 图元较少时整个构建都在调用线程中进行
+	// nodes 返回深度优先排列的节点, 叶子中的第 k 个图元是原来的第 primitiveIndices[k] 个图元
+	void Build(size_t primitiveCount, const std::function<AABB(size_t)>& primitiveBounds,
+		std::vector<LinearBVHNode>& nodes, std::vector<uint32_t>& primitiveIndices);
+
+	const BVHBuildStats& Stats()const { return stats; }
+
+private:
+	// 与图元下标放在一起原地重排, 划分时顺序访问内存
+	struct PrimitiveRef
+	{
+		float boundsMin[3];
+		float boundsMax[3];
+		uint32_t index;
+	};
+
+	// 构建期间的节点, 两个子节点总是相邻分配在 firstChild 和 firstChild + 1
+	struct BuildNode
+	{
+		float boundsMin[3];
+		float boundsMax[3];
+		uint32_t firstChildOrPrimitive;
+		uint16_t primitiveCount;
+		uint8_t axis;
+		uint8_t pad;
+	};
+
+	void BuildRecursive(uint32_t nodeIndex, uint32_t start, uint32_t end, int depth);
+	// 返回划分位置, 返回 start 表示应该做成叶子
+	uint32_t Split(uint32_t start, uint32_t end, const float boundsMin[3], const float boundsMax[3],
+		const float centroidMin[3], const float centroidMax[3], int& axis);
+	uint32_t Emit(uint32_t buildIndex, std::vector<LinearBVHNode>& nodes)const;
+
+private:
+	BVHSplitMethod method;
+	size_t maxLeafSize;
+	int threadCount;
+
+	// 以下只在 Build() 期间有效
+	std::vector<PrimitiveRef> primitives;
+	std::unique_ptr<BuildNode[]> buildNodes;
+	std::atomic<uint32_t> nodeCounter{ 0 };
+	std::atomic<uint32_t> leafCounter{ 0 };
+	std::atomic<int> maxDepth{ 0 };
+	ThreadPool* pool = nullptr;
+
+	BVHBuildStats stats;
+};
+
+#endif // !BVH_BUILDER_H
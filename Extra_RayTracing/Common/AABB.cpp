@@ -9,22 +9,21 @@ const interval& AABB::axis(int n) const
 
 bool AABB::hit(const Ray& r, interval ray_t) const
 {
+	const auto& orig = r.GetOrigin();
+	const auto& invD = r.GetInvDirection();
+	const interval* slabs[3] = { &x, &y, &z };
+
 	for (int a = 0; a < 3; ++a)
 	{
-		auto invD = 1 / r.GetDirection()[a];
-		auto orig = r.GetOrigin()[a];
-
 		// 射线方程 P(t) = Ori + t * Dir
-		// 在某一轴上的交点为 x/y/z 
-		auto t0 = (axis(a).min - orig) * invD;
-		auto t1 = (axis(a).max - orig) * invD;
-
-		if (invD < 0)std::swap(t0, t1);
-
-		if (t0 > ray_t.min) ray_t.min = t0;
-		if (t1 < ray_t.max) ray_t.max = t1;
+		// 在某一轴上的交点为 x/y/z, 射线方向为负时近处的面是 max
+		const interval& slab = *slabs[a];
+		int sign = r.GetSign(a);
+		auto t0 = ((sign ? slab.max : slab.min) - orig[a]) * invD[a];
+		auto t1 = ((sign ? slab.min : slab.max) - orig[a]) * invD[a];
 
-		if (ray_t.max <= ray_t.min) return false;
+		ray_t.min = t0 > ray_t.min ? t0 : ray_t.min;
+		ray_t.max = t1 < ray_t.max ? t1 : ray_t.max;
 	}
-	return true;
+	return ray_t.min < ray_t.max;
 }
@@ -24,6 +24,13 @@ public:
 	const interval& axis(int n)const;
 	bool hit(const Ray& r, interval ray_t)const;
 
+	point3 Centroid()const { return point3(0.5 * (x.min + x.max), 0.5 * (y.min + y.max), 0.5 * (z.min + z.max)); }
+	double SurfaceArea()const 
+	{
+		auto dx = x.size(), dy = y.size(), dz = z.size();
+		return 2.0 * (dx * dy + dy * dz + dz * dx);
+	}
+
 public:
 	interval x, y, z;
 };
@@ -0,0 +1,150 @@
+#include "Framebuffer.h"
+
+#ifdef _MSC_VER
+	#pragma warning (push,0)
+#endif
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "../External/stb_image_write.h"
+#ifdef _MSC_VER
+	#pragma warning (pop)
+#endif
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FRAMEBUFFER_SSE
+#endif
+
+namespace
+{
+	std::string Extension(const std::string& fileName)
+	{
+		auto dot = fileName.find_last_of('.');
+		if (dot == std::string::npos)
+			return std::string();
+		std::string ext = fileName.substr(dot + 1);
+		std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+		return ext;
+	}
+
+	unsigned char ToneMapChannel(float v, float exposure)
+	{
+		// gamma 2 (见 linear_to_gamma), 截断到 [0, 0.999] 后乘 256
+		// 与 SSE 的 max(x, 0) 相同, 负数和 NaN 都变成 0
+		float x = v * exposure;
+		if (!(x > 0))
+			x = 0;
+		float g = std::sqrt(x);
+		return static_cast<unsigned char>(256.0f * std::min(g, 0.999f));
+	}
+}
+
+void Framebuffer::ToneMap(std::vector<unsigned char>& rgb8, float exposure) const
+{
+	size_t count = pixels.size();
+	rgb8.resize(count);
+
+	size_t i = 0;
+#if defined(FRAMEBUFFER_SSE)
+	const __m128 scale = _mm_set1_ps(exposure);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 maxValue = _mm_set1_ps(0.999f);
+	const __m128 quantize = _mm_set1_ps(256.0f);
+	for (; i + 4 <= count; i += 4)
+	{
+		// max(x, 0) 的第二个操作数是 0, 所以 NaN 也会变成 0
+		__m128 v = _mm_max_ps(_mm_mul_ps(_mm_loadu_ps(&pixels[i]), scale), zero);
+		v = _mm_mul_ps(_mm_min_ps(_mm_sqrt_ps(v), maxValue), quantize);
+		__m128i ints = _mm_cvttps_epi32(v);
+		ints = _mm_packs_epi32(ints, ints);
+		ints = _mm_packus_epi16(ints, ints);
+		uint32_t packed = static_cast<uint32_t>(_mm_cvtsi128_si32(ints));
+		std::memcpy(&rgb8[i], &packed, 4);
+	}
+#endif
+	for (; i < count; ++i)
+		rgb8[i] = ToneMapChannel(pixels[i], exposure);
+}
+
+bool Framebuffer::Write(const std::string& fileName) const
+{
+	auto ext = Extension(fileName);
+	if (ext == "png")
+		return WritePNG(fileName);
+	if (ext == "hdr")
+		return WriteHDR(fileName);
+
+	if (ext == "ppm" || ext == "pfm")
+	{
+		std::ofstream out(fileName, std::ios::binary);
+		if (!out)
+			return false;
+		return ext == "ppm" ? WritePPM(out) : WritePFM(out);
+	}
+
+	std::cerr << "ERROR: Unknown image format '" << fileName << "'.\n";
+	return false;
+}
+
+bool Framebuffer::WritePNG(const std::string& fileName) const
+{
+	std::vector<unsigned char> rgb8;
+	ToneMap(rgb8);
+	return stbi_write_png(fileName.c_str(), width, height, 3, rgb8.data(), width * 3) != 0;
+}
+
+bool Framebuffer::WritePPM(std::ostream& out) const
+{
+	std::vector<unsigned char> rgb8;
+	ToneMap(rgb8);
+	out << "P6\n" << width << ' ' << height << "\n255\n";
+	out.write(reinterpret_cast<const char*>(rgb8.data()), rgb8.size());
+	return static_cast<bool>(out);
+}
+
+bool Framebuffer::WritePFM(std::ostream& out) const
+{
+	// 比例为负表示小端, PFM 的行自下而上排列
+	const uint16_t endianTest = 1;
+	bool littleEndian = *reinterpret_cast<const unsigned char*>(&endianTest) == 1;
+	out << "PF\n" << width << ' ' << height << '\n' << (littleEndian ? "-1.0" : "1.0") << '\n';
+
+	size_t rowFloats = static_cast<size_t>(width) * 3;
+	for (int y = height - 1; y >= 0; --y)
+		out.write(reinterpret_cast<const char*>(&pixels[y * rowFloats]), rowFloats * sizeof(float));
+	return static_cast<bool>(out);
+}
+
+bool Framebuffer::ReadPFM(std::istream& in)
+{
+	std::string magic;
+	int w = 0, h = 0;
+	double scale = 0;
+	in >> magic >> w >> h >> scale;
+	in.get();
+	if (!in || magic != "PF" || w <= 0 || h <= 0 || scale >= 0)
+		return false;
+
+	std::vector<float> data(static_cast<size_t>(w) * h * 3);
+	size_t rowFloats = static_cast<size_t>(w) * 3;
+	for (int y = h - 1; y >= 0; --y)
+		in.read(reinterpret_cast<char*>(&data[y * rowFloats]), rowFloats * sizeof(float));
+	if (!in)
+		return false;
+
+	width = w;
+	height = h;
+	pixels = std::move(data);
+	return true;
+}
+
+bool Framebuffer::WriteHDR(const std::string& fileName) const
+{
+	return stbi_write_hdr(fileName.c_str(), width, height, 3, pixels.data()) != 0;
+}
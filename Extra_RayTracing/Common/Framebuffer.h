@@ -0,0 +1,58 @@
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include "color.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+// 线性空间的浮点帧缓冲, 每个像素 RGB 三个 float 交错存放, 自上而下逐行排列
+class Framebuffer
+{
+public:
+	Framebuffer() = default;
+	Framebuffer(int width, int height)
+		:width(width), height(height), pixels(static_cast<size_t>(width) * height * 3, 0.0f) {}
+
+	int Width()const { return width; }
+	int Height()const { return height; }
+
+	void SetPixel(int x, int y, const color& c)
+	{
+		float* p = &pixels[(static_cast<size_t>(y) * width + x) * 3];
+		p[0] = static_cast<float>(c.x());
+		p[1] = static_cast<float>(c.y());
+		p[2] = static_cast<float>(c.z());
+	}
+	color GetPixel(int x, int y)const
+	{
+		const float* p = &pixels[(static_cast<size_t>(y) * width + x) * 3];
+		return color(p[0], p[1], p[2]);
+	}
+
+	const float* Data()const { return pixels.data(); }
+
+	// 乘以 exposure 后做 gamma 2 变换, 截断并量化到 [0,255]
+	// 所有通道连续存放, 一次遍历完成, 支持 SSE 时每次处理 4 个通道
+	void ToneMap(std::vector<unsigned char>& rgb8, float exposure = 1.0f)const;
+
+	// 按扩展名选择格式: .png .ppm .pfm .hdr
+	bool Write(const std::string& fileName)const;
+
+	// 8 位, 经过色调映射
+	bool WritePNG(const std::string& fileName)const;
+	bool WritePPM(std::ostream& out)const;	// 二进制 P6
+	// 32 位浮点, 保存线性值
+	bool WritePFM(std::ostream& out)const;
+	// 读取 WritePFM() 写出的 3 通道小端 PFM, 失败时返回 false 并保持原内容
+	bool ReadPFM(std::istream& in);
+	bool WriteHDR(const std::string& fileName)const;	// Radiance RGBE
+
+private:
+	int width = 0;
+	int height = 0;
+	std::vector<float> pixels;
+};
+
+#endif // !FRAMEBUFFER_H
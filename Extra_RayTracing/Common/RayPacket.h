@@ -0,0 +1,49 @@
+#ifndef RAY_PACKET_H
+#define RAY_PACKET_H
+
+#include "ray.h"
+
+// 一组最多 kSize 条射线, 除了原始的 Ray 之外按结构体数组 (SoA) 各存一份,
+// 求交时一条 SIMD 指令同时处理多条射线: Real 分量用于图元的精确求交, float 分量用于包围盒测试
+// 哪些射线参与求交由调用方的位掩码决定, 空位中是构造时的 0 或上一批留下的数据, 一起参与 SIMD 运算但结果被掩码丢弃
+struct RayPacket
+{
+	static constexpr int kSize = 8;
+	static constexpr int kFullMask = (1 << kSize) - 1;
+
+	Ray rays[kSize];
+	int count = 0;
+
+	alignas(32) Real origin[3][kSize] = {};
+	alignas(32) Real direction[3][kSize] = {};
+	alignas(32) Real time[kSize] = {};
+	alignas(32) Real directionLength2[kSize] = {};	// 与 vec3::length_squared() 相同的运算顺序
+
+	alignas(32) float originF[3][kSize] = {};
+	alignas(32) float invDirF[3][kSize] = {};
+	alignas(32) float timeF[kSize] = {};
+
+	void Clear() { count = 0; }
+
+	// 追加一条射线, 返回其序号
+	int Add(const Ray& r)
+	{
+		int i = count++;
+		rays[i] = r;
+		for (int a = 0; a < 3; ++a)
+		{
+			origin[a][i] = r.GetOrigin()[a];
+			direction[a][i] = r.GetDirection()[a];
+			originF[a][i] = static_cast<float>(r.GetOrigin()[a]);
+			invDirF[a][i] = static_cast<float>(r.GetInvDirection()[a]);
+		}
+		time[i] = r.GetTime();
+		timeF[i] = static_cast<float>(r.GetTime());
+		directionLength2[i] = r.GetDirection().length_squared();
+		return i;
+	}
+
+	int Mask()const { return (1 << count) - 1; }
+};
+
+#endif // !RAY_PACKET_H
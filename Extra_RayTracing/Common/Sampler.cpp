@@ -0,0 +1,362 @@
+#include "Sampler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+	// 32 位整数哈希 (Wellons, lowbias32), 比 MixBits 便宜, 每一维都要调用
+	uint32_t Hash(uint32_t x)
+	{
+		x ^= x >> 16;
+		x *= 0x7feb352du;
+		x ^= x >> 15;
+		x *= 0x846ca68bu;
+		x ^= x >> 16;
+		return x;
+	}
+
+	uint32_t Hash(uint32_t a, uint32_t b)
+	{
+		return Hash(a ^ Hash(b + 0x9e3779b9u));
+	}
+
+	uint32_t Hash(uint32_t a, uint32_t b, uint32_t c)
+	{
+		return Hash(Hash(a, b), c);
+	}
+
+	uint32_t ReverseBits(uint32_t v)
+	{
+		v = ((v >> 1) & 0x55555555u) | ((v & 0x55555555u) << 1);
+		v = ((v >> 2) & 0x33333333u) | ((v & 0x33333333u) << 2);
+		v = ((v >> 4) & 0x0f0f0f0fu) | ((v & 0x0f0f0f0fu) << 4);
+		v = ((v >> 8) & 0x00ff00ffu) | ((v & 0x00ff00ffu) << 8);
+		return (v >> 16) | (v << 16);
+	}
+
+	double ToUnit(uint32_t v)
+	{
+		return v * (1.0 / 4294967296.0);
+	}
+
+	// Sobol 序列的前两维, 第一维是按位反转 (van der Corput),
+	// 第二维的方向数是模 2 的帕斯卡矩阵, 可以递推得到; 打乱后的下标是满 32 位的,
+	// 所以预先按字节算好 4 张表, 一次查 4 张表代替逐位异或
+	class SobolTable
+	{
+	public:
+		SobolTable()
+		{
+			uint32_t directions[32];
+			directions[0] = 1u << 31;
+			for (int i = 1; i < 32; ++i)
+				directions[i] = directions[i - 1] ^ (directions[i - 1] >> 1);
+
+			for (int b = 0; b < 4; ++b)
+			{
+				for (uint32_t value = 0; value < 256; ++value)
+				{
+					uint32_t result = 0;
+					for (int bit = 0; bit < 8; ++bit)
+					{
+						if (value & (1u << bit))
+							result ^= directions[b * 8 + bit];
+					}
+					table[b][value] = result;
+				}
+			}
+		}
+
+		uint32_t operator()(uint32_t index)const
+		{
+			return table[0][index & 0xff] ^ table[1][(index >> 8) & 0xff] ^
+				table[2][(index >> 16) & 0xff] ^ table[3][index >> 24];
+		}
+
+	private:
+		uint32_t table[4][256];
+	};
+
+	uint32_t Sobol(uint32_t index, int dim)
+	{
+		if (dim == 0)
+			return ReverseBits(index);
+
+		static const SobolTable secondDimension;
+		return secondDimension(index);
+	}
+
+	// Laine-Karras 式的哈希置换, 只影响比自身低的位, 按位反转后等价于 Owen 扰动
+	uint32_t LaineKarrasPermutation(uint32_t x, uint32_t seed)
+	{
+		x ^= x * 0x3d20adeau;
+		x += seed;
+		x *= (seed >> 16) | 1;
+		x ^= x * 0x05526c56u;
+		x ^= x * 0x53a22864u;
+		return x;
+	}
+
+	uint32_t NestedUniformScramble(uint32_t x, uint32_t seed)
+	{
+		return ReverseBits(LaineKarrasPermutation(ReverseBits(x), seed));
+	}
+
+	// Kensler, Correlated Multi-Jittered Sampling: [0, l) 上由 p 决定的一个置换
+	uint32_t Permute(uint32_t i, uint32_t l, uint32_t p)
+	{
+		uint32_t w = l - 1;
+		w |= w >> 1;
+		w |= w >> 2;
+		w |= w >> 4;
+		w |= w >> 8;
+		w |= w >> 16;
+		do
+		{
+			i ^= p; i *= 0xe170893du;
+			i ^= p >> 16;
+			i ^= (i & w) >> 4;
+			i ^= p >> 8; i *= 0x0929eb3fu;
+			i ^= p >> 23;
+			i ^= (i & w) >> 1; i *= 1 | p >> 27;
+			i *= 0x6935fa69u;
+			i ^= (i & w) >> 11; i *= 0x74dcb303u;
+			i ^= (i & w) >> 2; i *= 0x9e501cc3u;
+			i ^= (i & w) >> 2; i *= 0xc860a3dfu;
+			i &= w;
+			i ^= i >> 5;
+		} while (i >= l);
+		return (i + p) % l;
+	}
+
+	double RandDouble(uint32_t i, uint32_t p)
+	{
+		i ^= p;
+		i ^= i >> 17;
+		i ^= i >> 10; i *= 0xb36534e5u;
+		i ^= i >> 12;
+		i ^= i >> 21; i *= 0x93fc4795u;
+		i ^= 0xdf6e307fu;
+		i ^= i >> 17; i *= 1 | p >> 18;
+		return ToUnit(i);
+	}
+
+	// 蓝噪声掩码, 用 void-and-cluster (Ulichney 1993) 生成, 值为 [0, size*size) 的排名
+	// 后半程沿用 "最大空洞" 规则代替原算法中对 0 的 "最密簇" 规则, 结果相差很小
+	class BlueNoiseMask
+	{
+	public:
+		static constexpr int Size = 64;
+
+		static const BlueNoiseMask& Get()
+		{
+			static const BlueNoiseMask mask;
+			return mask;
+		}
+
+		// [0,1) 上的阈值
+		double Value(int x, int y)const
+		{
+			return (rank[(y & (Size - 1)) * Size + (x & (Size - 1))] + 0.5) / (Size * Size);
+		}
+
+	private:
+		BlueNoiseMask()
+		{
+			const int count = Size * Size;
+			const double sigma = 1.5;
+
+			// 环面上的高斯核, 以坐标差 (取模后) 为下标
+			kernel.resize(count);
+			for (int dy = 0; dy < Size; ++dy)
+			{
+				for (int dx = 0; dx < Size; ++dx)
+				{
+					int wx = std::min(dx, Size - dx);
+					int wy = std::min(dy, Size - dy);
+					kernel[dy * Size + dx] = static_cast<float>(std::exp(-(wx * wx + wy * wy) / (2 * sigma * sigma)));
+				}
+			}
+
+			// 初始图案: 约 10% 的随机点, 反复把最密簇中的点移到最大空洞, 直到稳定
+			std::vector<char> initial(count, 0);
+			std::vector<float> initialEnergy(count, 0.0f);
+			PCG32 rng(0x9e3779b97f4a7c15ULL, 1);
+			int ones = count / 10;
+			for (int placed = 0; placed < ones;)
+			{
+				int p = static_cast<int>(rng.NextUInt() % count);
+				if (initial[p])
+					continue;
+				Toggle(initial, initialEnergy, p);
+				placed++;
+			}
+			for (int iteration = 0; iteration < count; ++iteration)
+			{
+				int cluster = Extreme(initial, initialEnergy, 1, true);
+				Toggle(initial, initialEnergy, cluster);
+				int hole = Extreme(initial, initialEnergy, 0, false);
+				Toggle(initial, initialEnergy, hole);
+				if (hole == cluster)
+					break;
+			}
+
+			rank.assign(count, 0);
+
+			// 第一阶段: 依次取走最密簇中的点, 排名从 ones-1 递减
+			auto pattern = initial;
+			auto energy = initialEnergy;
+			for (int r = ones - 1; r >= 0; --r)
+			{
+				int cluster = Extreme(pattern, energy, 1, true);
+				Toggle(pattern, energy, cluster);
+				rank[cluster] = static_cast<uint16_t>(r);
+			}
+
+			// 第二阶段: 从初始图案开始依次填入最大空洞
+			pattern = initial;
+			energy = initialEnergy;
+			for (int r = ones; r < count; ++r)
+			{
+				int hole = Extreme(pattern, energy, 0, false);
+				Toggle(pattern, energy, hole);
+				rank[hole] = static_cast<uint16_t>(r);
+			}
+		}
+
+		void Toggle(std::vector<char>& pattern, std::vector<float>& energy, int p)const
+		{
+			float sign = pattern[p] ? -1.0f : 1.0f;
+			pattern[p] = !pattern[p];
+			int px = p % Size, py = p / Size;
+			for (int y = 0; y < Size; ++y)
+			{
+				const float* row = &kernel[((y - py) & (Size - 1)) * Size];
+				for (int x = 0; x < Size; ++x)
+					energy[y * Size + x] += sign * row[(x - px) & (Size - 1)];
+			}
+		}
+
+		// 在 pattern == value 的位置中找能量最大 (或最小) 的一个
+		int Extreme(const std::vector<char>& pattern, const std::vector<float>& energy, char value, bool findMax)const
+		{
+			int best = -1;
+			for (int p = 0; p < static_cast<int>(energy.size()); ++p)
+			{
+				if (pattern[p] != value)
+					continue;
+				if (best < 0 || (findMax ? energy[p] > energy[best] : energy[p] < energy[best]))
+					best = p;
+			}
+			return best;
+		}
+
+		std::vector<float> kernel;
+		std::vector<uint16_t> rank;
+	};
+}
+
+void DimensionalSampler::StartPixelSample(int x, int y, int sampleIndex)
+{
+	if (x != pixelX || y != pixelY || dimensionEnd == 0)
+		pixelSeed = Hash(seed32, static_cast<uint32_t>(x), static_cast<uint32_t>(y));
+	pixelX = x;
+	pixelY = y;
+	index = sampleIndex;
+	dimension = 0;
+	dimensionEnd = CameraDimensions;
+	cachedPair = -1;
+	fallback.StartPixelSample(x, y, sampleIndex);
+}
+
+StratifiedSampler::StratifiedSampler(uint64_t seed, int sampleCount)
+	:DimensionalSampler(seed), sampleCount(sampleCount < 1 ? 1 : sampleCount)
+{
+	gridX = static_cast<int>(std::sqrt(static_cast<double>(this->sampleCount)));
+	gridY = (this->sampleCount + gridX - 1) / gridX;
+}
+
+void StratifiedSampler::Sample2D(int pair, double value[2])
+{
+	uint32_t round = static_cast<uint32_t>(index / sampleCount);
+	uint32_t s = static_cast<uint32_t>(index % sampleCount);
+	uint32_t p = Hash(pixelSeed, static_cast<uint32_t>(pair), round);
+
+	uint32_t n = static_cast<uint32_t>(sampleCount);
+	uint32_t m = static_cast<uint32_t>(gridX);
+	uint32_t rows = static_cast<uint32_t>(gridY);
+	s = Permute(s, n, p * 0x51633e2du);
+	uint32_t sx = Permute(s % m, m, p * 0x68bc21ebu);
+	uint32_t sy = Permute(s / m, rows, p * 0x02e5be93u);
+
+	value[0] = (sx + (sy + RandDouble(s, p * 0x967a889bu)) / rows) / m;
+	value[1] = (s / m + (sx + RandDouble(s, p * 0x368cc8b7u)) / m) / rows;
+}
+
+void SobolSampler::Sample2D(int pair, double value[2])
+{
+	uint32_t pairSeed = Hash(pixelSeed, static_cast<uint32_t>(pair));
+	uint32_t shuffled = NestedUniformScramble(static_cast<uint32_t>(index), pairSeed);
+	for (int d = 0; d < 2; ++d)
+		value[d] = ToUnit(NestedUniformScramble(Sobol(shuffled, d), Hash(pairSeed, d + 1)));
+}
+
+void BlueNoiseSampler::Sample2D(int pair, double value[2])
+{
+	uint32_t pairSeed = Hash(seed32, static_cast<uint32_t>(pair));
+	uint32_t shuffled = NestedUniformScramble(static_cast<uint32_t>(index), pairSeed);
+	for (int d = 0; d < 2; ++d)
+	{
+		double v = ToUnit(NestedUniformScramble(Sobol(shuffled, d), Hash(pairSeed, d + 1)));
+
+		// 每一维取掩码的不同平移, 避免各维的偏移相关
+		uint32_t offset = Hash(pairSeed, d + 1, 0x626c7565u);
+		v += BlueNoiseMask::Get().Value(pixelX + static_cast<int>(offset & 0xffff), pixelY + static_cast<int>(offset >> 16));
+		value[d] = v < 1.0 ? v : v - 1.0;
+	}
+}
+
+std::unique_ptr<Sampler> MakeSampler(SamplerType type, uint64_t seed, int sampleCount)
+{
+	switch (type)
+	{
+	case SamplerType::Stratified:
+		return std::make_unique<StratifiedSampler>(seed, sampleCount);
+	case SamplerType::Sobol:
+		return std::make_unique<SobolSampler>(seed);
+	case SamplerType::BlueNoise:
+		return std::make_unique<BlueNoiseSampler>(seed);
+	default:
+		return std::make_unique<IndependentSampler>(seed);
+	}
+}
+
+const char* SamplerName(SamplerType type)
+{
+	switch (type)
+	{
+	case SamplerType::Stratified:
+		return "stratified";
+	case SamplerType::Sobol:
+		return "sobol";
+	case SamplerType::BlueNoise:
+		return "bluenoise";
+	default:
+		return "independent";
+	}
+}
+
+bool ParseSamplerType(const std::string& name, SamplerType& type)
+{
+	for (auto candidate : { SamplerType::Independent, SamplerType::Stratified, SamplerType::Sobol, SamplerType::BlueNoise })
+	{
+		if (name == SamplerName(candidate))
+		{
+			type = candidate;
+			return true;
+		}
+	}
+	return false;
+}
@@ -0,0 +1,210 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// PCG32 随机数生成器 (O'Neill, pcg-random.org)
+// 64 位状态, 每个 inc 对应一条独立序列
+class PCG32
+{
+public:
+	PCG32() { Seed(0x853c49e6748fea9bULL, 0xda3e39cb94b95bdbULL); }
+	PCG32(uint64_t initState, uint64_t initSeq) { Seed(initState, initSeq); }
+
+	void Seed(uint64_t initState, uint64_t initSeq)
+	{
+		state = 0u;
+		inc = (initSeq << 1u) | 1u;
+		NextUInt();
+		state += initState;
+		NextUInt();
+	}
+
+	uint32_t NextUInt()
+	{
+		uint64_t oldState = state;
+		state = oldState * 6364136223846793005ULL + inc;
+		uint32_t xorShifted = static_cast<uint32_t>(((oldState >> 18u) ^ oldState) >> 27u);
+		uint32_t rot = static_cast<uint32_t>(oldState >> 59u);
+		return (xorShifted >> rot) | (xorShifted << ((~rot + 1u) & 31));
+	}
+
+	// [0,1) 上的随机数
+	double NextDouble()
+	{
+		return NextUInt() * (1.0 / 4294967296.0);
+	}
+
+public:
+	uint64_t state;
+	uint64_t inc;
+};
+
+// SplitMix64 的混合函数, 把相邻的计数器打散成互不相关的种子
+inline uint64_t MixBits(uint64_t v)
+{
+	v ^= v >> 31;
+	v *= 0x7fb5d329728ea185ULL;
+	v ^= v >> 27;
+	v *= 0x81dadef4bc2dd44dULL;
+	v ^= v >> 33;
+	return v;
+}
+
+// 采样器接口
+// 每个 (像素, 样本, 弹射) 都由计数器直接确定一组随机数,
+// 不依赖任何共享状态, 所以结果与线程数和渲染顺序无关
+//
+// 维度按用途固定分配, 低差异序列的每一维 (或每一对维度) 对应一个用途:
+//   相机: 像素内抖动 2 维, 镜头 2 维, 快门时间 1 维, 共 CameraDimensions 维
+//   每次弹射: BounceDimensions 维, 依次由材质散射和俄罗斯轮盘赌取用
+// 超出本次弹射配额的取数 (例如拒绝采样的重试) 改用独立随机数, 不会挤占下一次弹射的维度
+class Sampler
+{
+public:
+	static constexpr int CameraDimensions = 6;
+	static constexpr int BounceDimensions = 4;
+
+	virtual ~Sampler() = default;
+
+	virtual void StartPixelSample(int x, int y, int sampleIndex) = 0;
+	virtual void StartBounce(int bounce) = 0;
+
+	virtual double Get1D() = 0;
+	double Get1D(double min, double max) { return min + (max - min) * Get1D(); }
+};
+
+// 相互独立的均匀随机数
+class IndependentSampler :public Sampler
+{
+public:
+	IndependentSampler(uint64_t seed = 0) :baseSeed(MixBits(seed)) {}
+
+	void StartPixelSample(int x, int y, int sampleIndex) override
+	{
+		pixelKey = MixBits(baseSeed ^ ((static_cast<uint64_t>(y) << 32) | static_cast<uint32_t>(x)));
+		sampleKey = MixBits(pixelKey + static_cast<uint64_t>(sampleIndex));
+		StartBounce(0);
+	}
+
+	void StartBounce(int bounce) override
+	{
+		rng.Seed(MixBits(sampleKey + static_cast<uint64_t>(bounce)), sampleKey);
+	}
+
+	double Get1D() override { return rng.NextDouble(); }
+	using Sampler::Get1D;
+
+private:
+	uint64_t baseSeed;
+	uint64_t pixelKey = 0;
+	uint64_t sampleKey = 0;
+	PCG32 rng;
+};
+
+// 按维度取样的采样器的公共部分: 维度计数和超出配额时的独立随机数
+class DimensionalSampler :public Sampler
+{
+public:
+	DimensionalSampler(uint64_t seed) :seed32(static_cast<uint32_t>(MixBits(seed))), fallback(seed) {}
+
+	void StartPixelSample(int x, int y, int sampleIndex) override;
+
+	void StartBounce(int bounce) override
+	{
+		dimension = CameraDimensions + bounce * BounceDimensions;
+		dimensionEnd = dimension + BounceDimensions;
+		cachedPair = -1;
+		fallback.StartBounce(bounce);
+	}
+
+	double Get1D() override
+	{
+		if (dimension >= dimensionEnd)
+			return fallback.Get1D();
+
+		// 两维一起生成, 第二维直接取缓存
+		int dim = dimension++;
+		if ((dim & 1) == 0 || cachedPair != dim / 2)
+		{
+			cachedPair = dim / 2;
+			Sample2D(cachedPair, cached);
+		}
+		return cached[dim & 1];
+	}
+	using Sampler::Get1D;
+
+protected:
+	// 当前像素第 index 个样本在第 pair 对维度上的值, 每维都在 [0,1)
+	virtual void Sample2D(int pair, double value[2]) = 0;
+
+	uint32_t seed32;		// 由种子导出的 32 位哈希种子
+	uint32_t pixelSeed = 0;	// 由 seed32 和像素坐标导出
+	int pixelX = 0;
+	int pixelY = 0;
+	int index = 0;
+
+private:
+	int dimension = 0;
+	int dimensionEnd = 0;
+	int cachedPair = -1;
+	double cached[2] = { 0, 0 };
+	IndependentSampler fallback;
+};
+
+// 分层采样: 每对维度用相关多重抖动 (Kensler 2013, correlated multi-jittered sampling),
+// 每 sampleCount 个样本为一轮, 一轮之内二维和一维投影都是分层的
+class StratifiedSampler :public DimensionalSampler
+{
+public:
+	StratifiedSampler(uint64_t seed, int sampleCount);
+
+protected:
+	void Sample2D(int pair, double value[2]) override;
+
+private:
+	int sampleCount;
+	int gridX;
+	int gridY;
+};
+
+// 随机打乱并 Owen 扰动的 Sobol 序列 (Burley 2020, Practical Hash-based Owen Scrambling)
+// 每对维度使用 Sobol 的前两维, 各自用不同的种子打乱样本顺序, 互不相关
+class SobolSampler :public DimensionalSampler
+{
+public:
+	SobolSampler(uint64_t seed) :DimensionalSampler(seed) {}
+
+protected:
+	void Sample2D(int pair, double value[2]) override;
+};
+
+// 蓝噪声: 所有像素共用同一条 Owen 扰动的 Sobol 序列, 每个像素每一维按蓝噪声掩码做
+// Cranley-Patterson 平移, 相邻像素的误差互相错开, 低采样数时噪声呈高频分布
+class BlueNoiseSampler :public DimensionalSampler
+{
+public:
+	BlueNoiseSampler(uint64_t seed) :DimensionalSampler(seed) {}
+
+protected:
+	void Sample2D(int pair, double value[2]) override;
+};
+
+enum class SamplerType
+{
+	Independent,
+	Stratified,
+	Sobol,
+	BlueNoise,
+};
+
+// sampleCount 为每个像素计划的样本数, 分层采样据此划分网格
+std::unique_ptr<Sampler> MakeSampler(SamplerType type, uint64_t seed, int sampleCount);
+
+const char* SamplerName(SamplerType type);
+// 返回 false 表示没有这个名字
+bool ParseSamplerType(const std::string& name, SamplerType& type);
+
+#endif // !SAMPLER_H
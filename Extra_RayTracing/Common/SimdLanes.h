@@ -0,0 +1,175 @@
+#ifndef SIMD_LANES_H
+#define SIMD_LANES_H
+
+// 若干个 float / double 通道上的运算, 求交代码按通道写一遍, 由编译选项决定宽度:
+// 打开 AVX 时 8 个 float / 4 个 double, SSE2 时 4 / 2 个, 都没有时退化为标量
+// V 是一组数, M 是逐通道比较的结果, Bits() 把 M 转换成位掩码
+
+#include <cmath>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SIMD_LANES_SSE 1
+#endif
+
+#if defined(__AVX__)
+struct FloatLanes
+{
+	static constexpr int kWidth = 8;
+	using V = __m256;
+	using M = __m256;
+
+	static V Load(const float* p) { return _mm256_loadu_ps(p); }
+	static void Store(float* p, V v) { _mm256_storeu_ps(p, v); }
+	static V Set(float v) { return _mm256_set1_ps(v); }
+	static V Add(V a, V b) { return _mm256_add_ps(a, b); }
+	static V Sub(V a, V b) { return _mm256_sub_ps(a, b); }
+	static V Mul(V a, V b) { return _mm256_mul_ps(a, b); }
+	static V Min(V a, V b) { return _mm256_min_ps(a, b); }
+	static V Max(V a, V b) { return _mm256_max_ps(a, b); }
+	static V Div(V a, V b) { return _mm256_div_ps(a, b); }
+	static V Sqrt(V a) { return _mm256_sqrt_ps(a); }
+	static V Neg(V a) { return _mm256_xor_ps(a, _mm256_set1_ps(-0.0f)); }
+	static V Abs(V a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+	static M Less(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+	static M LessEqual(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+	static M And(M a, M b) { return _mm256_and_ps(a, b); }
+	static M Or(M a, M b) { return _mm256_or_ps(a, b); }
+	static V Select(M mask, V a, V b) { return _mm256_blendv_ps(b, a, mask); }
+	static int Bits(M mask) { return _mm256_movemask_ps(mask); }
+};
+
+struct DoubleLanes
+{
+	static constexpr int kWidth = 4;
+	using V = __m256d;
+	using M = __m256d;
+
+	static V Load(const double* p) { return _mm256_loadu_pd(p); }
+	static void Store(double* p, V v) { _mm256_storeu_pd(p, v); }
+	static V Set(double v) { return _mm256_set1_pd(v); }
+	static V Add(V a, V b) { return _mm256_add_pd(a, b); }
+	static V Sub(V a, V b) { return _mm256_sub_pd(a, b); }
+	static V Mul(V a, V b) { return _mm256_mul_pd(a, b); }
+	static V Div(V a, V b) { return _mm256_div_pd(a, b); }
+	static V Sqrt(V a) { return _mm256_sqrt_pd(a); }
+	static V Neg(V a) { return _mm256_xor_pd(a, _mm256_set1_pd(-0.0)); }
+	static M Less(V a, V b) { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+	static M GreaterEqual(V a, V b) { return _mm256_cmp_pd(a, b, _CMP_GE_OQ); }
+	static M And(M a, M b) { return _mm256_and_pd(a, b); }
+	static M Or(M a, M b) { return _mm256_or_pd(a, b); }
+	static V Select(M mask, V a, V b) { return _mm256_blendv_pd(b, a, mask); }
+	static int Bits(M mask) { return _mm256_movemask_pd(mask); }
+};
+#elif defined(SIMD_LANES_SSE)
+struct FloatLanes
+{
+	static constexpr int kWidth = 4;
+	using V = __m128;
+	using M = __m128;
+
+	static V Load(const float* p) { return _mm_loadu_ps(p); }
+	static void Store(float* p, V v) { _mm_storeu_ps(p, v); }
+	static V Set(float v) { return _mm_set1_ps(v); }
+	static V Add(V a, V b) { return _mm_add_ps(a, b); }
+	static V Sub(V a, V b) { return _mm_sub_ps(a, b); }
+	static V Mul(V a, V b) { return _mm_mul_ps(a, b); }
+	static V Min(V a, V b) { return _mm_min_ps(a, b); }
+	static V Max(V a, V b) { return _mm_max_ps(a, b); }
+	static V Div(V a, V b) { return _mm_div_ps(a, b); }
+	static V Sqrt(V a) { return _mm_sqrt_ps(a); }
+	static V Neg(V a) { return _mm_xor_ps(a, _mm_set1_ps(-0.0f)); }
+	static V Abs(V a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+	static M Less(V a, V b) { return _mm_cmplt_ps(a, b); }
+	static M LessEqual(V a, V b) { return _mm_cmple_ps(a, b); }
+	static M And(M a, M b) { return _mm_and_ps(a, b); }
+	static M Or(M a, M b) { return _mm_or_ps(a, b); }
+	static V Select(M mask, V a, V b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+	static int Bits(M mask) { return _mm_movemask_ps(mask); }
+};
+
+struct DoubleLanes
+{
+	static constexpr int kWidth = 2;
+	using V = __m128d;
+	using M = __m128d;
+
+	static V Load(const double* p) { return _mm_loadu_pd(p); }
+	static void Store(double* p, V v) { _mm_storeu_pd(p, v); }
+	static V Set(double v) { return _mm_set1_pd(v); }
+	static V Add(V a, V b) { return _mm_add_pd(a, b); }
+	static V Sub(V a, V b) { return _mm_sub_pd(a, b); }
+	static V Mul(V a, V b) { return _mm_mul_pd(a, b); }
+	static V Div(V a, V b) { return _mm_div_pd(a, b); }
+	static V Sqrt(V a) { return _mm_sqrt_pd(a); }
+	static V Neg(V a) { return _mm_xor_pd(a, _mm_set1_pd(-0.0)); }
+	static M Less(V a, V b) { return _mm_cmplt_pd(a, b); }
+	static M GreaterEqual(V a, V b) { return _mm_cmpge_pd(a, b); }
+	static M And(M a, M b) { return _mm_and_pd(a, b); }
+	static M Or(M a, M b) { return _mm_or_pd(a, b); }
+	static V Select(M mask, V a, V b) { return _mm_or_pd(_mm_and_pd(mask, a), _mm_andnot_pd(mask, b)); }
+	static int Bits(M mask) { return _mm_movemask_pd(mask); }
+};
+#else
+struct FloatLanes
+{
+	static constexpr int kWidth = 1;
+	using V = float;
+	using M = bool;
+
+	static V Load(const float* p) { return *p; }
+	static void Store(float* p, V v) { *p = v; }
+	static V Set(float v) { return v; }
+	static V Add(V a, V b) { return a + b; }
+	static V Sub(V a, V b) { return a - b; }
+	static V Mul(V a, V b) { return a * b; }
+	// 与 SSE 的 min/max 相同, 有 NaN 时返回第二个操作数
+	static V Min(V a, V b) { return a < b ? a : b; }
+	static V Max(V a, V b) { return a > b ? a : b; }
+	static V Div(V a, V b) { return a / b; }
+	static V Sqrt(V a) { return std::sqrt(a); }
+	static V Neg(V a) { return -a; }
+	static V Abs(V a) { return std::fabs(a); }
+	static M Less(V a, V b) { return a < b; }
+	static M LessEqual(V a, V b) { return a <= b; }
+	static M And(M a, M b) { return a && b; }
+	static M Or(M a, M b) { return a || b; }
+	static V Select(M mask, V a, V b) { return mask ? a : b; }
+	static int Bits(M mask) { return mask ? 1 : 0; }
+};
+
+struct DoubleLanes
+{
+	static constexpr int kWidth = 1;
+	using V = double;
+	using M = bool;
+
+	static V Load(const double* p) { return *p; }
+	static void Store(double* p, V v) { *p = v; }
+	static V Set(double v) { return v; }
+	static V Add(V a, V b) { return a + b; }
+	static V Sub(V a, V b) { return a - b; }
+	static V Mul(V a, V b) { return a * b; }
+	static V Div(V a, V b) { return a / b; }
+	static V Sqrt(V a) { return std::sqrt(a); }
+	static V Neg(V a) { return -a; }
+	static M Less(V a, V b) { return a < b; }
+	static M GreaterEqual(V a, V b) { return a >= b; }
+	static M And(M a, M b) { return a && b; }
+	static M Or(M a, M b) { return a || b; }
+	static V Select(M mask, V a, V b) { return mask ? a : b; }
+	static int Bits(M mask) { return mask ? 1 : 0; }
+};
+#endif
+
+// 与 Real 精度相同的通道, 图元在 packet 中的求交用它, 结果与标量的 hit() 逐位一致
+#ifdef RT_FLOAT
+using RealLanes = FloatLanes;
+#else
+using RealLanes = DoubleLanes;
+#endif
+
+#endif // !SIMD_LANES_H
@@ -14,7 +14,7 @@ public:
 	virtual color Value(double u, double v, const point3& p)const = 0;
 };
 
-class SolidColor :public Texture 
+class SolidColor final :public Texture 
 {
 public:
 	SolidColor(color c) :colorValue(c) {}
@@ -25,12 +25,14 @@ public:
 		return colorValue;
 	}
 
+	const color& Color()const { return colorValue; }
+
 private:
 	color colorValue;
 };
 
 // 格子图
-class CheckerTexture :public Texture 
+class CheckerTexture final :public Texture 
 {
 public:
 	CheckerTexture(double scale, shared_ptr<Texture> _even, shared_ptr<Texture> _odd)
@@ -39,13 +41,21 @@ public:
 		:invScale(1.0 / scale), even(make_shared<SolidColor>(c1)), odd(make_shared<SolidColor>(c2)) {}
 
 	color Value(double u, double v, const point3& p) const override;
+
+	// p 是否落在 even 的格子中, 封闭集合中的格子纹理 (见 material_variant.h) 使用同一个判断
+	static bool IsEven(double invScale, const point3& p);
+
+	double InvScale()const { return invScale; }
+	const shared_ptr<Texture>& Even()const { return even; }
+	const shared_ptr<Texture>& Odd()const { return odd; }
+
 private:
 	double invScale;
 	shared_ptr<Texture> even;
 	shared_ptr<Texture> odd;
 };
 
-class ImageTexture :public Texture 
+class ImageTexture final :public Texture 
 {
 public:
 	ImageTexture(const char* szFileName) :image(szFileName) {}
@@ -56,7 +66,7 @@ private:
 };
 
 // 噪声图
-class NoiseTexture :public Texture 
+class NoiseTexture final :public Texture 
 {
 public:
 	NoiseTexture() = default;
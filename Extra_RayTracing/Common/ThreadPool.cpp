@@ -0,0 +1,143 @@
+#include "ThreadPool.h"
+
+namespace
+{
+	// 当前线程所属的线程池及其队列编号
+	thread_local const ThreadPool* tCurrentPool = nullptr;
+	thread_local int tQueueIndex = -1;
+}
+
+ThreadPool::ThreadPool(int threadCount)
+{
+	if (threadCount <= 0)
+		threadCount = HardwareThreads();
+
+	for (int i = 0; i < threadCount; ++i)
+		queues.push_back(std::make_unique<WorkQueue>());
+
+	// 最后一个队列留给调用 Wait() 的线程
+	for (int i = 0; i < threadCount - 1; ++i)
+		workers.emplace_back(&ThreadPool::WorkerLoop, this, i);
+}
+
+ThreadPool::~ThreadPool()
+{
+	Wait();
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		stop = true;
+	}
+	wakeCV.notify_all();
+	for (auto& worker : workers)
+		worker.join();
+}
+
+int ThreadPool::HardwareThreads()
+{
+	unsigned int n = std::thread::hardware_concurrency();
+	return n == 0 ? 1 : static_cast<int>(n);
+}
+
+void ThreadPool::Submit(std::function<void()> task)
+{
+	int index = (tCurrentPool == this) ? tQueueIndex :
+		static_cast<int>(nextQueue++ % queues.size());
+
+	pending++;
+	{
+		std::lock_guard<std::mutex> lock(queues[index]->mutex);
+		queues[index]->tasks.push_back(std::move(task));
+	}
+	queued++;
+
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+	}
+	wakeCV.notify_one();
+}
+
+void ThreadPool::Wait()
+{
+	const ThreadPool* prevPool = tCurrentPool;
+	int prevIndex = tQueueIndex;
+	tCurrentPool = this;
+	tQueueIndex = Size() - 1;
+
+	std::function<void()> task;
+	while (pending > 0)
+	{
+		if (TryPop(tQueueIndex, task) || TrySteal(tQueueIndex, task))
+		{
+			RunTask(task);
+			continue;
+		}
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		wakeCV.wait(lock, [this] { return pending == 0 || queued > 0; });
+	}
+
+	tCurrentPool = prevPool;
+	tQueueIndex = prevIndex;
+}
+
+void ThreadPool::WorkerLoop(int index)
+{
+	tCurrentPool = this;
+	tQueueIndex = index;
+
+	std::function<void()> task;
+	while (true)
+	{
+		if (TryPop(index, task) || TrySteal(index, task))
+		{
+			RunTask(task);
+			continue;
+		}
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		wakeCV.wait(lock, [this] { return stop || queued > 0; });
+		if (stop && queued == 0)
+			return;
+	}
+}
+
+bool ThreadPool::TryPop(int index, std::function<void()>& task)
+{
+	auto& queue = *queues[index];
+	std::lock_guard<std::mutex> lock(queue.mutex);
+	if (queue.tasks.empty())
+		return false;
+	task = std::move(queue.tasks.back());
+	queue.tasks.pop_back();
+	queued--;
+	return true;
+}
+
+bool ThreadPool::TrySteal(int index, std::function<void()>& task)
+{
+	int count = Size();
+	for (int i = 1; i < count; ++i)
+	{
+		auto& queue = *queues[(index + i) % count];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (queue.tasks.empty())
+			continue;
+		task = std::move(queue.tasks.front());
+		queue.tasks.pop_front();
+		queued--;
+		return true;
+	}
+	return false;
+}
+
+void ThreadPool::RunTask(std::function<void()>& task)
+{
+	task();
+	task = nullptr;
+	if (--pending == 0)
+	{
+		// 唤醒在 Wait() 中等待的线程
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+		}
+		wakeCV.notify_all();
+	}
+}
@@ -0,0 +1,59 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// 工作窃取线程池
+// 每个线程有自己的任务队列, 从队尾取任务, 队列空时从其他线程的队首窃取
+// 调用 Wait() 的线程也会参与执行, 所以总线程数 = threadCount
+class ThreadPool
+{
+public:
+	explicit ThreadPool(int threadCount = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	// 提交任务, 在池内线程中调用时放入该线程自己的队列
+	void Submit(std::function<void()> task);
+	// 阻塞直到所有已提交的任务(包括任务中再提交的任务)执行完
+	void Wait();
+
+	int Size() const { return static_cast<int>(queues.size()); }
+
+	// threadCount <= 0 时使用的线程数
+	static int HardwareThreads();
+
+private:
+	struct WorkQueue
+	{
+		std::mutex mutex;
+		std::deque<std::function<void()>> tasks;
+	};
+
+	void WorkerLoop(int index);
+	bool TryPop(int index, std::function<void()>& task);
+	bool TrySteal(int index, std::function<void()>& task);
+	void RunTask(std::function<void()>& task);
+
+private:
+	std::vector<std::unique_ptr<WorkQueue>> queues;
+	std::vector<std::thread> workers;
+
+	std::mutex sleepMutex;
+	std::condition_variable wakeCV;
+	std::atomic<int> queued{ 0 };   // 队列中尚未取走的任务数
+	std::atomic<int> pending{ 0 };  // 已提交但尚未执行完的任务数
+	std::atomic<unsigned> nextQueue{ 0 };
+	bool stop = false;
+};
+
+#endif // !THREAD_POOL_H
@@ -0,0 +1,121 @@
+#include "Transform.h"
+
+#include <algorithm>
+
+Transform::Transform()
+{
+	for (int i = 0; i < 3; ++i)
+		for (int j = 0; j < 4; ++j)
+			m[i][j] = i == j ? 1.0 : 0.0;
+}
+
+Transform Transform::Translate(const vec3& offset)
+{
+	Transform t;
+	for (int i = 0; i < 3; ++i)
+		t.m[i][3] = offset[i];
+	return t;
+}
+
+Transform Transform::Scale(double s)
+{
+	return Scale(vec3(s, s, s));
+}
+
+Transform Transform::Scale(const vec3& s)
+{
+	Transform t;
+	for (int i = 0; i < 3; ++i)
+		t.m[i][i] = s[i];
+	return t;
+}
+
+Transform Transform::RotateX(double degrees)
+{
+	double c = std::cos(degrees_to_radians(degrees));
+	double s = std::sin(degrees_to_radians(degrees));
+	Transform t;
+	t.m[1][1] = c; t.m[1][2] = -s;
+	t.m[2][1] = s; t.m[2][2] = c;
+	return t;
+}
+
+Transform Transform::RotateY(double degrees)
+{
+	double c = std::cos(degrees_to_radians(degrees));
+	double s = std::sin(degrees_to_radians(degrees));
+	Transform t;
+	t.m[0][0] = c; t.m[0][2] = s;
+	t.m[2][0] = -s; t.m[2][2] = c;
+	return t;
+}
+
+Transform Transform::RotateZ(double degrees)
+{
+	double c = std::cos(degrees_to_radians(degrees));
+	double s = std::sin(degrees_to_radians(degrees));
+	Transform t;
+	t.m[0][0] = c; t.m[0][1] = -s;
+	t.m[1][0] = s; t.m[1][1] = c;
+	return t;
+}
+
+Transform operator*(const Transform& a, const Transform& b)
+{
+	Transform r;
+	for (int i = 0; i < 3; ++i)
+	{
+		for (int j = 0; j < 4; ++j)
+		{
+			double sum = j == 3 ? a.m[i][3] : 0.0;
+			for (int k = 0; k < 3; ++k)
+				sum += a.m[i][k] * b.m[k][j];
+			r.m[i][j] = sum;
+		}
+	}
+	return r;
+}
+
+Transform Transform::Inverse() const
+{
+	// 3x3 部分用伴随矩阵求逆, 平移部分为 -A^-1 t
+	const auto& a = m;
+	double c00 = a[1][1] * a[2][2] - a[1][2] * a[2][1];
+	double c01 = a[1][2] * a[2][0] - a[1][0] * a[2][2];
+	double c02 = a[1][0] * a[2][1] - a[1][1] * a[2][0];
+	double invDet = 1.0 / (a[0][0] * c00 + a[0][1] * c01 + a[0][2] * c02);
+
+	Transform r;
+	r.m[0][0] = c00 * invDet;
+	r.m[0][1] = (a[0][2] * a[2][1] - a[0][1] * a[2][2]) * invDet;
+	r.m[0][2] = (a[0][1] * a[1][2] - a[0][2] * a[1][1]) * invDet;
+	r.m[1][0] = c01 * invDet;
+	r.m[1][1] = (a[0][0] * a[2][2] - a[0][2] * a[2][0]) * invDet;
+	r.m[1][2] = (a[0][2] * a[1][0] - a[0][0] * a[1][2]) * invDet;
+	r.m[2][0] = c02 * invDet;
+	r.m[2][1] = (a[0][1] * a[2][0] - a[0][0] * a[2][1]) * invDet;
+	r.m[2][2] = (a[0][0] * a[1][1] - a[0][1] * a[1][0]) * invDet;
+
+	for (int i = 0; i < 3; ++i)
+		r.m[i][3] = -(r.m[i][0] * a[0][3] + r.m[i][1] * a[1][3] + r.m[i][2] * a[2][3]);
+	return r;
+}
+
+AABB Transform::ApplyBox(const AABB& box) const
+{
+	point3 lo(infinity, infinity, infinity);
+	point3 hi(-infinity, -infinity, -infinity);
+	for (int corner = 0; corner < 8; ++corner)
+	{
+		point3 p((corner & 1) ? box.x.max : box.x.min,
+			(corner & 2) ? box.y.max : box.y.min,
+			(corner & 4) ? box.z.max : box.z.min);
+		p = ApplyPoint(p);
+		for (int a = 0; a < 3; ++a)
+		{
+			lo[a] = std::min(lo[a], p[a]);
+			hi[a] = std::max(hi[a], p[a]);
+		}
+	}
+	return AABB(lo, hi);
+}
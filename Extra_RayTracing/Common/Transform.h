@@ -0,0 +1,72 @@
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+
+#include "common.h"
+#include "AABB.h"
+
+// 仿射变换, 存放 3x4 矩阵 [A | t]: p' = A p + t
+class Transform
+{
+public:
+	Transform();	// 单位变换
+
+	static Transform Translate(const vec3& offset);
+	static Transform Scale(double s);
+	static Transform Scale(const vec3& s);
+	// 绕坐标轴旋转, 单位为角度, 右手系
+	static Transform RotateX(double degrees);
+	static Transform RotateY(double degrees);
+	static Transform RotateZ(double degrees);
+
+	// 先应用 b 再应用 a
+	friend Transform operator*(const Transform& a, const Transform& b);
+
+	// 矩阵必须可逆
+	Transform Inverse()const;
+
+	point3 ApplyPoint(const point3& p)const
+	{
+		return point3(
+			m[0][0] * p[0] + m[0][1] * p[1] + m[0][2] * p[2] + m[0][3],
+			m[1][0] * p[0] + m[1][1] * p[1] + m[1][2] * p[2] + m[1][3],
+			m[2][0] * p[0] + m[2][1] * p[1] + m[2][2] * p[2] + m[2][3]);
+	}
+	vec3 ApplyVector(const vec3& v)const
+	{
+		return vec3(
+			m[0][0] * v[0] + m[0][1] * v[1] + m[0][2] * v[2],
+			m[1][0] * v[0] + m[1][1] * v[1] + m[1][2] * v[2],
+			m[2][0] * v[0] + m[2][1] * v[1] + m[2][2] * v[2]);
+	}
+	// ApplyPoint(p) 的误差上界, pError 是 p 本身的误差: 传播过来的误差加上这次变换的舍入
+	vec3 ApplyPointError(const point3& p, const vec3& pError)const
+	{
+		vec3 result;
+		for (int i = 0; i < 3; ++i)
+		{
+			Real rounding = static_cast<Real>(std::fabs(m[i][0] * p[0]) + std::fabs(m[i][1] * p[1])
+				+ std::fabs(m[i][2] * p[2]) + std::fabs(m[i][3]));
+			Real propagated = static_cast<Real>(std::fabs(m[i][0]) * pError[0] + std::fabs(m[i][1]) * pError[1]
+				+ std::fabs(m[i][2]) * pError[2]);
+			result[i] = ErrorGamma(3) * rounding + (1 + ErrorGamma(3)) * propagated;
+		}
+		return result;
+	}
+	// 法线要乘逆矩阵的转置, 所以这里对 *this 按转置相乘, 调用者传入逆变换
+	// 结果没有归一化
+	vec3 ApplyTransposed(const vec3& n)const
+	{
+		return vec3(
+			m[0][0] * n[0] + m[1][0] * n[1] + m[2][0] * n[2],
+			m[0][1] * n[0] + m[1][1] * n[1] + m[2][1] * n[2],
+			m[0][2] * n[0] + m[1][2] * n[1] + m[2][2] * n[2]);
+	}
+
+	// 变换后的 8 个角点的包围盒
+	AABB ApplyBox(const AABB& box)const;
+
+public:
+	double m[3][4];
+};
+
+#endif // !TRANSFORM_H
@@ -22,7 +22,12 @@ inline double linear_to_gamma(double linear_component)
     return sqrt(linear_component);
 }
 
-void write_color(std::ostream& out, color pixel_color, int samples_per_pixel);
+// Rec. 709 relative luminance of a linear color
+template <typename T>
+inline T Luminance(const Vec3<T>& c)
+{
+    return 0.2126 * c.x() + 0.7152 * c.y() + 0.0722 * c.z();
+}
 
 
 #endif
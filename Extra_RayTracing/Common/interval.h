@@ -5,32 +5,32 @@
 
 class interval {
   public:
-    double min, max;
+    Real min, max;
 
     interval() : min(+infinity), max(-infinity) {} // Default interval is empty
 
-    interval(double _min, double _max) : min(_min), max(_max) {}
+    interval(Real _min, Real _max) : min(_min), max(_max) {}
     interval(const interval& a, const interval& b) 
         :min(fmin(a.min, b.min)), max(fmax(a.max, b.max)) {}
 
-    double size() const {
+    Real size() const {
         return max - min;
     }
 
-    interval expand(double delta) const {
+    interval expand(Real delta) const {
         auto padding = delta/2;
         return interval(min - padding, max + padding);
     }
 
-    bool contains(double x) const {
+    bool contains(Real x) const {
         return min <= x && x <= max;
     }
 
-    bool surrounds(double x) const {
+    bool surrounds(Real x) const {
         return min < x && x < max;
     }
 
-    double clamp(double x) const {
+    Real clamp(Real x) const {
         if (x < min) return min;
         if (x > max) return max;
         return x;
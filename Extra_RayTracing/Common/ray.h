@@ -18,21 +18,32 @@ class Ray {
   public:
     Ray() {}
 
-    Ray(const point3& origin, const vec3& direction) 
-        : orig(origin), dir(direction), t(0) {}
-    Ray(const point3& origin, const vec3& direction, double time = 0.0) 
-        : orig(origin), dir(direction), t(time) {}
-
-    point3  GetOrigin() const  { return orig; }
-    vec3    GetDirection() const { return dir; }
-    double  GetTime()const { return t; }
-
-    point3  At(double t) const { return orig + t * dir; }
+    Ray(const point3& origin, const vec3& direction, Real time = 0.0) 
+        : orig(origin), dir(direction), t(time) 
+    {
+        // Cache the reciprocal direction and its sign bits once per ray, so the
+        // slab tests of every box visited need neither divisions nor branches.
+        for (int a = 0; a < 3; ++a) {
+            inv_dir[a] = 1.0 / dir[a];
+            sign[a] = inv_dir[a] < 0;
+        }
+    }
+
+    const point3& GetOrigin() const  { return orig; }
+    const vec3&   GetDirection() const { return dir; }
+    Real          GetTime()const { return t; }
+
+    const vec3&   GetInvDirection() const { return inv_dir; }
+    int           GetSign(int axis) const { return sign[axis]; }
+
+    point3  At(Real t) const { return orig + t * dir; }
 
   private:
     point3 orig;
     vec3 dir;
-    double t;
+    Real t = 0;
+    vec3 inv_dir;
+    int sign[3] = { 0, 0, 0 };
 };
 
 #endif
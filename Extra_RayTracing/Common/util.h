@@ -5,25 +5,47 @@
 #include <limits>
 #include <memory>
 
+#include "Sampler.h"
+
 // Usings
 
 using std::shared_ptr;
 using std::make_shared;
 using std::sqrt;
 
+// 几何和颜色使用的标量类型: 默认为 double, 定义 RT_FLOAT 时 (CMake 选项 RT_FLOAT) 整个渲染器改用 float
+#ifdef RT_FLOAT
+using Real = float;
+#else
+using Real = double;
+#endif
+
 // Constants
 const double infinity = std::numeric_limits<double>::infinity();
 const double pi = 3.1415926535897932385;
 
+// 浮点误差分析: 连续 n 次 Real 运算的相对舍入误差 (1+e)^n - 1 的上界, e 为单位舍入
+constexpr Real ErrorGamma(int n) {
+    constexpr Real e = std::numeric_limits<Real>::epsilon() * Real(0.5);
+    return (n * e) / (1 - n * e);
+}
+
 // Utility Functions
 
 inline double degrees_to_radians(double degrees) {
     return degrees * pi / 180.0;
 }
 
+inline Sampler& default_sampler() {
+    // Used outside the render loop (scene setup, Perlin tables, BVH build).
+    // Each thread owns its generator, so workers never share state.
+    thread_local IndependentSampler sampler;
+    return sampler;
+}
+
 inline double random_double() {
     // Returns a random real in [0,1).
-    return rand() / (RAND_MAX + 1.0);
+    return default_sampler().Get1D();
 }
 
 inline double random_double(double min, double max) {
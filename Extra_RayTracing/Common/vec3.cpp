@@ -1,43 +1,76 @@
 #include "vec3.h"
 
 // 实现景深 散焦盘上随机点
-vec3 random_in_unit_disk()
+// 同心映射 (Shirley-Chiu), 正好消耗两个随机数, 方形上分层的样本映射到圆盘上仍然分层
+vec3 random_in_unit_disk(Sampler& sampler)
 {
-	while (true)
+	auto x = sampler.Get1D(-1, 1);
+	auto y = sampler.Get1D(-1, 1);
+	if (x == 0 && y == 0)
+		return vec3(0, 0, 0);
+
+	double r, theta;
+	if (std::fabs(x) > std::fabs(y))
+	{
+		r = x;
+		theta = (pi / 4) * (y / x);
+	}
+	else
 	{
-		auto p = vec3(random_double(-1, 1), random_double(-1, 1), 0);
-		if (p.length_squared() < 1)
-			return p;
+		r = y;
+		theta = (pi / 2) - (pi / 4) * (x / y);
 	}
+	return vec3(r * std::cos(theta), r * std::sin(theta), 0);
+}
+
+vec3 random_in_unit_disk()
+{
+	return random_in_unit_disk(default_sampler());
 }
 
 // 在球内获取一个随机点
+// 方向加上按体积均匀分布的半径, 消耗三个随机数
+vec3 random_in_unit_sphere(Sampler& sampler)
+{
+	auto direction = random_unit_vector(sampler);
+	return direction * std::cbrt(sampler.Get1D());
+}
+
 vec3 random_in_unit_sphere()
 {
-	while (true)
-	{
-		auto p = vec3::random(-1, 1);
-		if (p.length_squared() < 1)
-			return p;
-	}
+	return random_in_unit_sphere(default_sampler());
 }
 
 // 单位球体内选随机点
+// 球面上均匀分布: z 在 [-1,1] 上均匀, 方位角在 [0,2pi) 上均匀, 消耗两个随机数
+vec3 random_unit_vector(Sampler& sampler)
+{
+	auto z = 1 - 2 * sampler.Get1D();
+	auto r = std::sqrt(std::fmax(0.0, 1 - z * z));
+	auto phi = 2 * pi * sampler.Get1D();
+	return vec3(r * std::cos(phi), r * std::sin(phi), z);
+}
+
 vec3 random_unit_vector()
 {
-	return unit_vector(random_in_unit_sphere());
+	return random_unit_vector(default_sampler());
 }
 
 // 半球上随机点
-vec3 random_on_hemisphere(const vec3& normal)
+vec3 random_on_hemisphere(const vec3& normal, Sampler& sampler)
 {
-	vec3 on_uint_sphere = random_unit_vector();
+	vec3 on_uint_sphere = random_unit_vector(sampler);
 	if (dot(on_uint_sphere, normal) > 0.0)
 		return on_uint_sphere;
 	else 
 		return -on_uint_sphere;
 }
 
+vec3 random_on_hemisphere(const vec3& normal)
+{
+	return random_on_hemisphere(normal, default_sampler());
+}
+
 vec3 reflect(const vec3& v, const vec3& n)
 {
 	return v - 2 * dot(v, n) * n;
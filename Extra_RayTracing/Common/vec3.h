@@ -5,125 +5,300 @@
 #include <iostream>
 #include "util.h"
 
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define VEC3_SIMD_SSE 1
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define VEC3_SIMD_NEON 1
+#endif
+
 using std::sqrt;
 using std::fabs;
 
-class vec3 {
+// 三维向量, 按标量类型 T 模板化; 渲染器使用的 vec3 是 Vec3<Real>, 见 util.h 中的 Real
+// T 为 float 且有 SSE 或 NEON 时使用下面的 4 通道特化
+template <typename T>
+class Vec3 {
   public:
-    double e[3];
+    using value_type = T;
+
+    T e[3];
 
-    vec3() : e{0,0,0} {}
-    vec3(double e0, double e1, double e2) : e{e0, e1, e2} {}
+    Vec3() : e{0,0,0} {}
+    Vec3(T e0, T e1, T e2) : e{e0, e1, e2} {}
+    // 不同精度之间的转换, 例如 float 的颜色累加到 double 的像素和中
+    template <typename U>
+    explicit Vec3(const Vec3<U> &v) : e{T(v.e[0]), T(v.e[1]), T(v.e[2])} {}
 
-    double x() const { return e[0]; }
-    double y() const { return e[1]; }
-    double z() const { return e[2]; }
+    T x() const { return e[0]; }
+    T y() const { return e[1]; }
+    T z() const { return e[2]; }
 
-    vec3 operator-() const { return vec3(-e[0], -e[1], -e[2]); }
-    double operator[](int i) const { return e[i]; }
-    double& operator[](int i) { return e[i]; }
+    Vec3 operator-() const { return Vec3(-e[0], -e[1], -e[2]); }
+    T operator[](int i) const { return e[i]; }
+    T& operator[](int i) { return e[i]; }
 
-    vec3& operator+=(const vec3 &v) {
+    Vec3& operator+=(const Vec3 &v) {
         e[0] += v.e[0];
         e[1] += v.e[1];
         e[2] += v.e[2];
         return *this;
     }
 
-    vec3& operator*=(double t) {
+    Vec3& operator*=(T t) {
         e[0] *= t;
         e[1] *= t;
         e[2] *= t;
         return *this;
     }
 
-    vec3& operator/=(double t) {
+    Vec3& operator/=(T t) {
         return *this *= 1/t;
     }
 
-    double length() const {
+    T length() const {
         return sqrt(length_squared());
     }
 
-    double length_squared() const {
+    T length_squared() const {
         return e[0]*e[0] + e[1]*e[1] + e[2]*e[2];
     }
 
     bool near_zero() const {
         // Return true if the vector is close to zero in all dimensions.
-        auto s = 1e-8;
+        auto s = T(1e-8);
         return (fabs(e[0]) < s) && (fabs(e[1]) < s) && (fabs(e[2]) < s);
     }
 
-    static vec3 random() {
-        return vec3(random_double(), random_double(), random_double());
+    static Vec3 random() {
+        return Vec3(T(random_double()), T(random_double()), T(random_double()));
     }
 
-    static vec3 random(double min, double max) {
-        return vec3(random_double(min,max), random_double(min,max), random_double(min,max));
+    static Vec3 random(double min, double max) {
+        return Vec3(T(random_double(min,max)), T(random_double(min,max)), T(random_double(min,max)));
     }
-};
 
-// point3 is just an alias for vec3, but useful for geometric clarity in the code.
-using point3 = vec3;
+    static Vec3 random(Sampler& sampler, double min, double max) {
+        auto x = sampler.Get1D(min, max);
+        auto y = sampler.Get1D(min, max);
+        auto z = sampler.Get1D(min, max);
+        return Vec3(T(x), T(y), T(z));
+    }
+};
 
 
 // Vector Utility Functions
+// 标量参数写成 Vec3<T>::value_type, 不参与模板推导, 0.5 * v 这样的 double 常量对 float 向量也能使用
 
-inline std::ostream& operator<<(std::ostream &out, const vec3 &v) {
+template <typename T>
+inline std::ostream& operator<<(std::ostream &out, const Vec3<T> &v) {
     return out << v.e[0] << ' ' << v.e[1] << ' ' << v.e[2];
 }
 
-inline vec3 operator+(const vec3 &u, const vec3 &v) {
-    return vec3(u.e[0] + v.e[0], u.e[1] + v.e[1], u.e[2] + v.e[2]);
+template <typename T>
+inline Vec3<T> operator+(const Vec3<T> &u, const Vec3<T> &v) {
+    return Vec3<T>(u.e[0] + v.e[0], u.e[1] + v.e[1], u.e[2] + v.e[2]);
 }
 
-inline vec3 operator-(const vec3 &u, const vec3 &v) {
-    return vec3(u.e[0] - v.e[0], u.e[1] - v.e[1], u.e[2] - v.e[2]);
+template <typename T>
+inline Vec3<T> operator-(const Vec3<T> &u, const Vec3<T> &v) {
+    return Vec3<T>(u.e[0] - v.e[0], u.e[1] - v.e[1], u.e[2] - v.e[2]);
 }
 
-inline vec3 operator*(const vec3 &u, const vec3 &v) {
-    return vec3(u.e[0] * v.e[0], u.e[1] * v.e[1], u.e[2] * v.e[2]);
+template <typename T>
+inline Vec3<T> operator*(const Vec3<T> &u, const Vec3<T> &v) {
+    return Vec3<T>(u.e[0] * v.e[0], u.e[1] * v.e[1], u.e[2] * v.e[2]);
 }
 
-inline vec3 operator*(double t, const vec3 &v) {
-    return vec3(t*v.e[0], t*v.e[1], t*v.e[2]);
+template <typename T>
+inline Vec3<T> operator*(typename Vec3<T>::value_type t, const Vec3<T> &v) {
+    return Vec3<T>(t*v.e[0], t*v.e[1], t*v.e[2]);
 }
 
-inline vec3 operator*(const vec3 &v, double t) {
+template <typename T>
+inline Vec3<T> operator*(const Vec3<T> &v, typename Vec3<T>::value_type t) {
     return t * v;
 }
 
-inline vec3 operator/(vec3 v, double t) {
+template <typename T>
+inline Vec3<T> operator/(Vec3<T> v, typename Vec3<T>::value_type t) {
     return (1/t) * v;
 }
 
-inline double dot(const vec3 &u, const vec3 &v) {
+template <typename T>
+inline T dot(const Vec3<T> &u, const Vec3<T> &v) {
     return u.e[0] * v.e[0]
          + u.e[1] * v.e[1]
          + u.e[2] * v.e[2];
 }
 
-inline vec3 cross(const vec3 &u, const vec3 &v) {
-    return vec3(u.e[1] * v.e[2] - u.e[2] * v.e[1],
-                u.e[2] * v.e[0] - u.e[0] * v.e[2],
-                u.e[0] * v.e[1] - u.e[1] * v.e[0]);
+template <typename T>
+inline Vec3<T> cross(const Vec3<T> &u, const Vec3<T> &v) {
+    return Vec3<T>(u.e[1] * v.e[2] - u.e[2] * v.e[1],
+                   u.e[2] * v.e[0] - u.e[0] * v.e[2],
+                   u.e[0] * v.e[1] - u.e[1] * v.e[0]);
 }
 
-inline vec3 unit_vector(vec3 v) {
+template <typename T>
+inline Vec3<T> unit_vector(Vec3<T> v) {
     return v / v.length();
 }
 
+// 各分量的绝对值
+template <typename T>
+inline Vec3<T> abs(const Vec3<T> &v) {
+    return Vec3<T>(fabs(v.e[0]), fabs(v.e[1]), fabs(v.e[2]));
+}
+
+
+#if defined(VEC3_SIMD_SSE) || defined(VEC3_SIMD_NEON)
+namespace vec3_simd {
+#if defined(VEC3_SIMD_SSE)
+    using float4 = __m128;
+    inline float4 Load(const float* p) { return _mm_load_ps(p); }
+    inline void Store(float* p, float4 v) { _mm_store_ps(p, v); }
+    inline float4 Set(float v) { return _mm_set1_ps(v); }
+    inline float4 Add(float4 a, float4 b) { return _mm_add_ps(a, b); }
+    inline float4 Sub(float4 a, float4 b) { return _mm_sub_ps(a, b); }
+    inline float4 Mul(float4 a, float4 b) { return _mm_mul_ps(a, b); }
+    inline float4 Neg(float4 a) { return _mm_xor_ps(a, _mm_set1_ps(-0.0f)); }
+    inline float4 Abs(float4 a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+#else
+    using float4 = float32x4_t;
+    inline float4 Load(const float* p) { return vld1q_f32(p); }
+    inline void Store(float* p, float4 v) { vst1q_f32(p, v); }
+    inline float4 Set(float v) { return vdupq_n_f32(v); }
+    inline float4 Add(float4 a, float4 b) { return vaddq_f32(a, b); }
+    inline float4 Sub(float4 a, float4 b) { return vsubq_f32(a, b); }
+    inline float4 Mul(float4 a, float4 b) { return vmulq_f32(a, b); }
+    inline float4 Neg(float4 a) { return vnegq_f32(a); }
+    inline float4 Abs(float4 a) { return vabsq_f32(a); }
+#endif
+}
+
+// float 向量占满一个 128 位寄存器, 第 4 个通道恒为 0, 逐分量的运算各是一条 SIMD 指令
+// 点积和叉积的通道重排在 SSE2 下并不比标量快, 仍然逐分量计算
+template <>
+class alignas(16) Vec3<float> {
+  public:
+    using value_type = float;
+
+    float e[4];
+
+    Vec3() : e{0,0,0,0} {}
+    Vec3(float e0, float e1, float e2) : e{e0, e1, e2, 0} {}
+    template <typename U>
+    explicit Vec3(const Vec3<U> &v) : e{float(v.e[0]), float(v.e[1]), float(v.e[2]), 0} {}
+    explicit Vec3(vec3_simd::float4 v) { vec3_simd::Store(e, v); }
+
+    vec3_simd::float4 simd() const { return vec3_simd::Load(e); }
+
+    float x() const { return e[0]; }
+    float y() const { return e[1]; }
+    float z() const { return e[2]; }
+
+    Vec3 operator-() const { return Vec3(vec3_simd::Neg(simd())); }
+    float operator[](int i) const { return e[i]; }
+    float& operator[](int i) { return e[i]; }
+
+    Vec3& operator+=(const Vec3 &v) {
+        vec3_simd::Store(e, vec3_simd::Add(simd(), v.simd()));
+        return *this;
+    }
+
+    Vec3& operator*=(float t) {
+        vec3_simd::Store(e, vec3_simd::Mul(simd(), vec3_simd::Set(t)));
+        return *this;
+    }
+
+    Vec3& operator/=(float t) {
+        return *this *= 1/t;
+    }
+
+    float length() const {
+        return sqrt(length_squared());
+    }
+
+    float length_squared() const {
+        return e[0]*e[0] + e[1]*e[1] + e[2]*e[2];
+    }
+
+    bool near_zero() const {
+        // Return true if the vector is close to zero in all dimensions.
+        auto s = 1e-8f;
+        return (fabs(e[0]) < s) && (fabs(e[1]) < s) && (fabs(e[2]) < s);
+    }
+
+    static Vec3 random() {
+        return Vec3(float(random_double()), float(random_double()), float(random_double()));
+    }
+
+    static Vec3 random(double min, double max) {
+        return Vec3(float(random_double(min,max)), float(random_double(min,max)), float(random_double(min,max)));
+    }
+
+    static Vec3 random(Sampler& sampler, double min, double max) {
+        auto x = sampler.Get1D(min, max);
+        auto y = sampler.Get1D(min, max);
+        auto z = sampler.Get1D(min, max);
+        return Vec3(float(x), float(y), float(z));
+    }
+};
+
+// 比上面的模板更匹配, 重载决议优先选择这些非模板版本
+inline Vec3<float> operator+(const Vec3<float> &u, const Vec3<float> &v) {
+    return Vec3<float>(vec3_simd::Add(u.simd(), v.simd()));
+}
+
+inline Vec3<float> operator-(const Vec3<float> &u, const Vec3<float> &v) {
+    return Vec3<float>(vec3_simd::Sub(u.simd(), v.simd()));
+}
+
+inline Vec3<float> operator*(const Vec3<float> &u, const Vec3<float> &v) {
+    return Vec3<float>(vec3_simd::Mul(u.simd(), v.simd()));
+}
+
+inline Vec3<float> operator*(float t, const Vec3<float> &v) {
+    return Vec3<float>(vec3_simd::Mul(vec3_simd::Set(t), v.simd()));
+}
+
+inline Vec3<float> operator*(const Vec3<float> &v, float t) {
+    return t * v;
+}
+
+inline Vec3<float> operator/(const Vec3<float> &v, float t) {
+    return (1/t) * v;
+}
+
+inline Vec3<float> abs(const Vec3<float> &v) {
+    return Vec3<float>(vec3_simd::Abs(v.simd()));
+}
+#endif
+
+
+using vec3 = Vec3<Real>;
+
+// point3 is just an alias for vec3, but useful for geometric clarity in the code.
+using point3 = vec3;
+
+// 以下随机函数都有带 Sampler 的版本, 渲染线程使用各自的采样器;
+// 不带参数的版本使用当前线程的 default_sampler()
+
 // 实现景深 散焦盘上随机点
+vec3 random_in_unit_disk(Sampler& sampler);
 vec3 random_in_unit_disk();
 
 // 在球内获取一个随机点
+vec3 random_in_unit_sphere(Sampler& sampler);
 vec3 random_in_unit_sphere();
 
 // 单位球体内选随机点
+vec3 random_unit_vector(Sampler& sampler);
 vec3 random_unit_vector();
 
 // 半球上随机点
+vec3 random_on_hemisphere(const vec3& normal, Sampler& sampler);
 vec3 random_on_hemisphere(const vec3& normal);
 
 // 反射
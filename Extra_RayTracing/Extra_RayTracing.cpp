@@ -3,69 +3,35 @@
 #include "camera.h"
 #include "hittable_list.h"
 #include "BVH.h"
+#include "WideBVH.h"
+#include "benchmark.h"
 #include "material.h"
+#include "material_variant.h"
+#include "scene.h"
 #include "sphere.h"
 #include "Common/Texture.h"
 
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
 
-void RandomSpheresScene() 
-{
-    hittable_list world;
-
-    auto ground_maerial = make_shared<Lambertian>(color(0.5, 0.5, 0.5));
-    auto checker = make_shared<CheckerTexture>(0.32, color(0.2, 0.3, 0.1), color(0.9, 0.9, 0.9));
-    world.add(make_shared<sphere>(point3(0, -1000, 0), 1000, make_shared<Lambertian>(checker)));
-
-    double r = 0.2;
-    for (int i = -11; i < 11; ++i) 
-    {
-        for (int j = -11; j < 11; ++j) 
-        {
-            auto choose_mat = random_double();
-            point3 center(i + 0.9 * random_double(), 0.2, j + 0.9 * random_double());
-
-            if ((center - point3(4, 0.2, 0)).length() > 0.9) 
-            {
-                shared_ptr<Material> material;
-                if (choose_mat < 0.8) 
-                {
-                    //diffuse
-                    auto albedo = color::random() * color::random();
-                    material = make_shared<Lambertian>(albedo);
-                    auto cen2 = center + vec3(0, random_double(0, 0.5f), 0);
-                    world.add(make_shared<sphere>(center, cen2, r, material));
-                }
-                else if (choose_mat < 0.95) 
-                {
-                    auto albedo = color::random() * color::random();
-                    auto fuzz = random_double(0, 0.5);
-                    material = make_shared<Metal>(albedo, fuzz);
-                    world.add(make_shared<sphere>(center, r, material));
-                }
-                else 
-                {
-                    // glass
-                    material = make_shared<Dielectric>(1.5);
-                    world.add(make_shared<sphere>(center, r, material));
-                }
-            }
-        }
-    }
-
-    auto material1 = make_shared<Dielectric>(1.5);
-    world.add(make_shared<sphere>(point3(0, 1, 0), 1.0, material1));
 
-    auto material2 = make_shared<Lambertian>(color(0.4, 0.2, 0.1));
-    world.add(make_shared<sphere>(point3(-4, 1, 0), 1.0, material2));
+// --closed-materials: 场景中 sphere 和 triangle_mesh 的材质换成 std::variant 分派的 ClosedMaterial
+static bool closedMaterials = false;
 
-    auto material3 = make_shared<Metal>(color(0.7, 0.6, 0.5), 0.0);
-    world.add(make_shared<sphere>(point3(4, 1, 0), 1.0, material3));
-
-    world = hittable_list(make_shared<BVHNode>(world));
+void PrepareMaterials(hittable_list& world)
+{
+    if (!closedMaterials)
+        return;
+    auto library = MaterialLibrary::Close(world);
+    if (library->MaterialCount() == 0)
+        std::cerr << "--closed-materials: no material in this scene was converted\n";
+}
 
+void SetupRandomSpheresCamera(Camera& camera)
+{
     // Camera
-    Camera camera;
-
     // Image
     camera.aspect_ratio = 16.0 / 9.0;
     camera.image_width = 400;
@@ -79,26 +45,61 @@ void RandomSpheresScene()
 
     camera.defocus_angle = 0.02;
     camera.focus_dist = 10.0;
+}
 
-    // Render
-    camera.Render(world);
+hittable_list RandomSpheresScene(Camera& camera)
+{
+    auto world = RandomSpheresWorld();
+    world = hittable_list(make_shared<BVH8>(world, BVHSplitMethod::SAH));
+
+    SetupRandomSpheresCamera(camera);
+    return world;
 }
 
-void TwoSpheresScene()
+// 逐帧渲染小球运动的 RandomSpheresScene, 每帧写到 output_path 加上帧号的文件中
+// 每帧只 Refit() 场景的 BVH, 树的质量下降过多时才重建
+int RenderRandomSpheresAnimation(Camera& camera, int frameCount, int samplesPerPixel)
 {
-    hittable_list world;
+    auto spheres = RandomSpheresWorld();
+    RandomSpheresAnimation animation(spheres);
+    auto bvh = make_shared<BVH8>(spheres, BVHSplitMethod::SAH);
+    hittable_list world(bvh);
 
-    //auto checker = make_shared<CheckerTexture>(0.8, color(0.2, 0.3, 0.1), color(0.9, 0.9, 0.9));
-    //world.add(make_shared<sphere>(point3(0, -10, 0), 10, make_shared<Lambertian>(checker)));
-    //world.add(make_shared<sphere>(point3(0, 10, 0), 10, make_shared<Lambertian>(checker)));
+    SetupRandomSpheresCamera(camera);
+    if (samplesPerPixel > 0)
+        camera.samples_per_pixel = samplesPerPixel;
 
-    auto noise = make_shared<NoiseTexture>(2);
-    world.add(make_shared<sphere>(point3(0, -1000, 0), 1000, make_shared<Lambertian>(noise)));
-    world.add(make_shared<sphere>(point3(0, 2, 0), 2, make_shared<Lambertian>(noise)));
+    // 每帧的场景都不同, 断点文件无法复用
+    camera.checkpoint_path.clear();
 
-    // Camera
-    Camera camera;
+    auto pattern = camera.output_path;
+    auto dot = pattern.find_last_of('.');
+    auto stem = pattern.substr(0, dot);
+    auto extension = dot == std::string::npos ? std::string() : pattern.substr(dot);
 
+    const double framesPerSecond = 24.0;
+    for (int frame = 0; frame < frameCount; ++frame)
+    {
+        animation.SetTime(frame / framesPerSecond);
+
+        auto start = std::chrono::steady_clock::now();
+        bool rebuilt = bvh->Update();
+        double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        char number[16];
+        std::snprintf(number, sizeof(number), "_%04d", frame);
+        camera.output_path = stem + number + extension;
+        std::clog << "Frame " << frame << ": BVH " << (rebuilt ? "rebuilt" : "refit") << " in " << milliseconds << " ms\n";
+        camera.Render(world);
+    }
+    return 0;
+}
+
+hittable_list TwoSpheresScene(Camera& camera)
+{
+    auto world = TwoSpheresWorld();
+
+    // Camera
     // Image
     camera.aspect_ratio = 16.0 / 9.0;
     camera.image_width = 400;
@@ -112,19 +113,16 @@ void TwoSpheresScene()
 
     camera.defocus_angle = 0;
 
-    // Render
-    camera.Render(world);
+    return world;
 }
 
-void EarthScene() 
+hittable_list EarthScene(Camera& camera)
 {
     auto earthTexture = make_shared<ImageTexture>("earthmap.jpg");
     auto earthSurface = make_shared<Lambertian>(earthTexture);
     auto earth = make_shared<sphere>(point3(0, 0, 0), 2, earthSurface);
 
     // Camera
-    Camera camera;
-
     // Image
     camera.aspect_ratio = 16.0 / 9.0;
     camera.image_width = 400;
@@ -138,28 +136,162 @@ void EarthScene()
 
     camera.defocus_angle = 0;
 
-    // Render
-    camera.Render(hittable_list(earth));
+    return hittable_list(earth);
+}
+hittable_list SkullScene(Camera& camera)
+{
+    auto world = SkullWorld();
+
+    // Camera
+    // Image
+    camera.aspect_ratio = 16.0 / 9.0;
+    camera.image_width = 400;
+    camera.samples_per_pixel = 100;
+    camera.max_depth = 50;
+
+    camera.vfov = 30;
+    camera.lookfrom = point3(8, 6, -14);
+    camera.lookat = point3(0, 3, 0);
+    camera.vup = vec3(0, 1, 0);
 
+    camera.defocus_angle = 0;
+
+    return world;
 }
+hittable_list SkullFieldScene(Camera& camera)
+{
+    auto world = SkullFieldWorld(100);
 
+    // Camera
+    // Image
+    camera.aspect_ratio = 16.0 / 9.0;
+    camera.image_width = 400;
+    camera.samples_per_pixel = 100;
+    camera.max_depth = 50;
 
-int main()
+    camera.vfov = 40;
+    camera.lookfrom = point3(-615, 20, -615);
+    camera.lookat = point3(-560, 2, -560);
+    camera.vup = vec3(0, 1, 0);
+
+    camera.defocus_angle = 0;
+
+    return world;
+}
+
+
+int main(int argc, char* argv[])
 {
+    Camera camera;
+    int scene = 2;
+    int samples_per_pixel = 0;
+    int frame_count = 0;
+    std::string benchmark;
+    BenchmarkOptions benchmark_options;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc)
+            camera.thread_count = std::atoi(argv[++i]);
+        else if (arg == "--seed" && i + 1 < argc)
+            camera.seed = static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10));
+        else if (arg == "--scene" && i + 1 < argc)
+            scene = std::atoi(argv[++i]);
+        else if (arg == "--output" && i + 1 < argc)
+            camera.output_path = argv[++i];
+        else if (arg == "--frames" && i + 1 < argc)
+            frame_count = std::atoi(argv[++i]);
+        else if (arg == "--spp" && i + 1 < argc)
+            samples_per_pixel = std::atoi(argv[++i]);
+        else if (arg == "--pass" && i + 1 < argc)
+            camera.pass_samples = std::atoi(argv[++i]);
+        else if (arg == "--checkpoint" && i + 1 < argc)
+            camera.checkpoint_path = argv[++i];
+        else if (arg == "--checkpoint-interval" && i + 1 < argc)
+            camera.checkpoint_interval = std::atof(argv[++i]);
+        else if (arg == "--sampler" && i + 1 < argc && ParseSamplerType(argv[i + 1], camera.sampler_type))
+            ++i;
+        else if (arg == "--adaptive" && i + 1 < argc)
+        {
+            camera.adaptive_sampling = true;
+            camera.adaptive_error = std::atof(argv[++i]);
+        }
+        else if (arg == "--packets")
+            camera.packet_primary = true;
+        else if (arg == "--wavefront")
+            camera.wavefront = true;
+        else if (arg == "--closed-materials")
+            closedMaterials = true;
+        else if (arg == "--offsets" && i + 1 < argc && (std::strcmp(argv[i + 1], "epsilon") == 0 || std::strcmp(argv[i + 1], "robust") == 0))
+            camera.robust_offsets = std::strcmp(argv[++i], "robust") == 0;
+        else if (arg == "--bench" && i + 1 < argc)
+            benchmark = argv[++i];
+        else if (arg == "--count" && i + 1 < argc)
+            benchmark_options.primitive_count = std::strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--rays" && i + 1 < argc)
+            benchmark_options.ray_count = std::strtoull(argv[++i], nullptr, 10);
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [--scene 1|2|3|4|5] [--threads N] [--seed N] [--output image.png|ppm|pfm|hdr]\n"
+                      << "       " << std::string(std::strlen(argv[0]), ' ') << " [--spp N] [--pass N] [--checkpoint file] [--checkpoint-interval seconds] [--adaptive error]\n"
+                      << "       " << std::string(std::strlen(argv[0]), ' ') << " [--sampler independent|stratified|sobol|bluenoise] [--frames N] [--packets] [--wavefront] [--closed-materials]\n"
+                      << "       " << std::string(std::strlen(argv[0]), ' ') << " [--offsets epsilon|robust]\n"
+                      << "       " << argv[0] << " --bench bvh|leaf|build|wide|box|material|surface|roulette|output|adaptive|sampler|mesh|instance|tlas|refit|motion|sphereset|packet|wavefront|variant|precision [--count N] [--rays N]\n";
+            return 1;
+        }
+    }
+
+    if (!benchmark.empty())
+    {
+        if (RunBenchmark(benchmark, benchmark_options))
+            return 0;
+        std::cerr << "Unknown benchmark '" << benchmark << "'\n";
+        return 1;
+    }
+
+    if (frame_count > 0)
+    {
+        if (scene != 1 || camera.output_path.empty())
+        {
+            std::cerr << "--frames needs --scene 1 and --output\n";
+            return 1;
+        }
+        return RenderRandomSpheresAnimation(camera, frame_count, samples_per_pixel);
+    }
+
     // World
-    switch (2)
+    hittable_list world;
+    switch (scene)
     {
     case 1:
-        RandomSpheresScene();
+        world = RandomSpheresScene(camera);
         break;
     case 2:
-        TwoSpheresScene();
+        world = TwoSpheresScene(camera);
         break;
     case 3:
-        EarthScene();
+        world = EarthScene(camera);
+        break;
+    case 4:
+        world = SkullScene(camera);
         break;
+    case 5:
+        world = SkullFieldScene(camera);
+        break;
+    }
+    if (world.objects.empty())
+    {
+        std::cerr << "Scene " << scene << " has nothing to render\n";
+        return 1;
     }
+    PrepareMaterials(world);
+
+    if (samples_per_pixel > 0)
+        camera.samples_per_pixel = samples_per_pixel;
+
+    // Render
+    camera.Render(world);
 
     return 0;
 }
-
@@ -0,0 +1,120 @@
+#include "LinearBVH.h"
+
+#include <algorithm>
+#include <cmath>
+
+LinearBVH::LinearBVH(const BVHNode& root)
+	:bbox(root.BoundingBox())
+{
+	Flatten(root, 1);
+	builtCost = SAHCost();
+}
+
+LinearBVH::LinearBVH(const hittable_list& list, BVHSplitMethod method, size_t maxLeafSize, int threadCount)
+	:bbox(list.BoundingBox()), method(method), maxLeafSize(maxLeafSize), threadCount(threadCount)
+{
+	Build(list.objects);
+}
+
+void LinearBVH::Build(const std::vector<shared_ptr<hittable>>& objects)
+{
+	BVHBuilder builder(method, maxLeafSize, threadCount);
+	std::vector<uint32_t> indices;
+	builder.Build(objects.size(), [&](size_t i) { return objects[i]->BoundingBox(); }, nodes, indices);
+
+	primitives = ReorderPrimitives(objects, indices);
+
+	buildStats = builder.Stats();
+	maxDepth = buildStats.maxDepth;
+	builtCost = SAHCost();
+}
+
+void LinearBVH::Refit()
+{
+	RefitLinearBVH(nodes, [&](size_t i) { return primitives[i]->BoundingBox(); });
+	bbox = UnionBounds(primitives);
+}
+
+void LinearBVH::Rebuild()
+{
+	bbox = UnionBounds(primitives);
+	Build(primitives);
+}
+
+bool LinearBVH::Update(double maxCostRatio)
+{
+	return RefitOrRebuild(*this, builtCost, maxCostRatio);
+}
+
+uint32_t LinearBVH::Flatten(const BVHNode& node, int depth)
+{
+	maxDepth = std::max(maxDepth, depth);
+
+	if (node.IsLeaf())
+		return AddLeaf(node);
+
+	// 选择两个子节点中心相距最远的轴, 沿该轴较小的一侧作为第一个子节点
+	auto delta = node.right->BoundingBox().Centroid() - node.left->BoundingBox().Centroid();
+	int axis = 0;
+	for (int a = 1; a < 3; ++a)
+		if (std::fabs(delta[a]) > std::fabs(delta[axis]))
+			axis = a;
+
+	const auto& first = (delta[axis] >= 0) ? node.left : node.right;
+	const auto& second = (delta[axis] >= 0) ? node.right : node.left;
+
+	auto index = static_cast<uint32_t>(nodes.size());
+	nodes.emplace_back();
+	SetBounds(nodes[index], node.BoundingBox());
+	nodes[index].primitiveCount = 0;
+	nodes[index].axis = static_cast<uint8_t>(axis);
+
+	Flatten(*first, depth + 1);
+	auto secondIndex = Flatten(*second, depth + 1);
+	nodes[index].secondChildOffset = secondIndex;
+
+	return index;
+}
+
+uint32_t LinearBVH::AddLeaf(const BVHNode& leaf)
+{
+	auto index = static_cast<uint32_t>(nodes.size());
+	nodes.emplace_back();
+
+	auto& node = nodes[index];
+	SetBounds(node, leaf.BoundingBox());
+	node.primitivesOffset = static_cast<uint32_t>(primitives.size());
+	node.primitiveCount = static_cast<uint16_t>(leaf.primitiveCount);
+	node.axis = 0;
+
+	auto begin = leaf.primitives->begin() + leaf.primitiveStart;
+	primitives.insert(primitives.end(), begin, begin + leaf.primitiveCount);
+	return index;
+}
+
+void LinearBVH::SetBounds(LinearBVHNode& node, const AABB& box)
+{
+	for (int a = 0; a < 3; ++a)
+	{
+		node.boundsMin[a] = RoundDown(box.axis(a).min);
+		node.boundsMax[a] = RoundUp(box.axis(a).max);
+	}
+	node.pad = 0;
+}
+
+bool LinearBVH::hit(const Ray& r, interval ray_t, hit_record& rec) const
+{
+	return TraverseLinearBVH(nodes, maxDepth, r, ray_t, [&](const LinearBVHNode& node, interval& t)
+		{
+			bool hitLeaf = false;
+			for (uint32_t i = 0; i < node.primitiveCount; ++i)
+			{
+				if (primitives[node.primitivesOffset + i]->hit(r, t, rec))
+				{
+					hitLeaf = true;
+					t.max = rec.t;
+				}
+			}
+			return hitLeaf;
+		});
+}
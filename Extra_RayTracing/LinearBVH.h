@@ -0,0 +1,58 @@
+#ifndef LINEAR_BVH_H
+#define LINEAR_BVH_H
+
+#include "Common/common.h"
+
+#include "BVH.h"
+#include "BVHBuilder.h"
+#include "hittable_list.h"
+
+// 扁平化的 BVH, 所有节点在一段连续内存中, 子节点用下标引用,
+// 遍历使用显式栈而不是递归的虚函数调用
+class LinearBVH :public hittable
+{
+public:
+	// 由已有的 BVHNode 树展开
+	LinearBVH(const BVHNode& root);
+	// 用 BVHBuilder 直接构建, threadCount <= 0 时使用全部硬件线程
+	LinearBVH(const hittable_list& list, BVHSplitMethod method = BVHSplitMethod::SAH,
+		size_t maxLeafSize = BVHNode::DefaultMaxLeafSize, int threadCount = 0);
+
+	bool hit(const Ray& r, interval ray_t, hit_record& rec)const override;
+	AABB BoundingBox()const override { return bbox; }
+
+	size_t NodeCount()const { return nodes.size(); }
+	size_t PrimitiveCount()const { return primitives.size(); }
+	// 按叶子顺序排列的图元
+	const std::vector<shared_ptr<hittable>>& Primitives()const { return primitives; }
+	const BVHBuildStats& BuildStats()const { return buildStats; }
+
+	// 图元移动后 (例如 sphere::SetCenter) 更新树, 与 TopLevelBVH 相同:
+	// Refit() 保持拓扑只更新包围盒, Rebuild() 用 BVHBuilder 重新构建,
+	// Update() 先 Refit(), SAH 代价超过上次重建时的 maxCostRatio 倍再 Rebuild(), 返回是否重建
+	void Refit();
+	void Rebuild();
+	bool Update(double maxCostRatio = kDefaultRebuildCostRatio);
+	double SAHCost()const { return LinearBVHSAHCost(nodes); }
+
+private:
+	void Build(const std::vector<shared_ptr<hittable>>& objects);
+
+	uint32_t Flatten(const BVHNode& node, int depth);
+	uint32_t AddLeaf(const BVHNode& leaf);
+	void SetBounds(LinearBVHNode& node, const AABB& box);
+
+private:
+	std::vector<LinearBVHNode> nodes;
+	std::vector<shared_ptr<hittable>> primitives;
+	AABB bbox;
+	int maxDepth = 0;
+	BVHBuildStats buildStats;
+
+	BVHSplitMethod method = BVHSplitMethod::SAH;
+	size_t maxLeafSize = BVHNode::DefaultMaxLeafSize;
+	int threadCount = 0;
+	double builtCost = 0;	// 上次构建之后的 SAH 代价
+};
+
+#endif // !LINEAR_BVH_H
@@ -0,0 +1,126 @@
+#include "RayStream.h"
+
+#include <algorithm>
+
+namespace
+{
+	// 把不超过 10 位的整数的各位之间插入两个 0
+	uint32_t SpreadBits(uint32_t v)
+	{
+		v = (v | (v << 16)) & 0x030000FF;
+		v = (v | (v << 8)) & 0x0300F00F;
+		v = (v | (v << 4)) & 0x030C30C3;
+		v = (v | (v << 2)) & 0x09249249;
+		return v;
+	}
+
+	// 起点在射线起点的包围盒中归一化后每轴 9 位的 Morton 码, 之后是方向的 3 个符号位:
+	// 先保证 packet 中的射线起点相邻, 同一小块区域内再按方向所在的象限分开
+	uint32_t SortKey(const Ray& r, const double lo[3], const double scale[3])
+	{
+		uint32_t key = 0;
+		for (int a = 0; a < 3; ++a)
+		{
+			auto cell = static_cast<uint32_t>(std::clamp((r.GetOrigin()[a] - lo[a]) * scale[a], 0.0, 511.0));
+			key |= SpreadBits(cell) << (3 + a);
+			key |= static_cast<uint32_t>(r.GetSign(a)) << a;
+		}
+		return key;
+	}
+
+	// 按高 32 位中的 kKeyBits 位做 LSD 基数排序, 每趟 kDigitBits 位; 稳定, 键相同的射线保持原来的顺序
+	constexpr int kKeyBits = 30;
+	constexpr int kDigitBits = 8;
+
+	void RadixSort(std::vector<uint64_t>& keys, std::vector<uint64_t>& scratch)
+	{
+		constexpr size_t kBuckets = size_t(1) << kDigitBits;
+		scratch.resize(keys.size());
+		for (int shift = 32; shift < 32 + kKeyBits; shift += kDigitBits)
+		{
+			size_t offsets[kBuckets] = {};
+			for (uint64_t key : keys)
+				offsets[(key >> shift) & (kBuckets - 1)]++;
+			size_t sum = 0;
+			for (auto& offset : offsets)
+			{
+				size_t n = offset;
+				offset = sum;
+				sum += n;
+			}
+			for (uint64_t key : keys)
+				scratch[offsets[(key >> shift) & (kBuckets - 1)]++] = key;
+			keys.swap(scratch);
+		}
+	}
+}
+
+size_t RayStream::Intersect(const hittable& world, const Ray* rays, size_t count, interval ray_t, hit_record* recs)
+{
+	keys.resize(count);
+	if (sortRays)
+	{
+		// 按射线起点而不是场景的范围归一化, 场景中很大的物体 (例如地面) 不会让所有起点落进同一格
+		double lo[3], hi[3], scale[3];
+		for (int a = 0; a < 3; ++a)
+		{
+			lo[a] = infinity;
+			hi[a] = -infinity;
+		}
+		for (size_t i = 0; i < count; ++i)
+		{
+			for (int a = 0; a < 3; ++a)
+			{
+				lo[a] = std::min<double>(lo[a], rays[i].GetOrigin()[a]);
+				hi[a] = std::max<double>(hi[a], rays[i].GetOrigin()[a]);
+			}
+		}
+		for (int a = 0; a < 3; ++a)
+			scale[a] = hi[a] > lo[a] ? 511.0 / (hi[a] - lo[a]) : 0.0;
+
+		for (size_t i = 0; i < count; ++i)
+			keys[i] = static_cast<uint64_t>(SortKey(rays[i], lo, scale)) << 32 | i;
+		RadixSort(keys, scratch);
+	}
+	else
+	{
+		for (size_t i = 0; i < count; ++i)
+			keys[i] = i;
+	}
+
+	size_t hitCount = 0;
+	if (!usePackets)
+	{
+		for (size_t k = 0; k < count; ++k)
+		{
+			auto i = static_cast<uint32_t>(keys[k]);
+			recs[i] = hit_record();
+			hitCount += world.hit(rays[i], ray_t, recs[i]);
+		}
+		return hitCount;
+	}
+
+	RayPacket packet;
+	interval packetT[RayPacket::kSize];
+	hit_record packetRecs[RayPacket::kSize];
+	for (size_t first = 0; first < count; first += RayPacket::kSize)
+	{
+		packet.Clear();
+		size_t last = std::min(first + RayPacket::kSize, count);
+		for (size_t k = first; k < last; ++k)
+		{
+			int lane = packet.Add(rays[static_cast<uint32_t>(keys[k])]);
+			packetT[lane] = ray_t;
+			packetRecs[lane] = hit_record();
+		}
+
+		int hits = world.HitPacket(packet, packetT, packetRecs, packet.Mask());
+		for (size_t k = first; k < last; ++k)
+		{
+			int lane = static_cast<int>(k - first);
+			recs[static_cast<uint32_t>(keys[k])] = packetRecs[lane];
+			hitCount += (hits >> lane) & 1;
+		}
+	}
+	return hitCount;
+}
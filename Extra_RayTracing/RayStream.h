@@ -0,0 +1,33 @@
+#ifndef RAY_STREAM_H
+#define RAY_STREAM_H
+
+#include "Common/common.h"
+
+#include "hittable.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// 一批彼此无关的射线 (例如所有路径的同一次弹射) 的求交
+// 先按起点的 Morton 码和方向所在的象限排序, 起点相邻, 方向大致相同的射线组成一个 RayPacket,
+// 再逐个 packet 调用 world.HitPacket(), 让不相干的射线也能共享 BVH 节点的访问
+class RayStream
+{
+public:
+	// sortRays 为 false 时按原来的顺序分组, 用于对比
+	// usePackets 为 false 时仍然排序, 但排好序后逐条调用 hit()
+	explicit RayStream(bool sortRays = true, bool usePackets = true) :sortRays(sortRays), usePackets(usePackets) {}
+
+	// 求交 rays[0, count), recs[i] 是 rays[i] 的结果, 未命中时 recs[i].object 为 nullptr
+	// 返回命中的射线数; 排序用的缓冲区在多次调用之间复用
+	size_t Intersect(const hittable& world, const Ray* rays, size_t count, interval ray_t, hit_record* recs);
+
+private:
+	bool sortRays;
+	bool usePackets;
+	std::vector<uint64_t> keys;	// 高 32 位是排序键, 低 32 位是射线的下标
+	std::vector<uint64_t> scratch;
+};
+
+#endif // !RAY_STREAM_H
@@ -0,0 +1,68 @@
+#include "TopLevelBVH.h"
+
+TopLevelBVH::TopLevelBVH(std::vector<shared_ptr<instance>> instances, int threadCount)
+	:instances(std::move(instances)), threadCount(threadCount)
+{
+	slots.resize(this->instances.size());
+	for (size_t i = 0; i < slots.size(); ++i)
+		slots[i] = static_cast<uint32_t>(i);
+	Rebuild();
+}
+
+void TopLevelBVH::Rebuild()
+{
+	BVHBuilder builder(BVHSplitMethod::SAH, BVHNode::DefaultMaxLeafSize, threadCount);
+	std::vector<uint32_t> order;
+	builder.Build(instances.size(), [&](size_t i) { return instances[i]->BoundingBox(); }, nodes, order);
+
+	// 按叶子顺序重排实例, 同时更新 id 到位置的映射
+	std::vector<shared_ptr<instance>> sorted(instances.size());
+	std::vector<uint32_t> positionToId(instances.size());
+	for (size_t i = 0; i < slots.size(); ++i)
+		positionToId[slots[i]] = static_cast<uint32_t>(i);
+	for (size_t k = 0; k < order.size(); ++k)
+	{
+		sorted[k] = std::move(instances[order[k]]);
+		slots[positionToId[order[k]]] = static_cast<uint32_t>(k);
+	}
+	instances = std::move(sorted);
+
+	bbox = UnionBounds(instances);
+
+	buildStats = builder.Stats();
+	maxDepth = buildStats.maxDepth;
+	builtCost = SAHCost();
+}
+
+void TopLevelBVH::Refit()
+{
+	RefitLinearBVH(nodes, [&](size_t i) { return instances[i]->BoundingBox(); });
+	bbox = UnionBounds(instances);
+}
+
+bool TopLevelBVH::Update(double maxCostRatio)
+{
+	return RefitOrRebuild(*this, builtCost, maxCostRatio);
+}
+
+double TopLevelBVH::SAHCost() const
+{
+	return LinearBVHSAHCost(nodes);
+}
+
+bool TopLevelBVH::hit(const Ray& r, interval ray_t, hit_record& rec) const
+{
+	return TraverseLinearBVH(nodes, maxDepth, r, ray_t, [&](const LinearBVHNode& node, interval& t)
+		{
+			bool hitLeaf = false;
+			for (uint32_t i = 0; i < node.primitiveCount; ++i)
+			{
+				if (instances[node.primitivesOffset + i]->hit(r, t, rec))
+				{
+					hitLeaf = true;
+					t.max = rec.t;
+				}
+			}
+			return hitLeaf;
+		});
+}
@@ -0,0 +1,53 @@
+#ifndef TOP_LEVEL_BVH_H
+#define TOP_LEVEL_BVH_H
+
+#include "Common/common.h"
+
+#include "BVHBuilder.h"
+#include "instance.h"
+
+#include <vector>
+
+// 两级加速结构中的顶层 (TLAS): 只建在实例的包围盒上
+// 底层 (BLAS) 是实例引用的物体自带的加速结构, 例如 triangle_mesh 内部的 BVH 或球体集合的 BVH8,
+// 实例移动时底层不变, 每帧只需要 Refit() 或 Rebuild() 顶层
+class TopLevelBVH :public hittable
+{
+public:
+	// threadCount <= 0 时使用全部硬件线程构建
+	TopLevelBVH(std::vector<shared_ptr<instance>> instances, int threadCount = 0);
+
+	bool hit(const Ray& r, interval ray_t, hit_record& rec)const override;
+	AABB BoundingBox()const override { return bbox; }
+
+	// id 为实例在构造时传入的数组中的下标
+	size_t InstanceCount()const { return instances.size(); }
+	instance& Instance(size_t id) { return *instances[slots[id]]; }
+	// 只更新实例, 树要等到 Refit() 或 Rebuild() 之后才反映新的位置
+	void SetTransform(size_t id, const Transform& transform) { Instance(id).SetTransform(transform); }
+
+	// 保持树的拓扑不变, 自底向上重新计算所有节点的包围盒, O(节点数)
+	// 实例移动较大时包围盒互相重叠, 遍历变慢, 见 SAHCost()
+	void Refit();
+	// 按当前的实例包围盒重新构建整棵树
+	void Rebuild();
+	// 先 Refit(), SAH 代价超过上次重建时的 maxCostRatio 倍再 Rebuild(), 返回是否重建
+	bool Update(double maxCostRatio = kDefaultRebuildCostRatio);
+
+	// 与 BVHNode::SAHCost() 相同的代价, 用来衡量 Refit() 之后树的质量
+	double SAHCost()const;
+	size_t NodeCount()const { return nodes.size(); }
+	const BVHBuildStats& BuildStats()const { return buildStats; }
+
+private:
+	std::vector<shared_ptr<instance>> instances;	// 按叶子顺序排列
+	std::vector<uint32_t> slots;					// 实例 id 在 instances 中的位置
+	std::vector<LinearBVHNode> nodes;
+	AABB bbox;
+	int maxDepth = 0;
+	int threadCount;
+	double builtCost = 0;	// 上次重建之后的 SAH 代价
+	BVHBuildStats buildStats;
+};
+
+#endif // !TOP_LEVEL_BVH_H
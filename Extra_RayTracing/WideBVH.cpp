@@ -0,0 +1,744 @@
+#include "WideBVH.h"
+
+#include "Common/SimdLanes.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define WIDE_BVH_SSE 1
+#endif
+
+namespace
+{
+	constexpr float kFloatInfinity = std::numeric_limits<float>::infinity();
+
+	struct WideRay
+	{
+		float orig[3];
+		float invDir[3];
+		int dirIsNeg[3];
+	};
+
+	// packet 中剩下的射线不超过这个数时改为逐条遍历
+	constexpr int kPacketMinRays = 1;
+
+	int LaneCount(int mask)
+	{
+		int n = 0;
+		for (; mask != 0; mask &= mask - 1)
+			++n;
+		return n;
+	}
+
+	float HalfArea(const LinearBVHNode& node)
+	{
+		float dx = node.boundsMax[0] - node.boundsMin[0];
+		float dy = node.boundsMax[1] - node.boundsMin[1];
+		float dz = node.boundsMax[2] - node.boundsMin[2];
+		return dx * dy + dy * dz + dz * dx;
+	}
+
+	AABB LerpBox(const AABB& start, const AABB& end, double time)
+	{
+		auto lerp = [time](const interval& a, const interval& b)
+		{
+			return interval(a.min + time * (b.min - a.min), a.max + time * (b.max - a.max));
+		};
+		return AABB(lerp(start.x, end.x), lerp(start.y, end.y), lerp(start.z, end.z));
+	}
+
+	bool SameBox(const AABB& a, const AABB& b)
+	{
+		for (int n = 0; n < 3; ++n)
+			if (a.axis(n).min != b.axis(n).min || a.axis(n).max != b.axis(n).max)
+				return false;
+		return true;
+	}
+
+	// 同时测试 N 个子节点的包围盒, 返回命中子节点的位掩码, tNear 返回各子节点的进入距离
+	// 射线方向为负的轴上近处的面是 max; 空位的包围盒为 [+inf, -inf], 永远不会命中
+	template <int N>
+	int IntersectChildren(const float (&boundsMin)[3][N], const float (&boundsMax)[3][N], const WideRay& ray,
+		float tMin, float tMax, float tNear[N])
+	{
+#if defined(__AVX__)
+		if constexpr (N == 8)
+		{
+			__m256 tn = _mm256_set1_ps(tMin);
+			__m256 tf = _mm256_set1_ps(tMax);
+			const __m256 scale = _mm256_set1_ps(kSlabTMaxScale);
+			for (int a = 0; a < 3; ++a)
+			{
+				const float* nearPlane = ray.dirIsNeg[a] ? boundsMax[a] : boundsMin[a];
+				const float* farPlane = ray.dirIsNeg[a] ? boundsMin[a] : boundsMax[a];
+				const __m256 o = _mm256_set1_ps(ray.orig[a]);
+				const __m256 inv = _mm256_set1_ps(ray.invDir[a]);
+
+				__m256 t0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(nearPlane), o), inv);
+				__m256 t1 = _mm256_mul_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(farPlane), o), inv), scale);
+				// 出现 NaN 时 max/min 返回第二个操作数, 即保留原来的区间
+				tn = _mm256_max_ps(t0, tn);
+				tf = _mm256_min_ps(t1, tf);
+			}
+			_mm256_storeu_ps(tNear, tn);
+			return _mm256_movemask_ps(_mm256_cmp_ps(tn, tf, _CMP_LE_OQ));
+		}
+#endif
+#if defined(WIDE_BVH_SSE)
+		int mask = 0;
+		const __m128 scale = _mm_set1_ps(kSlabTMaxScale);
+		for (int g = 0; g < N; g += 4)
+		{
+			__m128 tn = _mm_set1_ps(tMin);
+			__m128 tf = _mm_set1_ps(tMax);
+			for (int a = 0; a < 3; ++a)
+			{
+				const float* nearPlane = ray.dirIsNeg[a] ? boundsMax[a] : boundsMin[a];
+				const float* farPlane = ray.dirIsNeg[a] ? boundsMin[a] : boundsMax[a];
+				const __m128 o = _mm_set1_ps(ray.orig[a]);
+				const __m128 inv = _mm_set1_ps(ray.invDir[a]);
+
+				__m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(nearPlane + g), o), inv);
+				__m128 t1 = _mm_mul_ps(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(farPlane + g), o), inv), scale);
+				tn = _mm_max_ps(t0, tn);
+				tf = _mm_min_ps(t1, tf);
+			}
+			_mm_storeu_ps(tNear + g, tn);
+			mask |= _mm_movemask_ps(_mm_cmple_ps(tn, tf)) << g;
+		}
+		return mask;
+#else
+		int mask = 0;
+		for (int i = 0; i < N; ++i)
+		{
+			float tn = tMin, tf = tMax;
+			for (int a = 0; a < 3; ++a)
+			{
+				float t0 = ((ray.dirIsNeg[a] ? boundsMax[a][i] : boundsMin[a][i]) - ray.orig[a]) * ray.invDir[a];
+				float t1 = ((ray.dirIsNeg[a] ? boundsMin[a][i] : boundsMax[a][i]) - ray.orig[a]) * ray.invDir[a];
+				t1 *= kSlabTMaxScale;
+				tn = t0 > tn ? t0 : tn;
+				tf = t1 < tf ? t1 : tf;
+			}
+			tNear[i] = tn;
+			mask |= (tn <= tf) << i;
+		}
+		return mask;
+#endif
+	}
+}
+
+template <int N>
+WideBVH<N>::WideBVH(const hittable_list& list, BVHSplitMethod method, size_t maxLeafSize, int threadCount,
+	bool interpolateMotion)
+	:bbox(list.BoundingBox()), method(method), maxLeafSize(maxLeafSize), threadCount(threadCount),
+	interpolateMotion(interpolateMotion)
+{
+	Build(list.objects);
+}
+
+template <int N>
+void WideBVH<N>::Build(const std::vector<shared_ptr<hittable>>& objects)
+{
+	bool moving = false;
+	for (size_t i = 0; interpolateMotion && !moving && i < objects.size(); ++i)
+	{
+		AABB start, end;
+		objects[i]->MotionBounds(start, end);
+		moving = !SameBox(start, end);
+	}
+
+	// 有运动时按快门中间时刻的包围盒划分, 同一时刻彼此靠近的图元才会分到一起
+	auto primitiveBounds = [&](size_t i)
+	{
+		if (!moving)
+			return objects[i]->BoundingBox();
+		AABB start, end;
+		objects[i]->MotionBounds(start, end);
+		return LerpBox(start, end, 0.5);
+	};
+
+	BVHBuilder builder(method, maxLeafSize, threadCount);
+	std::vector<LinearBVHNode> binary;
+	std::vector<uint32_t> indices;
+	builder.Build(objects.size(), primitiveBounds, binary, indices);
+
+	primitives = ReorderPrimitives(objects, indices);
+
+	buildStats = builder.Stats();
+	nodes.clear();
+	maxDepth = 0;
+	if (!binary.empty())
+	{
+		nodes.reserve(binary.size() / (N - 1) + 1);
+		Collapse(binary, 0, 1);
+	}
+
+	// Collapse() 复制的是中间时刻的包围盒, 重新计算快门开启和关闭时的包围盒
+	motion.clear();
+	if (moving)
+	{
+		motion.resize(nodes.size());
+		Refit();
+	}
+	builtCost = SAHCost();
+}
+
+template <int N>
+void WideBVH<N>::Refit()
+{
+	// Collapse() 先分配父节点再递归, 子节点的下标总比父节点大, 倒序遍历即可先处理子节点
+	for (size_t n = nodes.size(); n-- > 0;)
+	{
+		const auto& node = nodes[n];
+		for (int i = 0; i < N; ++i)
+		{
+			if (node.child[i] == WideBVHNode<N>::kEmpty)
+				continue;
+
+			AABB start, end;
+			if (node.primitiveCount[i] > 0)
+			{
+				for (uint32_t k = 0; k < node.primitiveCount[i]; ++k)
+				{
+					const auto& object = primitives[node.child[i] + k];
+					AABB objectStart, objectEnd;
+					if (motion.empty())
+						objectStart = objectEnd = object->BoundingBox();
+					else
+						object->MotionBounds(objectStart, objectEnd);
+					start = k == 0 ? objectStart : AABB(start, objectStart);
+					end = k == 0 ? objectEnd : AABB(end, objectEnd);
+				}
+			}
+			else
+			{
+				// 空位的包围盒是 [+inf, -inf], 变化量是 0, 直接参与合并不影响结果
+				uint32_t c = node.child[i];
+				const auto& child = nodes[c];
+				point3 startMin, startMax, endMin, endMax;
+				for (int a = 0; a < 3; ++a)
+				{
+					startMin[a] = endMin[a] = infinity;
+					startMax[a] = endMax[a] = -infinity;
+					for (int j = 0; j < N; ++j)
+					{
+						double deltaMin = motion.empty() ? 0.0 : motion[c].deltaMin[a][j];
+						double deltaMax = motion.empty() ? 0.0 : motion[c].deltaMax[a][j];
+						startMin[a] = std::min(startMin[a], static_cast<Real>(child.boundsMin[a][j]));
+						startMax[a] = std::max(startMax[a], static_cast<Real>(child.boundsMax[a][j]));
+						endMin[a] = std::min(endMin[a], static_cast<Real>(child.boundsMin[a][j] + deltaMin));
+						endMax[a] = std::max(endMax[a], static_cast<Real>(child.boundsMax[a][j] + deltaMax));
+					}
+				}
+				start = AABB(startMin, startMax);
+				end = AABB(endMin, endMax);
+			}
+			SetChildBounds(n, i, start, end);
+		}
+	}
+
+	bbox = UnionBounds(primitives);
+}
+
+template <int N>
+void WideBVH<N>::SetChildBounds(size_t n, int i, const AABB& start, const AABB& end)
+{
+	auto& node = nodes[n];
+	if (motion.empty())
+	{
+		for (int a = 0; a < 3; ++a)
+		{
+			node.boundsMin[a][i] = RoundDown(start.axis(a).min);
+			node.boundsMax[a][i] = RoundUp(start.axis(a).max);
+		}
+		return;
+	}
+
+	// 遍历时用 float 计算 bounds + time * delta, 误差不超过几个 ulp, 向外多留出一些余量
+	// 父节点由子节点的插值包围盒合并而来, 两端取并集再插值不会比子节点插值的并集小
+	for (int a = 0; a < 3; ++a)
+	{
+		const auto& s = start.axis(a);
+		const auto& e = end.axis(a);
+		double magnitude = std::max({ std::fabs(s.min), std::fabs(s.max), std::fabs(e.min), std::fabs(e.max) });
+		double pad = 4 * std::numeric_limits<float>::epsilon() * magnitude;
+		node.boundsMin[a][i] = RoundDown(s.min - pad);
+		node.boundsMax[a][i] = RoundUp(s.max + pad);
+		motion[n].deltaMin[a][i] = static_cast<float>(e.min - s.min);
+		motion[n].deltaMax[a][i] = static_cast<float>(e.max - s.max);
+	}
+}
+
+template <int N>
+void WideBVH<N>::Rebuild()
+{
+	bbox = UnionBounds(primitives);
+	Build(primitives);
+}
+
+template <int N>
+bool WideBVH<N>::Update(double maxCostRatio)
+{
+	return RefitOrRebuild(*this, builtCost, maxCostRatio);
+}
+
+template <int N>
+double WideBVH<N>::SAHCost() const
+{
+	if (nodes.empty())
+		return 0;
+
+	// 有运动时取快门中间时刻的包围盒
+	auto slotBounds = [this](size_t n, int i, int a, double& lo, double& hi)
+	{
+		lo = nodes[n].boundsMin[a][i];
+		hi = nodes[n].boundsMax[a][i];
+		if (!motion.empty())
+		{
+			lo += 0.5 * motion[n].deltaMin[a][i];
+			hi += 0.5 * motion[n].deltaMax[a][i];
+		}
+	};
+	auto slotArea = [&](size_t n, int i)
+	{
+		double d[3];
+		for (int a = 0; a < 3; ++a)
+		{
+			double lo, hi;
+			slotBounds(n, i, a, lo, hi);
+			d[a] = hi - lo;
+		}
+		return d[0] * d[1] + d[1] * d[2] + d[2] * d[0];
+	};
+
+	double rootMin[3], rootMax[3];
+	for (int a = 0; a < 3; ++a)
+	{
+		rootMin[a] = infinity;
+		rootMax[a] = -infinity;
+		for (int i = 0; i < N; ++i)
+		{
+			if (nodes[0].child[i] == WideBVHNode<N>::kEmpty)
+				continue;
+			double lo, hi;
+			slotBounds(0, i, a, lo, hi);
+			rootMin[a] = std::min(rootMin[a], lo);
+			rootMax[a] = std::max(rootMax[a], hi);
+		}
+	}
+	double rootArea = (rootMax[0] - rootMin[0]) * (rootMax[1] - rootMin[1])
+		+ (rootMax[1] - rootMin[1]) * (rootMax[2] - rootMin[2])
+		+ (rootMax[2] - rootMin[2]) * (rootMax[0] - rootMin[0]);
+	if (rootArea <= 0)
+		return 0;
+
+	double cost = BVHNode::TraversalCost * rootArea;
+	for (size_t n = 0; n < nodes.size(); ++n)
+	{
+		const auto& node = nodes[n];
+		for (int i = 0; i < N; ++i)
+		{
+			if (node.child[i] == WideBVHNode<N>::kEmpty)
+				continue;
+			if (node.primitiveCount[i] > 0)
+				cost += BVHNode::IntersectionCost * node.primitiveCount[i] * slotArea(n, i);
+			else
+				cost += BVHNode::TraversalCost * slotArea(n, i);
+		}
+	}
+	return cost / rootArea;
+}
+
+template <int N>
+uint32_t WideBVH<N>::Collapse(const std::vector<LinearBVHNode>& binary, uint32_t binaryIndex, int depth)
+{
+	maxDepth = std::max(maxDepth, depth);
+
+	uint32_t children[N];
+	int childCount = 0;
+	const auto& root = binary[binaryIndex];
+	if (root.primitiveCount > 0)
+	{
+		children[childCount++] = binaryIndex;
+	}
+	else
+	{
+		children[childCount++] = binaryIndex + 1;
+		children[childCount++] = root.secondChildOffset;
+	}
+
+	// 反复把面积最大的内部子节点换成它的两个子节点, 直到凑满 N 个
+	while (childCount < N)
+	{
+		int best = -1;
+		float bestArea = -1;
+		for (int i = 0; i < childCount; ++i)
+		{
+			const auto& child = binary[children[i]];
+			if (child.primitiveCount == 0 && HalfArea(child) > bestArea)
+			{
+				best = i;
+				bestArea = HalfArea(child);
+			}
+		}
+		if (best < 0)
+			break;
+
+		uint32_t expanded = children[best];
+		for (int i = childCount; i > best + 1; --i)
+			children[i] = children[i - 1];
+		children[best] = expanded + 1;
+		children[best + 1] = binary[expanded].secondChildOffset;
+		childCount++;
+	}
+
+	auto index = static_cast<uint32_t>(nodes.size());
+	nodes.emplace_back();
+	{
+		auto& node = nodes[index];
+		for (int i = 0; i < N; ++i)
+		{
+			for (int a = 0; a < 3; ++a)
+			{
+				node.boundsMin[a][i] = kFloatInfinity;
+				node.boundsMax[a][i] = -kFloatInfinity;
+			}
+			node.child[i] = WideBVHNode<N>::kEmpty;
+			node.primitiveCount[i] = 0;
+		}
+
+		for (int i = 0; i < childCount; ++i)
+		{
+			const auto& child = binary[children[i]];
+			for (int a = 0; a < 3; ++a)
+			{
+				node.boundsMin[a][i] = child.boundsMin[a];
+				node.boundsMax[a][i] = child.boundsMax[a];
+			}
+			if (child.primitiveCount > 0)
+			{
+				node.child[i] = child.primitivesOffset;
+				node.primitiveCount[i] = child.primitiveCount;
+			}
+		}
+	}
+
+	// 递归时 nodes 可能扩容, 之后重新通过下标访问
+	for (int i = 0; i < childCount; ++i)
+	{
+		if (binary[children[i]].primitiveCount == 0)
+		{
+			auto childIndex = Collapse(binary, children[i], depth + 1);
+			nodes[index].child[i] = childIndex;
+		}
+	}
+
+	return index;
+}
+
+template <int N>
+bool WideBVH<N>::hit(const Ray& r, interval ray_t, hit_record& rec) const
+{
+	if (nodes.empty())
+		return false;
+	return Traverse(r, ray_t, rec, 0, 0);
+}
+
+template <int N>
+bool WideBVH<N>::Traverse(const Ray& r, interval& ray_t, hit_record& rec, uint32_t rootIndex, uint16_t rootPrimitiveCount) const
+{
+	WideRay ray;
+	for (int a = 0; a < 3; ++a)
+	{
+		ray.orig[a] = static_cast<float>(r.GetOrigin()[a]);
+		ray.invDir[a] = static_cast<float>(r.GetInvDirection()[a]);
+		ray.dirIsNeg[a] = r.GetSign(a);
+	}
+	const float time = static_cast<float>(r.GetTime());
+
+	struct StackEntry
+	{
+		uint32_t index;
+		uint16_t primitiveCount;
+		float tNear;
+	};
+
+	// 每访问一个节点最多弹出一项压入 N 项
+	constexpr int kLocalStackSize = 256;
+	StackEntry localStack[kLocalStackSize];
+	std::vector<StackEntry> heapStack;
+	StackEntry* stack = localStack;
+	int stackCapacity = maxDepth * (N - 1) + 1;
+	if (stackCapacity > kLocalStackSize)
+	{
+		heapStack.resize(stackCapacity);
+		stack = heapStack.data();
+	}
+
+	bool hitAnything = false;
+	int stackSize = 0;
+	stack[stackSize++] = { rootIndex, rootPrimitiveCount, -kFloatInfinity };
+
+	while (stackSize > 0)
+	{
+		auto entry = stack[--stackSize];
+		// 入栈之后已经找到了更近的交点
+		if (entry.tNear > ray_t.max)
+			continue;
+
+		if (entry.primitiveCount > 0)
+		{
+			for (uint32_t i = 0; i < entry.primitiveCount; ++i)
+			{
+				if (primitives[entry.index + i]->hit(r, ray_t, rec))
+				{
+					hitAnything = true;
+					ray_t.max = rec.t;
+				}
+			}
+			continue;
+		}
+
+		const auto& node = nodes[entry.index];
+		float tNear[N];
+		int mask;
+		if (motion.empty())
+		{
+			mask = IntersectChildren<N>(node.boundsMin, node.boundsMax, ray,
+				static_cast<float>(ray_t.min), static_cast<float>(ray_t.max), tNear);
+		}
+		else
+		{
+			// 插值出射线时刻的子节点包围盒, 连续的 3 * N 个 float, 编译器会自动向量化
+			const auto& delta = motion[entry.index];
+			alignas(32) float boundsMin[3][N];
+			alignas(32) float boundsMax[3][N];
+			for (int a = 0; a < 3; ++a)
+			{
+				for (int i = 0; i < N; ++i)
+				{
+					boundsMin[a][i] = node.boundsMin[a][i] + time * delta.deltaMin[a][i];
+					boundsMax[a][i] = node.boundsMax[a][i] + time * delta.deltaMax[a][i];
+				}
+			}
+			mask = IntersectChildren<N>(boundsMin, boundsMax, ray,
+				static_cast<float>(ray_t.min), static_cast<float>(ray_t.max), tNear);
+		}
+
+		// 命中的子节点按距离从远到近排序后入栈, 最近的最先弹出
+		int order[N];
+		int hitCount = 0;
+		for (int i = 0; i < N; ++i)
+		{
+			if (!(mask & (1 << i)))
+				continue;
+			int k = hitCount++;
+			while (k > 0 && tNear[order[k - 1]] < tNear[i])
+			{
+				order[k] = order[k - 1];
+				--k;
+			}
+			order[k] = i;
+		}
+
+		for (int k = 0; k < hitCount; ++k)
+		{
+			int i = order[k];
+			stack[stackSize++] = { node.child[i], node.primitiveCount[i], tNear[i] };
+		}
+	}
+
+	return hitAnything;
+}
+
+template <int N>
+int WideBVH<N>::HitPacket(const RayPacket& packet, interval* ray_t, hit_record* recs, int mask) const
+{
+	using Lanes = FloatLanes;
+	using V = Lanes::V;
+	static_assert(RayPacket::kSize % Lanes::kWidth == 0, "packet size must be a multiple of the SIMD width");
+	constexpr int kLaneMask = (1 << Lanes::kWidth) - 1;
+
+	if (nodes.empty() || mask == 0)
+		return 0;
+
+	alignas(32) float tMin[RayPacket::kSize], tMax[RayPacket::kSize];
+	for (int k = 0; k < RayPacket::kSize; ++k)
+	{
+		tMin[k] = static_cast<float>(ray_t[k].min);
+		tMax[k] = static_cast<float>(ray_t[k].max);
+	}
+
+	// 每条射线进入子节点的距离随子节点一起入栈, 弹出时排除已经找到更近交点的射线
+	struct StackEntry
+	{
+		alignas(32) float tNear[RayPacket::kSize];
+		uint32_t index;
+		uint16_t primitiveCount;
+		uint16_t mask;
+	};
+
+	constexpr int kLocalStackSize = 128;
+	StackEntry localStack[kLocalStackSize];
+	std::vector<StackEntry> heapStack;
+	StackEntry* stack = localStack;
+	int stackCapacity = maxDepth * (N - 1) + 1;
+	if (stackCapacity > kLocalStackSize)
+	{
+		heapStack.resize(stackCapacity);
+		stack = heapStack.data();
+	}
+
+	int hits = 0;
+	int stackSize = 0;
+	{
+		auto& root = stack[stackSize++];
+		for (int k = 0; k < RayPacket::kSize; ++k)
+			root.tNear[k] = -kFloatInfinity;
+		root.index = 0;
+		root.primitiveCount = 0;
+		root.mask = static_cast<uint16_t>(mask);
+	}
+
+	while (stackSize > 0)
+	{
+		const auto& entry = stack[--stackSize];
+		int active = 0;
+		for (int g = 0; g < RayPacket::kSize; g += Lanes::kWidth)
+			active |= Lanes::Bits(Lanes::LessEqual(Lanes::Load(entry.tNear + g), Lanes::Load(tMax + g))) << g;
+		active &= entry.mask;
+		if (active == 0)
+			continue;
+
+		// 射线已经分散到不同的子树, SIMD 通道大多空转, 剩下的几条各自遍历这棵子树
+		if (LaneCount(active) <= kPacketMinRays)
+		{
+			for (int bits = active; bits != 0; bits &= bits - 1)
+			{
+				int k = 0;
+				while (!(bits >> k & 1))
+					++k;
+				if (Traverse(packet.rays[k], ray_t[k], recs[k], entry.index, entry.primitiveCount))
+				{
+					tMax[k] = static_cast<float>(ray_t[k].max);
+					hits |= 1 << k;
+				}
+			}
+			continue;
+		}
+
+		if (entry.primitiveCount > 0)
+		{
+			int leafHits = 0;
+			for (uint32_t i = 0; i < entry.primitiveCount; ++i)
+				leafHits |= primitives[entry.index + i]->HitPacket(packet, ray_t, recs, active);
+			for (int bits = leafHits; bits != 0; bits &= bits - 1)
+			{
+				int k = 0;
+				while (!(bits >> k & 1))
+					++k;
+				tMax[k] = static_cast<float>(ray_t[k].max);
+			}
+			hits |= leafHits;
+			continue;
+		}
+
+		// 逐个子节点测试全部射线, 与单条射线的 hit() 相同, 近处的面按射线方向的符号选取,
+		// 这里对每个通道用 min / max 代替; 出现 NaN 时 max/min 返回第二个操作数, 保留原来的区间
+		const uint32_t index = entry.index;
+		const auto& node = nodes[index];
+		const WideBVHMotion<N>* delta = motion.empty() ? nullptr : &motion[index];
+		const V scale = Lanes::Set(kSlabTMaxScale);
+
+		alignas(32) float childNear[N][RayPacket::kSize];
+		int childMask[N];
+		float childOrder[N];
+		for (int i = 0; i < N; ++i)
+		{
+			childMask[i] = 0;
+			if (node.child[i] == WideBVHNode<N>::kEmpty)
+				continue;
+
+			for (int g = 0; g < RayPacket::kSize; g += Lanes::kWidth)
+			{
+				if (!((active >> g) & kLaneMask))
+				{
+					Lanes::Store(childNear[i] + g, Lanes::Set(kFloatInfinity));
+					continue;
+				}
+
+				V tn = Lanes::Load(tMin + g);
+				V tf = Lanes::Load(tMax + g);
+				for (int a = 0; a < 3; ++a)
+				{
+					V lo = Lanes::Set(node.boundsMin[a][i]);
+					V hi = Lanes::Set(node.boundsMax[a][i]);
+					if (delta)
+					{
+						// 按每条射线自己的时刻插值包围盒
+						V time = Lanes::Load(packet.timeF + g);
+						lo = Lanes::Add(lo, Lanes::Mul(time, Lanes::Set(delta->deltaMin[a][i])));
+						hi = Lanes::Add(hi, Lanes::Mul(time, Lanes::Set(delta->deltaMax[a][i])));
+					}
+					V o = Lanes::Load(packet.originF[a] + g);
+					V inv = Lanes::Load(packet.invDirF[a] + g);
+					V t0 = Lanes::Mul(Lanes::Sub(lo, o), inv);
+					V t1 = Lanes::Mul(Lanes::Sub(hi, o), inv);
+					tn = Lanes::Max(Lanes::Min(t0, t1), tn);
+					tf = Lanes::Min(Lanes::Mul(Lanes::Max(t0, t1), scale), tf);
+				}
+				Lanes::Store(childNear[i] + g, tn);
+				childMask[i] |= Lanes::Bits(Lanes::LessEqual(tn, tf)) << g;
+			}
+			childMask[i] &= active;
+
+			// 子节点的访问顺序取命中射线中最近的进入距离
+			childOrder[i] = kFloatInfinity;
+			for (int bits = childMask[i]; bits != 0; bits &= bits - 1)
+			{
+				int k = 0;
+				while (!(bits >> k & 1))
+					++k;
+				childOrder[i] = std::min(childOrder[i], childNear[i][k]);
+			}
+		}
+
+		// 命中的子节点按距离从远到近排序后入栈, 最近的最先弹出
+		int order[N];
+		int hitCount = 0;
+		for (int i = 0; i < N; ++i)
+		{
+			if (childMask[i] == 0)
+				continue;
+			int k = hitCount++;
+			while (k > 0 && childOrder[order[k - 1]] < childOrder[i])
+			{
+				order[k] = order[k - 1];
+				--k;
+			}
+			order[k] = i;
+		}
+
+		// entry 指向的栈位置会被覆盖, node 已经取出, 这里不再访问 entry
+		for (int k = 0; k < hitCount; ++k)
+		{
+			int i = order[k];
+			auto& child = stack[stackSize++];
+			std::copy(childNear[i], childNear[i] + RayPacket::kSize, child.tNear);
+			child.index = node.child[i];
+			child.primitiveCount = node.primitiveCount[i];
+			child.mask = static_cast<uint16_t>(childMask[i]);
+		}
+	}
+
+	return hits;
+}
+
+template class WideBVH<4>;
+template class WideBVH<8>;
@@ -0,0 +1,98 @@
+#ifndef WIDE_BVH_H
+#define WIDE_BVH_H
+
+#include "Common/common.h"
+
+#include "BVHBuilder.h"
+#include "hittable_list.h"
+
+#include <cstdint>
+
+// N 叉 BVH 节点, 子节点包围盒按 结构体数组 (SoA) 存放:
+// boundsMin[axis][i] 是第 i 个子节点在 axis 轴上的最小值, 一次 SIMD 运算即可测试所有子节点
+template <int N>
+struct alignas(32) WideBVHNode
+{
+	static constexpr uint32_t kEmpty = UINT32_MAX;
+
+	float boundsMin[3][N];
+	float boundsMax[3][N];
+	uint32_t child[N];			// 内部子节点的下标, 或叶子的第一个图元; 空位为 kEmpty
+	uint16_t primitiveCount[N];	// 叶子的图元数, 0 表示内部子节点
+};
+
+// 运动模糊场景中与 WideBVHNode 一一对应的附加数据
+// WideBVHNode 中存放快门开启时的包围盒, 这里是到快门关闭时包围盒的变化量,
+// 时刻 time 的包围盒为 bounds + time * delta; 空位的变化量为 0, 包围盒保持 [+inf, -inf]
+template <int N>
+struct alignas(32) WideBVHMotion
+{
+	float deltaMin[3][N];
+	float deltaMax[3][N];
+};
+
+// 由二叉 BVH 合并而成的 4 叉 / 8 叉 BVH
+// 每个节点一次测试全部 N 个子节点, 命中的子节点按距离从近到远访问
+// 有图元在快门内运动时 (见 hittable::MotionBounds), 子节点包围盒按射线的时刻插值,
+// 而不是使用整个快门内扫过的包围盒
+template <int N>
+class WideBVH :public hittable
+{
+	static_assert(N == 4 || N == 8, "WideBVH supports 4 or 8 children");
+
+public:
+	// interpolateMotion 为 false 时和静止场景一样只使用扫过的包围盒, 用于对比
+	WideBVH(const hittable_list& list, BVHSplitMethod method = BVHSplitMethod::SAH,
+		size_t maxLeafSize = BVHNode::DefaultMaxLeafSize, int threadCount = 0, bool interpolateMotion = true);
+
+	bool hit(const Ray& r, interval ray_t, hit_record& rec)const override;
+	// 整个 packet 一起遍历: 每个节点只取一次, 一个子节点的包围盒同时对所有射线做 SIMD 测试,
+	// 只有穿过子节点的射线继续向下, 叶子中的图元对这部分射线调用一次 HitPacket()
+	int HitPacket(const RayPacket& packet, interval* ray_t, hit_record* recs, int mask)const override;
+	AABB BoundingBox()const override { return bbox; }
+
+	size_t NodeCount()const { return nodes.size(); }
+	// 按叶子顺序排列的图元
+	const std::vector<shared_ptr<hittable>>& Primitives()const { return primitives; }
+	// 是否按射线的时刻插值包围盒
+	bool HasMotion()const { return !motion.empty(); }
+	const BVHBuildStats& BuildStats()const { return buildStats; }
+
+	// 图元移动后更新树, 含义与 LinearBVH 的同名函数相同
+	void Refit();
+	void Rebuild();
+	bool Update(double maxCostRatio = kDefaultRebuildCostRatio);
+	// 每次 N 路测试计一次遍历代价, 叶子中的每个图元计一次求交代价, 以根节点面积归一化
+	// 有运动时使用快门中间时刻的包围盒
+	double SAHCost()const;
+
+private:
+	void Build(const std::vector<shared_ptr<hittable>>& objects);
+
+	// 把二叉节点 binaryIndex 展开成一个 N 叉节点, 返回其下标
+	uint32_t Collapse(const std::vector<LinearBVHNode>& binary, uint32_t binaryIndex, int depth);
+	// 单条射线从子树 rootIndex 开始遍历, rootPrimitiveCount > 0 时 rootIndex 是叶子的第一个图元
+	// 命中时 ray_t.max 缩短为最近的交点
+	bool Traverse(const Ray& r, interval& ray_t, hit_record& rec, uint32_t rootIndex, uint16_t rootPrimitiveCount)const;
+	// 设置第 n 个节点第 i 个子节点在快门开启和关闭时的包围盒
+	void SetChildBounds(size_t n, int i, const AABB& start, const AABB& end);
+
+private:
+	std::vector<WideBVHNode<N>> nodes;
+	std::vector<WideBVHMotion<N>> motion;	// 没有运动时为空
+	std::vector<shared_ptr<hittable>> primitives;
+	AABB bbox;
+	int maxDepth = 0;
+	BVHBuildStats buildStats;
+
+	BVHSplitMethod method;
+	size_t maxLeafSize;
+	int threadCount;
+	bool interpolateMotion;
+	double builtCost = 0;	// 上次构建之后的 SAH 代价
+};
+
+using BVH4 = WideBVH<4>;
+using BVH8 = WideBVH<8>;
+
+#endif // !WIDE_BVH_H
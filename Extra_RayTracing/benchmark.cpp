@@ -0,0 +1,1930 @@
+#include "benchmark.h"
+
+#include "BVH.h"
+#include "LinearBVH.h"
+#include "RayStream.h"
+#include "TopLevelBVH.h"
+#include "WideBVH.h"
+#include "camera.h"
+#include "instance.h"
+#include "material.h"
+#include "material_variant.h"
+#include "scene.h"
+#include "sphere.h"
+#include "sphere_set.h"
+#include "triangle_mesh.h"
+#include "Common/ThreadPool.h"
+
+#ifdef _MSC_VER
+#include <Windows.h>
+#include <Psapi.h>
+#pragma comment(lib, "Psapi.lib")
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <type_traits>
+#include <vector>
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	double SecondsSince(Clock::time_point start)
+	{
+		return std::chrono::duration<double>(Clock::now() - start).count();
+	}
+
+	// 进程到目前为止占用物理内存的峰值, 单位 MB
+	double PeakMemoryMB()
+	{
+#ifdef _MSC_VER
+		PROCESS_MEMORY_COUNTERS counters;
+		if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+			return counters.PeakWorkingSetSize / (1024.0 * 1024.0);
+#else
+		std::ifstream status("/proc/self/status");
+		std::string line;
+		while (std::getline(status, line))
+		{
+			if (line.compare(0, 6, "VmHWM:") == 0)
+				return std::stod(line.substr(6)) / 1024.0;
+		}
+#endif
+		return 0;
+	}
+
+	// 从 eye 射向 target 内的随机点
+	std::vector<Ray> MakeRays(const point3& eye, const AABB& target, size_t count)
+	{
+		std::vector<Ray> rays;
+		rays.reserve(count);
+
+		IndependentSampler sampler(1);
+		for (size_t i = 0; i < count; ++i)
+		{
+			sampler.StartPixelSample(static_cast<int>(i), 0, 0);
+			auto x = sampler.Get1D(target.x.min, target.x.max);
+			auto y = sampler.Get1D(target.y.min, target.y.max);
+			auto z = sampler.Get1D(target.z.min, target.z.max);
+			rays.emplace_back(eye, point3(x, y, z) - eye, sampler.Get1D());
+		}
+		return rays;
+	}
+
+	// 返回每秒射线数
+	double TraceRays(const hittable& world, const std::vector<Ray>& rays, size_t& hitCount)
+	{
+		hitCount = 0;
+		auto start = Clock::now();
+		for (const auto& r : rays)
+		{
+			hit_record rec;
+			if (world.hit(r, interval(0.001, infinity), rec))
+				hitCount++;
+		}
+		return rays.size() / SecondsSince(start);
+	}
+
+	// 包装一个图元, 统计 hit() 被调用的次数
+	class CountingHittable :public hittable
+	{
+	public:
+		CountingHittable(shared_ptr<hittable> object, size_t& counter) :object(object), counter(counter) {}
+
+		bool hit(const Ray& r, interval ray_t, hit_record& rec)const override
+		{
+			counter++;
+			return object->hit(r, ray_t, rec);
+		}
+		AABB BoundingBox()const override { return object->BoundingBox(); }
+
+	private:
+		shared_ptr<hittable> object;
+		size_t& counter;
+	};
+
+	hittable_list WrapCounting(const hittable_list& list, size_t& counter)
+	{
+		hittable_list wrapped;
+		for (const auto& object : list.objects)
+			wrapped.add(make_shared<CountingHittable>(object, counter));
+		return wrapped;
+	}
+
+	struct BenchmarkScene
+	{
+		std::string name;
+		hittable_list world;
+		point3 eye;
+		AABB target;
+	};
+
+	void BenchmarkBVH(const BenchmarkOptions& options)
+	{
+		std::vector<BenchmarkScene> scenes;
+		scenes.push_back({ "RandomSpheres", RandomSpheresWorld(),
+			point3(13, 2, 3), AABB(point3(-11, 0, -11), point3(11, 2, 11)) });
+		scenes.push_back({ "Clustered" + std::to_string(options.primitive_count), ClusteredSpheresWorld(options.primitive_count),
+			point3(120, 60, 150), AABB(point3(-54, -54, -54), point3(54, 54, 54)) });
+
+		std::clog << std::left << std::setw(20) << "scene" << std::setw(10) << "split"
+			<< std::setw(12) << "build(s)" << std::setw(12) << "SAH cost" << std::setw(12) << "Mrays/s" << "hits\n";
+
+		for (auto& scene : scenes)
+		{
+			auto rays = MakeRays(scene.eye, scene.target, options.ray_count);
+
+			for (auto method : { BVHSplitMethod::Median, BVHSplitMethod::SAH })
+			{
+				auto start = Clock::now();
+				BVHNode bvh(scene.world, method);
+				double buildTime = SecondsSince(start);
+
+				size_t hits = 0;
+				double raysPerSecond = TraceRays(bvh, rays, hits);
+
+				std::clog << std::left << std::setw(20) << scene.name
+					<< std::setw(10) << (method == BVHSplitMethod::SAH ? "SAH" : "Median")
+					<< std::setw(12) << buildTime
+					<< std::setw(12) << bvh.SAHCost()
+					<< std::setw(12) << raysPerSecond / 1e6
+					<< hits << '\n';
+
+				start = Clock::now();
+				LinearBVH linear(bvh);
+				buildTime = SecondsSince(start);
+				raysPerSecond = TraceRays(linear, rays, hits);
+
+				std::clog << std::left << std::setw(20) << scene.name
+					<< std::setw(10) << (method == BVHSplitMethod::SAH ? "SAH/L" : "Median/L")
+					<< std::setw(12) << buildTime
+					<< std::setw(12) << bvh.SAHCost()
+					<< std::setw(12) << raysPerSecond / 1e6
+					<< hits << '\n';
+			}
+		}
+	}
+
+	// 叶子容纳的图元数对求交次数和吞吐量的影响
+	void BenchmarkLeaf(const BenchmarkOptions& options)
+	{
+		size_t tests = 0;
+		auto world = WrapCounting(RandomSpheresWorld(), tests);
+		auto rays = MakeRays(point3(13, 2, 3), AABB(point3(-11, 0, -11), point3(11, 2, 11)), options.ray_count);
+
+		std::clog << std::left << std::setw(10) << "split" << std::setw(10) << "leaf" << std::setw(12) << "layout"
+			<< std::setw(12) << "tests/ray" << "Mrays/s\n";
+
+		for (auto method : { BVHSplitMethod::Median, BVHSplitMethod::SAH })
+		{
+			for (size_t leafSize : { 1, 2, 4, 8 })
+			{
+				BVHNode bvh(world, method, leafSize);
+				LinearBVH linear(bvh);
+
+				for (const hittable* accel : { static_cast<const hittable*>(&bvh), static_cast<const hittable*>(&linear) })
+				{
+					size_t hits = 0;
+					tests = 0;
+					double raysPerSecond = TraceRays(*accel, rays, hits);
+
+					std::clog << std::left << std::setw(10) << (method == BVHSplitMethod::SAH ? "SAH" : "Median")
+						<< std::setw(10) << leafSize
+						<< std::setw(12) << (accel == &bvh ? "BVHNode" : "LinearBVH")
+						<< std::setw(12) << static_cast<double>(tests) / rays.size()
+						<< raysPerSecond / 1e6 << '\n';
+				}
+			}
+		}
+	}
+
+	// 构建时间和内存: 递归复制的 BVHNode 与原地并行构建的 BVHBuilder
+	void BenchmarkBuild(const BenchmarkOptions& options)
+	{
+		auto start = Clock::now();
+		auto world = ClusteredSpheresWorld(options.primitive_count);
+		std::clog << "Generated " << world.objects.size() << " spheres in " << SecondsSince(start)
+			<< " s, peak memory " << PeakMemoryMB() << " MB\n";
+
+		auto rays = MakeRays(point3(120, 60, 150), AABB(point3(-54, -54, -54), point3(54, 54, 54)), options.ray_count);
+
+		std::clog << std::left << std::setw(22) << "builder" << std::setw(12) << "build(s)" << std::setw(12) << "nodes"
+			<< std::setw(14) << "builder(MB)" << std::setw(14) << "peak RSS(MB)" << std::setw(12) << "Mrays/s" << "hits\n";
+
+		// BVHNode 每个节点一次堆分配, 只在规模不太大时做对比
+		if (options.primitive_count <= 1000000)
+		{
+			start = Clock::now();
+			BVHNode bvh(world, BVHSplitMethod::SAH);
+			double buildTime = SecondsSince(start);
+			size_t hits = 0;
+			double raysPerSecond = TraceRays(bvh, rays, hits);
+
+			std::clog << std::left << std::setw(22) << "BVHNode SAH" << std::setw(12) << buildTime << std::setw(12) << "-"
+				<< std::setw(14) << "-" << std::setw(14) << PeakMemoryMB()
+				<< std::setw(12) << raysPerSecond / 1e6 << hits << '\n';
+		}
+
+		int hardwareThreads = ThreadPool::HardwareThreads();
+		std::vector<int> threadCounts = { 1 };
+		if (hardwareThreads > 1)
+			threadCounts.push_back(hardwareThreads);
+
+		for (int threads : threadCounts)
+		{
+			LinearBVH bvh(world, BVHSplitMethod::SAH, BVHNode::DefaultMaxLeafSize, threads);
+			const auto& stats = bvh.BuildStats();
+			size_t hits = 0;
+			double raysPerSecond = TraceRays(bvh, rays, hits);
+
+			std::clog << std::left << std::setw(22) << ("BVHBuilder SAH x" + std::to_string(threads))
+				<< std::setw(12) << stats.buildSeconds << std::setw(12) << stats.nodeCount
+				<< std::setw(14) << stats.peakBytes / (1024.0 * 1024.0) << std::setw(14) << PeakMemoryMB()
+				<< std::setw(12) << raysPerSecond / 1e6 << hits << '\n';
+		}
+	}
+
+	// 二叉 LinearBVH 与 4 叉 / 8 叉 WideBVH 的遍历速度
+	void BenchmarkWide(const BenchmarkOptions& options)
+	{
+		std::vector<BenchmarkScene> scenes;
+		scenes.push_back({ "RandomSpheres", RandomSpheresWorld(),
+			point3(13, 2, 3), AABB(point3(-11, 0, -11), point3(11, 2, 11)) });
+		scenes.push_back({ "Clustered" + std::to_string(options.primitive_count), ClusteredSpheresWorld(options.primitive_count),
+			point3(120, 60, 150), AABB(point3(-54, -54, -54), point3(54, 54, 54)) });
+
+		std::clog << std::left << std::setw(20) << "scene" << std::setw(12) << "layout"
+			<< std::setw(12) << "nodes" << std::setw(12) << "Mrays/s" << "hits\n";
+
+		for (auto& scene : scenes)
+		{
+			auto rays = MakeRays(scene.eye, scene.target, options.ray_count);
+
+			LinearBVH bvh2(scene.world);
+			BVH4 bvh4(scene.world);
+			BVH8 bvh8(scene.world);
+
+			struct Layout
+			{
+				const char* name;
+				const hittable* accel;
+				size_t nodeCount;
+			};
+			for (const auto& layout : { Layout{ "BVH2", &bvh2, bvh2.NodeCount() },
+				Layout{ "BVH4", &bvh4, bvh4.NodeCount() }, Layout{ "BVH8", &bvh8, bvh8.NodeCount() } })
+			{
+				size_t hits = 0;
+				double raysPerSecond = TraceRays(*layout.accel, rays, hits);
+				std::clog << std::left << std::setw(20) << scene.name << std::setw(12) << layout.name
+					<< std::setw(12) << layout.nodeCount << std::setw(12) << raysPerSecond / 1e6 << hits << '\n';
+			}
+		}
+	}
+
+	// 改动前的 AABB::hit: 每个轴做一次除法, 按方向符号交换
+	bool DividingBoxHit(const AABB& box, const Ray& r, interval ray_t)
+	{
+		for (int a = 0; a < 3; ++a)
+		{
+			auto invD = 1 / r.GetDirection()[a];
+			auto orig = r.GetOrigin()[a];
+
+			auto t0 = (box.axis(a).min - orig) * invD;
+			auto t1 = (box.axis(a).max - orig) * invD;
+
+			if (invD < 0)std::swap(t0, t1);
+
+			if (t0 > ray_t.min) ray_t.min = t0;
+			if (t1 < ray_t.max) ray_t.max = t1;
+
+			if (ray_t.max <= ray_t.min) return false;
+		}
+		return true;
+	}
+
+	// 每秒包围盒测试次数: 改动前的除法版本与使用射线缓存倒数的 AABB::hit
+	void BenchmarkBox(const BenchmarkOptions& options)
+	{
+		std::vector<AABB> boxes;
+		for (int i = 0; i < 1024; ++i)
+		{
+			auto center = vec3::random(-10, 10);
+			auto extent = vec3::random(0.1, 2);
+			boxes.emplace_back(center - extent, center + extent);
+		}
+		auto rays = MakeRays(point3(13, 2, 3), AABB(point3(-10, -10, -10), point3(10, 10, 10)),
+			std::max<size_t>(options.ray_count / boxes.size(), 1));
+
+		auto run = [&](const char* name, auto&& test)
+		{
+			size_t hits = 0;
+			auto start = Clock::now();
+			for (const auto& r : rays)
+				for (const auto& box : boxes)
+					hits += test(box, r) ? 1 : 0;
+			double seconds = SecondsSince(start);
+			std::clog << std::left << std::setw(24) << name
+				<< std::setw(16) << rays.size() * boxes.size() / seconds / 1e6 << hits << '\n';
+		};
+
+		std::clog << std::left << std::setw(24) << "slab test" << std::setw(16) << "Mtests/s" << "hits\n";
+		run("per-axis division", [](const AABB& box, const Ray& r) { return DividingBoxHit(box, r, interval(0.001, infinity)); });
+		run("cached inverse", [](const AABB& box, const Ray& r) { return box.hit(r, interval(0.001, infinity)); });
+	}
+
+	// 模拟改动前的 hit_record: 每次命中都把 shared_ptr<Material> 复制进记录,
+	// 所有线程对同一个控制块的引用计数做原子加减
+	class OwningMaterialHittable :public hittable
+	{
+	public:
+		OwningMaterialHittable(shared_ptr<hittable> object, shared_ptr<Material> mat) :object(object), mat(mat) {}
+
+		bool hit(const Ray& r, interval ray_t, hit_record& rec)const override
+		{
+			thread_local shared_ptr<Material> recordMaterial;
+			if (!object->hit(r, ray_t, rec))
+				return false;
+			recordMaterial = mat;
+			return true;
+		}
+		AABB BoundingBox()const override { return object->BoundingBox(); }
+
+	private:
+		shared_ptr<hittable> object;
+		shared_ptr<Material> mat;
+	};
+
+	// 多线程求交吞吐量: 持有所有权的材质引用与不持有所有权的材质指针
+	void BenchmarkMaterial(const BenchmarkOptions& options)
+	{
+		auto world = RandomSpheresWorld();
+		auto rays = MakeRays(point3(13, 2, 3), AABB(point3(-11, 0, -11), point3(11, 2, 11)), options.ray_count);
+
+		hittable_list owningWorld;
+		auto sharedMaterial = make_shared<Lambertian>(color(0.5, 0.5, 0.5));
+		for (const auto& object : world.objects)
+			owningWorld.add(make_shared<OwningMaterialHittable>(object, sharedMaterial));
+
+		BVH8 handleBVH(world);
+		BVH8 owningBVH(owningWorld);
+
+		std::clog << std::left << std::setw(10) << "threads" << std::setw(20) << "record material"
+			<< std::setw(12) << "Mrays/s" << "hits\n";
+
+		const size_t chunkSize = 4096;
+		for (int threadCount : { 1, 8, 64 })
+		{
+			ThreadPool pool(threadCount);
+			for (const auto& mode : { std::make_pair("shared_ptr copy", static_cast<const hittable*>(&owningBVH)),
+				std::make_pair("raw handle", static_cast<const hittable*>(&handleBVH)) })
+			{
+				std::atomic<size_t> hits{ 0 };
+				auto start = Clock::now();
+				for (size_t begin = 0; begin < rays.size(); begin += chunkSize)
+				{
+					pool.Submit([&, begin]()
+						{
+							size_t end = std::min(begin + chunkSize, rays.size());
+							size_t chunkHits = 0;
+							for (size_t i = begin; i < end; ++i)
+							{
+								hit_record rec;
+								if (mode.second->hit(rays[i], interval(0.001, infinity), rec))
+									chunkHits++;
+							}
+							hits += chunkHits;
+						});
+				}
+				pool.Wait();
+				double seconds = SecondsSince(start);
+
+				std::clog << std::left << std::setw(10) << threadCount << std::setw(20) << mode.first
+					<< std::setw(12) << rays.size() / seconds / 1e6 << hits << '\n';
+			}
+		}
+	}
+
+	// 统计表面信息的计算次数: sphere 每次算 uv 都要调用一次 acos 和一次 atan2
+	// eager 为 true 时在每次命中时立即计算, 即改动前 sphere::hit 的做法
+	class SurfaceCountingHittable :public hittable
+	{
+	public:
+		SurfaceCountingHittable(shared_ptr<hittable> object, bool eager, size_t& counter)
+			:object(object), eager(eager), counter(counter) {}
+
+		bool hit(const Ray& r, interval ray_t, hit_record& rec)const override
+		{
+			if (!object->hit(r, ray_t, rec))
+				return false;
+			if (eager)
+				FinalizeSurface(r, rec);
+			rec.object = this;
+			return true;
+		}
+		void FinalizeHit(const Ray& r, hit_record& rec)const override
+		{
+			if (!eager)
+				FinalizeSurface(r, rec);
+		}
+		AABB BoundingBox()const override { return object->BoundingBox(); }
+
+	private:
+		void FinalizeSurface(const Ray& r, hit_record& rec)const
+		{
+			counter++;
+			object->FinalizeHit(r, rec);
+		}
+
+		shared_ptr<hittable> object;
+		bool eager;
+		size_t& counter;
+	};
+
+	// 每条射线的三角函数调用次数: 每个被接受的交点都算 uv 与只为最近交点算 uv
+	void BenchmarkSurface(const BenchmarkOptions& options)
+	{
+		auto world = RandomSpheresWorld();
+		auto rays = MakeRays(point3(13, 2, 3), AABB(point3(-11, 0, -11), point3(11, 2, 11)), options.ray_count);
+
+		std::clog << std::left << std::setw(16) << "accel" << std::setw(12) << "surface"
+			<< std::setw(14) << "trig/ray" << std::setw(12) << "Mrays/s" << "hits\n";
+
+		for (bool linear : { true, false })
+		{
+			for (bool eager : { true, false })
+			{
+				size_t surfaceCount = 0;
+				hittable_list wrapped;
+				for (const auto& object : world.objects)
+					wrapped.add(make_shared<SurfaceCountingHittable>(object, eager, surfaceCount));
+
+				shared_ptr<hittable> accel = linear ? shared_ptr<hittable>(make_shared<hittable_list>(wrapped))
+					: shared_ptr<hittable>(make_shared<BVH8>(wrapped));
+
+				size_t hits = 0;
+				auto start = Clock::now();
+				for (const auto& r : rays)
+				{
+					hit_record rec;
+					if (accel->hit(r, interval(0.001, infinity), rec))
+					{
+						rec.object->FinalizeHit(r, rec);
+						hits++;
+					}
+				}
+				double seconds = SecondsSince(start);
+
+				std::clog << std::left << std::setw(16) << (linear ? "hittable_list" : "BVH8")
+					<< std::setw(12) << (eager ? "every hit" : "closest")
+					<< std::setw(14) << 2.0 * surfaceCount / rays.size()
+					<< std::setw(12) << rays.size() / seconds / 1e6 << hits << '\n';
+			}
+		}
+	}
+
+	// RandomSpheresScene 的相机, 用较小的画面以便多次渲染
+	Camera RandomSpheresCamera(int imageWidth, int samplesPerPixel)
+	{
+		Camera camera;
+		camera.aspect_ratio = 16.0 / 9.0;
+		camera.image_width = imageWidth;
+		camera.samples_per_pixel = samplesPerPixel;
+		camera.max_depth = 50;
+		camera.vfov = 20;
+		camera.lookfrom = point3(13, 2, 3);
+		camera.lookat = point3(0, 0, 0);
+		camera.vup = vec3(0, 1, 0);
+		camera.defocus_angle = 0.02;
+		camera.focus_dist = 10.0;
+		camera.show_progress = false;
+		return camera;
+	}
+
+	// 两幅线性空间图像的均方根误差, 尺寸不同时返回 NaN
+	double ImageRMSE(const Framebuffer& image, const Framebuffer& reference)
+	{
+		if (image.Width() != reference.Width() || image.Height() != reference.Height())
+			return std::numeric_limits<double>::quiet_NaN();
+
+		double sum = 0;
+		for (int y = 0; y < image.Height(); ++y)
+		{
+			for (int x = 0; x < image.Width(); ++x)
+			{
+				auto diff = image.GetPixel(x, y) - reference.GetPixel(x, y);
+				sum += diff.length_squared() / 3;
+			}
+		}
+		return std::sqrt(sum / (static_cast<double>(image.Width()) * image.Height()));
+	}
+
+	// 俄罗斯轮盘赌: 每个样本的弹射次数, 以及达到同样噪声所需的时间
+	// 效率 = 1 / (RMSE^2 * 时间), 越大越好
+	void BenchmarkRoulette(const BenchmarkOptions&)
+	{
+		const int imageWidth = 128;
+		const int referenceSpp = 1024;
+		BVH8 world(RandomSpheresWorld());
+
+		auto referenceCamera = RandomSpheresCamera(imageWidth, referenceSpp);
+		referenceCamera.russian_roulette = false;
+		referenceCamera.seed = 1;
+		auto reference = referenceCamera.RenderFramebuffer(world);
+
+		std::clog << std::left << std::setw(10) << "roulette" << std::setw(8) << "spp"
+			<< std::setw(16) << "bounces/sample" << std::setw(12) << "time(s)"
+			<< std::setw(12) << "RMSE" << "efficiency\n";
+
+		for (int spp : { 8, 32, 128 })
+		{
+			for (bool roulette : { false, true })
+			{
+				auto camera = RandomSpheresCamera(imageWidth, spp);
+				camera.russian_roulette = roulette;
+				camera.seed = 2;
+
+				auto start = Clock::now();
+				auto image = camera.RenderFramebuffer(world);
+				double seconds = SecondsSince(start);
+
+				double rmse = ImageRMSE(image, reference);
+				const auto& stats = camera.Stats();
+				std::clog << std::left << std::setw(10) << (roulette ? "on" : "off") << std::setw(8) << spp
+					<< std::setw(16) << static_cast<double>(stats.bounces) / stats.samples
+					<< std::setw(12) << seconds << std::setw(12) << rmse
+					<< 1.0 / (rmse * rmse * seconds) << '\n';
+			}
+		}
+	}
+
+	// 改动前的输出方式: 每个像素三个整数格式化为文本 P3
+	void WriteTextPPM(std::ostream& out, const Framebuffer& image)
+	{
+		out << "P3\n" << image.Width() << ' ' << image.Height() << "\n255\n";
+		static const interval intensity(0.000, 0.999);
+		for (int y = 0; y < image.Height(); ++y)
+		{
+			for (int x = 0; x < image.Width(); ++x)
+			{
+				auto c = image.GetPixel(x, y);
+				out << static_cast<int>(256 * intensity.clamp(linear_to_gamma(c.x()))) << ' '
+					<< static_cast<int>(256 * intensity.clamp(linear_to_gamma(c.y()))) << ' '
+					<< static_cast<int>(256 * intensity.clamp(linear_to_gamma(c.z()))) << '\n';
+			}
+		}
+	}
+
+	// 4K 帧的输出耗时
+	void BenchmarkOutput(const BenchmarkOptions&)
+	{
+		const int width = 3840;
+		const int height = 2160;
+		Framebuffer image(width, height);
+		for (int y = 0; y < height; ++y)
+			for (int x = 0; x < width; ++x)
+				image.SetPixel(x, y, color(double(x) / width, double(y) / height, random_double()));
+
+		std::clog << std::left << std::setw(20) << "writer" << std::setw(12) << "time(ms)" << "bytes\n";
+
+		auto report = [](const char* name, Clock::time_point start, size_t bytes)
+		{
+			std::clog << std::left << std::setw(20) << name << std::setw(12) << SecondsSince(start) * 1000 << bytes << '\n';
+		};
+		auto fileSize = [](const char* fileName)
+		{
+			std::ifstream in(fileName, std::ios::binary | std::ios::ate);
+			return static_cast<size_t>(in.tellg());
+		};
+
+		{
+			std::ostringstream out;
+			auto start = Clock::now();
+			WriteTextPPM(out, image);
+			report("text P3", start, out.str().size());
+		}
+		{
+			std::vector<unsigned char> rgb8;
+			auto start = Clock::now();
+			image.ToneMap(rgb8);
+			report("tone map only", start, rgb8.size());
+		}
+		{
+			std::ostringstream out;
+			auto start = Clock::now();
+			image.WritePPM(out);
+			report("binary P6", start, out.str().size());
+		}
+		{
+			std::ostringstream out;
+			auto start = Clock::now();
+			image.WritePFM(out);
+			report("PFM", start, out.str().size());
+		}
+		for (const auto& file : { std::make_pair("PNG", "benchmark_output.png"), std::make_pair("HDR", "benchmark_output.hdr") })
+		{
+			auto start = Clock::now();
+			image.Write(file.second);
+			report(file.first, start, fileSize(file.second));
+			std::remove(file.second);
+		}
+	}
+
+	struct ConvergencePoint
+	{
+		size_t samples;
+		double seconds;
+		double rmse;
+	};
+
+	// 在 (时间, RMSE) 曲线上按对数插值, 求 RMSE 首次降到 target 的时间, 达不到时返回 infinity
+	double TimeToRMSE(std::vector<ConvergencePoint> points, double target)
+	{
+		std::sort(points.begin(), points.end(), [](const auto& a, const auto& b) { return a.seconds < b.seconds; });
+		for (size_t i = 0; i < points.size(); ++i)
+		{
+			if (points[i].rmse > target)
+				continue;
+			if (i == 0)
+				return points[0].seconds;
+			const auto& a = points[i - 1];
+			const auto& b = points[i];
+			double f = std::log(a.rmse / target) / std::log(a.rmse / b.rmse);
+			return std::exp(std::log(a.seconds) + f * std::log(b.seconds / a.seconds));
+		}
+		return infinity;
+	}
+
+	// 自适应采样与均匀采样: 总样本数, 时间和 RMSE, 以及达到同一 RMSE 所需的时间
+	// 目标 RMSE 取均匀采样 64 spp 的结果
+	void BenchmarkAdaptive(const BenchmarkOptions&)
+	{
+		const int imageWidth = 128;
+		const int referenceSpp = 1024;
+
+		struct AdaptiveScene
+		{
+			const char* name;
+			shared_ptr<hittable> world;
+			double defocusAngle;
+		};
+		std::vector<AdaptiveScene> scenes;
+		scenes.push_back({ "RandomSpheres", make_shared<BVH8>(RandomSpheresWorld()), 0.02 });
+		scenes.push_back({ "TwoSpheres", make_shared<hittable_list>(TwoSpheresWorld()), 0.0 });
+
+		for (const auto& scene : scenes)
+		{
+			auto makeCamera = [&](int spp)
+			{
+				auto camera = RandomSpheresCamera(imageWidth, spp);
+				camera.defocus_angle = scene.defocusAngle;
+				return camera;
+			};
+
+			auto referenceCamera = makeCamera(referenceSpp);
+			referenceCamera.seed = 1;
+			auto reference = referenceCamera.RenderFramebuffer(*scene.world);
+
+			std::clog << scene.name << '\n' << std::left << std::setw(12) << "sampling" << std::setw(12) << "setting"
+				<< std::setw(14) << "samples" << std::setw(12) << "time(s)" << "RMSE\n";
+
+			auto run = [&](Camera& camera, const char* mode, const std::string& setting)
+			{
+				camera.seed = 2;
+				auto start = Clock::now();
+				auto image = camera.RenderFramebuffer(*scene.world);
+				ConvergencePoint point{ camera.Stats().samples, SecondsSince(start), ImageRMSE(image, reference) };
+				std::clog << std::left << std::setw(12) << mode << std::setw(12) << setting
+					<< std::setw(14) << point.samples << std::setw(12) << point.seconds << point.rmse << '\n';
+				return point;
+			};
+
+			std::vector<ConvergencePoint> uniform, adaptive;
+			double target = 0;
+			for (int spp : { 8, 16, 32, 64, 128 })
+			{
+				auto camera = makeCamera(spp);
+				uniform.push_back(run(camera, "uniform", std::to_string(spp) + " spp"));
+				if (spp == 64)
+					target = uniform.back().rmse;
+			}
+			for (double error : { 0.04, 0.03, 0.02, 0.015 })
+			{
+				// 预算足够大, 由误差阈值决定何时停止
+				auto camera = makeCamera(128);
+				camera.adaptive_sampling = true;
+				camera.adaptive_error = error;
+				camera.adaptive_min_samples = 8;
+				camera.tile_size = 8;
+				std::ostringstream setting;
+				setting << error;
+				adaptive.push_back(run(camera, "adaptive", setting.str()));
+			}
+
+			std::clog << "time to RMSE " << target << ": uniform " << TimeToRMSE(uniform, target)
+				<< "s, adaptive " << TimeToRMSE(adaptive, target) << "s\n\n";
+		}
+	}
+
+	// 各种采样器的 RMSE 随每像素样本数的变化, 参考图像用独立采样 1024 spp
+	void BenchmarkSampler(const BenchmarkOptions&)
+	{
+		const int imageWidth = 128;
+		const int referenceSpp = 1024;
+
+		struct SamplerScene
+		{
+			const char* name;
+			shared_ptr<hittable> world;
+			double defocusAngle;
+		};
+		std::vector<SamplerScene> scenes;
+		scenes.push_back({ "RandomSpheres", make_shared<BVH8>(RandomSpheresWorld()), 0.02 });
+		scenes.push_back({ "TwoSpheres", make_shared<hittable_list>(TwoSpheresWorld()), 0.0 });
+
+		for (const auto& scene : scenes)
+		{
+			auto makeCamera = [&](int spp)
+			{
+				auto camera = RandomSpheresCamera(imageWidth, spp);
+				camera.defocus_angle = scene.defocusAngle;
+				return camera;
+			};
+
+			auto referenceCamera = makeCamera(referenceSpp);
+			referenceCamera.seed = 1;
+			auto reference = referenceCamera.RenderFramebuffer(*scene.world);
+
+			std::clog << scene.name << '\n' << std::left << std::setw(14) << "sampler" << std::setw(8) << "spp"
+				<< std::setw(12) << "time(s)" << std::setw(16) << "bounces/sample" << "RMSE\n";
+
+			for (auto type : { SamplerType::Independent, SamplerType::Stratified, SamplerType::Sobol, SamplerType::BlueNoise })
+			{
+				for (int spp : { 1, 4, 16, 64 })
+				{
+					auto camera = makeCamera(spp);
+					camera.sampler_type = type;
+					camera.seed = 2;
+
+					auto start = Clock::now();
+					auto image = camera.RenderFramebuffer(*scene.world);
+					double seconds = SecondsSince(start);
+
+					const auto& stats = camera.Stats();
+					std::clog << std::left << std::setw(14) << SamplerName(type) << std::setw(8) << spp
+						<< std::setw(12) << seconds << std::setw(16) << static_cast<double>(stats.bounces) / stats.samples
+						<< ImageRMSE(image, reference) << '\n';
+				}
+			}
+			std::clog << '\n';
+		}
+	}
+
+	// 改动前的做法: 每个三角形是一个独立的 hittable, 顶点用 double 各存一份
+	class TriangleObject :public hittable
+	{
+	public:
+		TriangleObject(const point3& p0, const point3& p1, const point3& p2, shared_ptr<Material> mat)
+			:p0(p0), e1(p1 - p0), e2(p2 - p0), mat(std::move(mat)), bbox(AABB(p0, p1), AABB(p2, p2)) {}
+
+		// Moller-Trumbore
+		bool hit(const Ray& r, interval ray_t, hit_record& rec)const override
+		{
+			vec3 pvec = cross(r.GetDirection(), e2);
+			double det = dot(e1, pvec);
+			if (det == 0)
+				return false;
+			double invDet = 1.0 / det;
+			vec3 tvec = r.GetOrigin() - p0;
+			double u = dot(tvec, pvec) * invDet;
+			if (u < 0 || u > 1)
+				return false;
+			vec3 qvec = cross(tvec, e1);
+			double v = dot(r.GetDirection(), qvec) * invDet;
+			if (v < 0 || u + v > 1)
+				return false;
+			double t = dot(e2, qvec) * invDet;
+			if (!ray_t.surrounds(t))
+				return false;
+
+			rec.t = t;
+			rec.mat = mat.get();
+			rec.object = this;
+			return true;
+		}
+		AABB BoundingBox()const override { return bbox; }
+
+	private:
+		point3 p0;
+		vec3 e1, e2;
+		shared_ptr<Material> mat;
+		AABB bbox;
+	};
+
+	Camera MeshCamera(const AABB& bounds, int imageWidth, int samplesPerPixel)
+	{
+		auto camera = RandomSpheresCamera(imageWidth, samplesPerPixel);
+		auto center = bounds.Centroid();
+		double radius = 0.5 * (bounds.x.size() + bounds.y.size() + bounds.z.size()) / 3 * std::sqrt(3.0);
+		camera.vfov = 40;
+		camera.lookat = center;
+		camera.lookfrom = center + vec3(0.6, 0.4, -1) * (radius * 2.2);
+		camera.defocus_angle = 0;
+		return camera;
+	}
+
+	// 三角形网格: 每个三角形占用的内存, 射线吞吐量和 1 spp 整帧耗时
+	void BenchmarkMesh(const BenchmarkOptions& options)
+	{
+		std::clog << std::left << std::setw(8) << "model" << std::setw(16) << "layout" << std::setw(12) << "triangles"
+			<< std::setw(12) << "build(s)" << std::setw(12) << "bytes/tri" << std::setw(12) << "Mrays/s"
+			<< std::setw(10) << "hits" << "frame(ms)\n";
+
+		auto material = make_shared<Lambertian>(color(0.8, 0.78, 0.7));
+		for (const char* model : { "skull.txt", "car.txt" })
+		{
+			std::vector<point3> positions;
+			std::vector<vec3> normals;
+			std::vector<uint32_t> indices;
+			if (!LoadModelFile(model, positions, normals, indices))
+				continue;
+			size_t triangleCount = indices.size() / 3;
+
+			auto start = Clock::now();
+			triangle_mesh mesh(positions, normals, indices, material);
+			double meshBuild = SecondsSince(start);
+
+			hittable_list triangles;
+			for (size_t i = 0; i < triangleCount; ++i)
+			{
+				triangles.add(make_shared<TriangleObject>(positions[indices[i * 3]], positions[indices[i * 3 + 1]],
+					positions[indices[i * 3 + 2]], material));
+			}
+			start = Clock::now();
+			LinearBVH objectBVH(triangles);
+			double objectBuild = SecondsSince(start);
+
+			// make_shared 把对象和控制块放在一次分配里, 另有列表和 BVH 中各一个 shared_ptr
+			size_t objectBytes = triangleCount * (sizeof(TriangleObject) + 16 + 2 * sizeof(shared_ptr<hittable>))
+				+ objectBVH.NodeCount() * sizeof(LinearBVHNode);
+
+			auto bounds = mesh.BoundingBox();
+			auto camera = MeshCamera(bounds, 400, 1);
+			auto rays = MakeRays(camera.lookfrom, bounds, options.ray_count);
+
+			std::string name(model, std::strchr(model, '.'));
+			const std::pair<const char*, const hittable*> layouts[] = {
+				{ "per-triangle", &objectBVH }, { "triangle_mesh", &mesh } };
+			for (const auto& layout : layouts)
+			{
+				size_t hits = 0;
+				double raysPerSecond = TraceRays(*layout.second, rays, hits);
+
+				camera.seed = 1;
+				start = Clock::now();
+				camera.RenderFramebuffer(*layout.second);
+				double frame = SecondsSince(start);
+
+				bool isMesh = layout.second == &mesh;
+				std::clog << std::left << std::setw(8) << name << std::setw(16) << layout.first << std::setw(12) << triangleCount
+					<< std::setw(12) << (isMesh ? meshBuild : objectBuild)
+					<< std::setw(12) << static_cast<double>(isMesh ? mesh.MemoryBytes() : objectBytes) / triangleCount
+					<< std::setw(12) << raysPerSecond / 1e6 << std::setw(10) << hits << frame * 1000 << '\n';
+			}
+		}
+	}
+
+	// rows x rows 个头骨的变换, 与 SkullFieldWorld 的排列相同
+	std::vector<Transform> SkullFieldTransforms(int rows)
+	{
+		std::vector<Transform> transforms;
+		const double spacing = 12.0;
+		double origin = -0.5 * spacing * (rows - 1);
+		for (int i = 0; i < rows; ++i)
+		{
+			for (int j = 0; j < rows; ++j)
+			{
+				transforms.push_back(Transform::Translate(vec3(origin + i * spacing, 0, origin + j * spacing))
+					* Transform::RotateY(random_double(0, 360)) * Transform::Scale(random_double(0.6, 1.2)));
+			}
+		}
+		return transforms;
+	}
+
+	// 实例化与把所有副本展开成一个大网格: 构建时间, 内存和遍历速度
+	void BenchmarkInstance(const BenchmarkOptions& options)
+	{
+		std::vector<point3> positions;
+		std::vector<vec3> normals;
+		std::vector<uint32_t> indices;
+		if (!LoadModelFile("skull.txt", positions, normals, indices))
+			return;
+
+		auto material = make_shared<Lambertian>(color(0.8, 0.78, 0.7));
+		auto skull = make_shared<triangle_mesh>(positions, normals, indices, material);
+		size_t triangleCount = skull->TriangleCount();
+
+		std::clog << std::left << std::setw(12) << "layout" << std::setw(10) << "copies" << std::setw(14) << "triangles"
+			<< std::setw(12) << "build(s)" << std::setw(14) << "memory(MB)" << std::setw(12) << "Mrays/s" << "hits\n";
+
+		auto report = [&](const char* layout, size_t copies, double buildTime, size_t bytes, const hittable& world,
+			const std::vector<Ray>& rays)
+		{
+			size_t hits = 0;
+			double raysPerSecond = TraceRays(world, rays, hits);
+
+			std::clog << std::left << std::setw(12) << layout << std::setw(10) << copies << std::setw(14) << copies * triangleCount
+				<< std::setw(12) << buildTime << std::setw(14) << bytes / (1024.0 * 1024.0)
+				<< std::setw(12) << raysPerSecond / 1e6 << hits << '\n';
+		};
+
+		for (int rows : { 2, 4, 6, 32, 100 })
+		{
+			auto transforms = SkullFieldTransforms(rows);
+
+			auto start = Clock::now();
+			hittable_list instances;
+			for (const auto& transform : transforms)
+				instances.add(make_shared<instance>(skull, transform));
+			BVH8 world(instances);
+			double buildTime = SecondsSince(start);
+
+			// 从场地一角斜向射入, 两种布局使用同一组射线
+			auto bounds = world.BoundingBox();
+			auto rays = MakeRays(point3(bounds.x.min - 20, 20, bounds.z.min - 20), bounds, options.ray_count);
+
+			// 网格一份, 每个实例是一次 make_shared 分配 (含控制块) 加列表和 BVH 中各一个 shared_ptr
+			size_t bytes = skull->MemoryBytes()
+				+ transforms.size() * (sizeof(instance) + 16 + 2 * sizeof(shared_ptr<hittable>))
+				+ world.NodeCount() * sizeof(WideBVHNode<8>);
+			report("instanced", transforms.size(), buildTime, bytes, world, rays);
+
+			// 展开后的网格随副本数线性增长, 只测小规模
+			if (rows <= 6)
+			{
+				std::vector<point3> flatPositions;
+				std::vector<vec3> flatNormals;
+				std::vector<uint32_t> flatIndices;
+				for (const auto& transform : transforms)
+				{
+					auto normalTransform = transform.Inverse();
+					auto base = static_cast<uint32_t>(flatPositions.size());
+					for (size_t v = 0; v < positions.size(); ++v)
+					{
+						flatPositions.push_back(transform.ApplyPoint(positions[v]));
+						flatNormals.push_back(unit_vector(normalTransform.ApplyTransposed(normals[v])));
+					}
+					for (auto index : indices)
+						flatIndices.push_back(base + index);
+				}
+
+				start = Clock::now();
+				triangle_mesh flat(flatPositions, flatNormals, std::move(flatIndices), material);
+				buildTime = SecondsSince(start);
+				report("flattened", transforms.size(), buildTime, flat.MemoryBytes(), flat, rays);
+			}
+		}
+	}
+
+	// 两级加速结构的逐帧更新: 10000 个实例绕各自的位置运动,
+	// 对比每帧重建包含全部图元的单层 BVH, 重建顶层 BVH 和只 Refit 顶层 BVH
+	void BenchmarkTLAS(const BenchmarkOptions& options)
+	{
+		const int rows = 100;
+		const int spheresPerInstance = 100;
+		const int frameCount = 30;
+		const double spacing = 4.0;
+
+		// 底层: 单位球内 100 个小球组成的团, 所有实例共用
+		auto material = make_shared<Lambertian>(color(0.5, 0.5, 0.5));
+		std::vector<point3> centers;
+		std::vector<double> radii;
+		hittable_list cluster;
+		for (int i = 0; i < spheresPerInstance; ++i)
+		{
+			centers.push_back(random_in_unit_sphere());
+			radii.push_back(random_double(0.05, 0.1));
+			cluster.add(make_shared<sphere>(centers.back(), radii.back(), material));
+		}
+		auto blas = make_shared<BVH8>(cluster);
+
+		struct Motion
+		{
+			point3 base;
+			double phase, speed, radius;
+		};
+		std::vector<Motion> motions;
+		for (int i = 0; i < rows; ++i)
+			for (int j = 0; j < rows; ++j)
+				motions.push_back({ point3((i - rows / 2) * spacing, 0, (j - rows / 2) * spacing),
+					random_double(0, 2 * pi), random_double(0.5, 1.5), random_double(0, 3 * spacing) });
+
+		// 每帧的时间步长 0.1, 运动半径可达 3 个间距, 实例之间会互相穿过
+		auto transformAt = [&](size_t i, int frame)
+		{
+			const auto& m = motions[i];
+			double angle = m.phase + m.speed * 0.1 * frame;
+			auto offset = vec3(std::cos(angle), 0.1 * std::sin(3 * angle), std::sin(angle)) * m.radius;
+			return Transform::Translate(m.base + offset) * Transform::RotateY(angle * 180 / pi);
+		};
+
+		std::vector<shared_ptr<instance>> instances;
+		for (size_t i = 0; i < motions.size(); ++i)
+			instances.push_back(make_shared<instance>(blas, transformAt(i, 0)));
+
+		double extent = 0.5 * rows * spacing + 4 * spacing;
+		AABB target(point3(-extent, -2, -extent), point3(extent, 2, extent));
+		auto rays = MakeRays(point3(-extent - 20, 30, -extent - 20), target, options.ray_count);
+
+		std::clog << instances.size() << " instances x " << spheresPerInstance << " spheres, " << frameCount << " frames\n"
+			<< std::left << std::setw(16) << "update" << std::setw(16) << "ms/frame" << std::setw(12) << "SAH cost"
+			<< std::setw(12) << "Mrays/s" << "hits\n";
+
+		// 单层: 每帧把所有小球变换到世界空间后重建, 代价太高只跑几帧
+		{
+			const int flatFrames = 3;
+			double seconds = 0;
+			shared_ptr<LinearBVH> flat;
+			for (int frame = frameCount - flatFrames + 1; frame <= frameCount; ++frame)
+			{
+				auto start = Clock::now();
+				hittable_list spheres;
+				spheres.objects.reserve(instances.size() * spheresPerInstance);
+				for (size_t i = 0; i < instances.size(); ++i)
+				{
+					auto transform = transformAt(i, frame);
+					for (int k = 0; k < spheresPerInstance; ++k)
+						spheres.add(make_shared<sphere>(transform.ApplyPoint(centers[k]), radii[k], material));
+				}
+				flat = make_shared<LinearBVH>(spheres);
+				seconds += SecondsSince(start);
+			}
+
+			size_t hits = 0;
+			double raysPerSecond = TraceRays(*flat, rays, hits);
+			std::clog << std::left << std::setw(16) << "flat rebuild" << std::setw(16) << seconds / flatFrames * 1000
+				<< std::setw(12) << "-" << std::setw(12) << raysPerSecond / 1e6 << hits << '\n';
+		}
+
+		for (bool refit : { false, true })
+		{
+			TopLevelBVH tlas(instances);
+			double seconds = 0;
+			for (int frame = 1; frame <= frameCount; ++frame)
+			{
+				auto start = Clock::now();
+				for (size_t i = 0; i < instances.size(); ++i)
+					tlas.SetTransform(i, transformAt(i, frame));
+				if (refit)
+					tlas.Refit();
+				else
+					tlas.Rebuild();
+				seconds += SecondsSince(start);
+			}
+
+			size_t hits = 0;
+			double raysPerSecond = TraceRays(tlas, rays, hits);
+			std::clog << std::left << std::setw(16) << (refit ? "TLAS refit" : "TLAS rebuild")
+				<< std::setw(16) << seconds / frameCount * 1000 << std::setw(12) << tlas.SAHCost()
+				<< std::setw(12) << raysPerSecond / 1e6 << hits << '\n';
+
+			// 复位, 下一种策略从同样的初始状态开始
+			for (size_t i = 0; i < instances.size(); ++i)
+				tlas.SetTransform(i, transformAt(i, 0));
+		}
+	}
+
+	// 逐帧动画中加速结构的更新方式: 每帧重建, 只 Refit, 以及 Refit 后按 SAH 代价决定是否重建
+	void BenchmarkRefit(const BenchmarkOptions& options)
+	{
+		struct RefitStrategy
+		{
+			const char* name;
+			// 返回本帧是否重建
+			std::function<bool()> update;
+			std::function<double()> sahCost;
+			const hittable* accel;
+		};
+
+		std::clog << std::left << std::setw(22) << "scene" << std::setw(10) << "accel" << std::setw(10) << "update"
+			<< std::setw(14) << "ms/frame" << std::setw(10) << "rebuilds" << std::setw(12) << "SAH ratio"
+			<< std::setw(12) << "Mrays/s" << "hits\n";
+
+		// setFrame(f) 把场景移动到第 f 帧, 第 0 帧是构建时的状态
+		auto run = [&](const std::string& sceneName, const hittable_list& world, int frameCount,
+			const std::function<void(int)>& setFrame, const point3& eye, const AABB& target)
+		{
+			auto rays = MakeRays(eye, target, options.ray_count);
+
+			auto report = [&](const char* accelName, const RefitStrategy& strategy, double seconds, int rebuilds,
+				double freshCost)
+			{
+				size_t hits = 0;
+				double raysPerSecond = TraceRays(*strategy.accel, rays, hits);
+				std::clog << std::left << std::setw(22) << sceneName << std::setw(10) << accelName << std::setw(10) << strategy.name
+					<< std::setw(14) << seconds / frameCount * 1000 << std::setw(10) << rebuilds
+					<< std::setw(12) << strategy.sahCost() / freshCost << std::setw(12) << raysPerSecond / 1e6 << hits << '\n';
+			};
+
+			auto measure = [&](const char* accelName, RefitStrategy strategy, double freshCost)
+			{
+				double seconds = 0;
+				int rebuilds = 0;
+				for (int frame = 1; frame <= frameCount; ++frame)
+				{
+					setFrame(frame);
+					auto start = Clock::now();
+					rebuilds += strategy.update() ? 1 : 0;
+					seconds += SecondsSince(start);
+				}
+				report(accelName, strategy, seconds, rebuilds, freshCost);
+			};
+
+			// 最后一帧重新构建的树的代价, 作为比较的基准
+			setFrame(frameCount);
+			double freshBinary = BVHNode(world, BVHSplitMethod::SAH).SAHCost();
+			double freshWide = BVH8(world).SAHCost();
+
+			for (const char* mode : { "rebuild", "refit", "update" })
+			{
+				setFrame(0);
+				auto bvh = make_shared<BVHNode>(world, BVHSplitMethod::SAH);
+				double builtCost = bvh->SAHCost();
+				RefitStrategy strategy{ mode, nullptr, [&] { return bvh->SAHCost(); }, nullptr };
+				strategy.update = [&, mode]
+				{
+					// BVHNode 没有保存构建参数, 这里在外面按同样的规则决定是否重建
+					if (std::strcmp(mode, "rebuild") != 0)
+					{
+						bvh->Refit();
+						if (std::strcmp(mode, "refit") == 0 || bvh->SAHCost() <= kDefaultRebuildCostRatio * builtCost)
+							return false;
+					}
+					bvh = make_shared<BVHNode>(world, BVHSplitMethod::SAH);
+					builtCost = bvh->SAHCost();
+					return true;
+				};
+				// accel 在测量结束时才用到, 指向最终的树
+				struct Forward :public hittable
+				{
+					shared_ptr<BVHNode>& target;
+					Forward(shared_ptr<BVHNode>& target) :target(target) {}
+					bool hit(const Ray& r, interval ray_t, hit_record& rec)const override { return target->hit(r, ray_t, rec); }
+					AABB BoundingBox()const override { return target->BoundingBox(); }
+				} forward(bvh);
+				strategy.accel = &forward;
+				measure("BVHNode", strategy, freshBinary);
+			}
+
+			for (const char* mode : { "rebuild", "refit", "update" })
+			{
+				setFrame(0);
+				BVH8 bvh(world);
+				RefitStrategy strategy{ mode, nullptr, [&] { return bvh.SAHCost(); }, &bvh };
+				if (std::strcmp(mode, "rebuild") == 0)
+					strategy.update = [&] { bvh.Rebuild(); return true; };
+				else if (std::strcmp(mode, "refit") == 0)
+					strategy.update = [&] { bvh.Refit(); return false; };
+				else
+					strategy.update = [&] { return bvh.Update(); };
+				measure("BVH8", strategy, freshWide);
+			}
+		};
+
+		// RandomSpheresScene 的动画, 10 秒 24 帧每秒
+		{
+			auto world = RandomSpheresWorld();
+			RandomSpheresAnimation animation(world);
+			run("RandomSpheres", world, 240, [&](int frame) { animation.SetTime(frame / 24.0); },
+				point3(13, 2, 3), AABB(point3(-11, 0, -11), point3(11, 2, 11)));
+		}
+
+		// 成团的小球各自沿固定方向漂移, 团逐渐散开, 只 Refit 的树会越来越差
+		{
+			size_t count = std::min<size_t>(options.primitive_count, 200000);
+			auto world = ClusteredSpheresWorld(count);
+			std::vector<shared_ptr<sphere>> spheres;
+			std::vector<point3> bases;
+			std::vector<vec3> velocities;
+			for (const auto& object : world.objects)
+			{
+				auto ball = std::dynamic_pointer_cast<sphere>(object);
+				spheres.push_back(ball);
+				bases.push_back(ball->Center());
+				velocities.push_back(random_unit_vector() * 0.2);
+			}
+			auto setFrame = [&](int frame)
+			{
+				for (size_t i = 0; i < spheres.size(); ++i)
+					spheres[i]->SetCenter(bases[i] + velocities[i] * frame);
+			};
+			run("Clustered" + std::to_string(count), world, 30, setFrame,
+				point3(120, 60, 150), AABB(point3(-54, -54, -54), point3(54, 54, 54)));
+		}
+	}
+
+	// 运动模糊: 子节点使用整个快门内扫过的包围盒, 与按射线时刻插值的包围盒对比
+	// 两种方式的命中数和渲染结果必须相同
+	void BenchmarkMotion(const BenchmarkOptions& options)
+	{
+		const int imageWidth = 200;
+		const int samplesPerPixel = 32;
+
+		std::clog << std::left << std::setw(10) << "motion" << std::setw(8) << "accel" << std::setw(14) << "bounds"
+			<< std::setw(12) << "build(ms)" << std::setw(12) << "Mrays/s"
+			<< std::setw(10) << "hits" << std::setw(12) << "render(s)" << "same image\n";
+
+		for (double motionScale : { 1.0, 4.0 })
+		{
+			auto world = RandomSpheresWorld(motionScale);
+			auto rays = MakeRays(point3(13, 2, 3), AABB(point3(-11, 0, -11), point3(11, 2, 11)), options.ray_count);
+
+			auto run = [&](const char* accelName, auto makeAccel)
+			{
+				Framebuffer sweptImage;
+				for (bool interpolate : { false, true })
+				{
+					auto start = Clock::now();
+					auto accel = makeAccel(interpolate);
+					double buildTime = SecondsSince(start);
+
+					// 差别不大, 取三次中最好的结果减少波动
+					size_t hits = 0;
+					double raysPerSecond = 0;
+					double renderTime = infinity;
+					Framebuffer image;
+					for (int repeat = 0; repeat < 3; ++repeat)
+					{
+						raysPerSecond = std::max(raysPerSecond, TraceRays(*accel, rays, hits));
+
+						auto camera = RandomSpheresCamera(imageWidth, samplesPerPixel);
+						camera.seed = 1;
+						start = Clock::now();
+						image = camera.RenderFramebuffer(*accel);
+						renderTime = std::min(renderTime, SecondsSince(start));
+					}
+
+					const char* same = "-";
+					if (interpolate)
+						same = ImageRMSE(image, sweptImage) == 0 ? "yes" : "NO";
+					else
+						sweptImage = std::move(image);
+
+					std::ostringstream motion;
+					motion << "x" << motionScale;
+					std::clog << std::left << std::setw(10) << motion.str() << std::setw(8) << accelName
+						<< std::setw(14) << (interpolate ? "interpolated" : "swept")
+						<< std::setw(12) << buildTime * 1000
+						<< std::setw(12) << raysPerSecond / 1e6 << std::setw(10) << hits
+						<< std::setw(12) << renderTime << same << '\n';
+				}
+			};
+
+			run("BVH4", [&](bool interpolate)
+				{ return make_shared<BVH4>(world, BVHSplitMethod::SAH, BVHNode::DefaultMaxLeafSize, 0, interpolate); });
+			run("BVH8", [&](bool interpolate)
+				{ return make_shared<BVH8>(world, BVHSplitMethod::SAH, BVHNode::DefaultMaxLeafSize, 0, interpolate); });
+		}
+	}
+
+	// 逐个 sphere 与按组打包成 sphere_set 的对比, 外层都是 BVH8
+	// 内存只计算图元本身和 make_shared 的控制块, 不含外层 BVH
+	void BenchmarkSphereSet(const BenchmarkOptions& options)
+	{
+		const int imageWidth = 200;
+		const int samplesPerPixel = 16;
+		const size_t controlBlockBytes = 2 * sizeof(void*);
+
+		struct SphereScene
+		{
+			std::string name;
+			hittable_list world;
+			point3 eye;
+			AABB target;
+			bool render;
+		};
+		std::vector<SphereScene> scenes;
+		scenes.push_back({ "RandomSpheres", RandomSpheresWorld(), point3(13, 2, 3),
+			AABB(point3(-11, 0, -11), point3(11, 2, 11)), true });
+		size_t count = std::min<size_t>(options.primitive_count, 200000);
+		scenes.push_back({ "Clustered" + std::to_string(count), ClusteredSpheresWorld(count), point3(120, 60, 150),
+			AABB(point3(-50, -50, -50), point3(50, 50, 50)), false });
+
+		std::clog << std::left << std::setw(18) << "scene" << std::setw(10) << "layout" << std::setw(12) << "build(ms)"
+			<< std::setw(14) << "bytes/sphere" << std::setw(12) << "Mrays/s" << std::setw(10) << "hits"
+			<< std::setw(12) << "render(s)" << "same image\n";
+
+		for (const auto& scene : scenes)
+		{
+			auto rays = MakeRays(scene.eye, scene.target, options.ray_count);
+			size_t sphereCount = scene.world.objects.size();
+			Framebuffer reference;
+
+			for (int groupSize : { 0, 4, 8 })
+			{
+				auto start = Clock::now();
+				hittable_list primitives = groupSize == 0 ? scene.world : PackSpheres(scene.world, groupSize);
+				// sphere_set 本身就是一个叶子, 外层 BVH 每个叶子只放一组
+				BVH8 bvh(primitives, BVHSplitMethod::SAH, groupSize == 0 ? BVHNode::DefaultMaxLeafSize : 1);
+				double buildTime = SecondsSince(start);
+
+				size_t bytes = groupSize == 0 ? sphereCount * (sizeof(sphere) + controlBlockBytes)
+					: primitives.objects.size() * (sizeof(sphere_set) + controlBlockBytes);
+
+				size_t hits = 0;
+				double raysPerSecond = 0;
+				for (int repeat = 0; repeat < 5; ++repeat)
+					raysPerSecond = std::max(raysPerSecond, TraceRays(bvh, rays, hits));
+
+				std::ostringstream renderTime;
+				const char* same = "-";
+				if (scene.render)
+				{
+					double best = infinity;
+					Framebuffer image;
+					for (int repeat = 0; repeat < 3; ++repeat)
+					{
+						auto camera = RandomSpheresCamera(imageWidth, samplesPerPixel);
+						camera.seed = 1;
+						start = Clock::now();
+						image = camera.RenderFramebuffer(bvh);
+						best = std::min(best, SecondsSince(start));
+					}
+					renderTime << best;
+					if (groupSize == 0)
+						reference = std::move(image);
+					else
+						same = ImageRMSE(image, reference) == 0 ? "yes" : "NO";
+				}
+
+				std::string layout = groupSize == 0 ? "sphere" : "set" + std::to_string(groupSize);
+				std::clog << std::left << std::setw(18) << scene.name << std::setw(10) << layout
+					<< std::setw(12) << buildTime * 1000 << std::setw(14) << static_cast<double>(bytes) / sphereCount
+					<< std::setw(12) << raysPerSecond / 1e6 << std::setw(10) << hits
+					<< std::setw(12) << (scene.render ? renderTime.str() : "-") << same << '\n';
+			}
+		}
+	}
+	// 针孔相机的射线, 按 8x8 的块排列, 块内逐行, 连续 8 条是同一行相邻的像素
+	std::vector<Ray> MakePrimaryRays(const point3& eye, const point3& lookat, double vfov, size_t count)
+	{
+		int width = std::max(8, static_cast<int>(std::sqrt(count * 16.0 / 9.0)) / 8 * 8);
+		int height = std::max(8, static_cast<int>(count / width) / 8 * 8);
+
+		vec3 w = unit_vector(eye - lookat);
+		vec3 u = unit_vector(cross(vec3(0, 1, 0), w));
+		vec3 v = cross(w, u);
+		double halfHeight = std::tan(degrees_to_radians(vfov) / 2);
+		double halfWidth = halfHeight * width / height;
+
+		std::vector<Ray> rays;
+		rays.reserve(static_cast<size_t>(width) * height);
+		for (int by = 0; by < height; by += 8)
+			for (int bx = 0; bx < width; bx += 8)
+				for (int y = by; y < by + 8; ++y)
+					for (int x = bx; x < bx + 8; ++x)
+					{
+						double sx = (2 * (x + 0.5) / width - 1) * halfWidth;
+						double sy = (1 - 2 * (y + 0.5) / height) * halfHeight;
+						rays.emplace_back(eye, sx * u + sy * v - w, 0.5);
+					}
+		return rays;
+	}
+
+	// 在 rays 的交点上按漫反射方向弹射一次, 得到起点相邻但方向随机的射线
+	std::vector<Ray> MakeBounceRays(const hittable& world, const std::vector<Ray>& rays)
+	{
+		std::vector<Ray> bounced;
+		IndependentSampler sampler(2);
+		for (size_t i = 0; i < rays.size(); ++i)
+		{
+			hit_record rec;
+			if (!world.hit(rays[i], interval(0.001, infinity), rec))
+				continue;
+			rec.object->FinalizeHit(rays[i], rec);
+			sampler.StartPixelSample(static_cast<int>(i), 0, 0);
+			bounced.emplace_back(rec.p, rec.normal + random_unit_vector(sampler), rays[i].GetTime());
+		}
+		return bounced;
+	}
+
+	// 逐条 hit() 与 packet / 排序后的 stream 的对比, 最后是相机射线打包前后的整幅渲染
+	// same hits 检查每条射线命中的对象和 t 是否与逐条 hit() 完全相同
+	void BenchmarkPacket(const BenchmarkOptions& options)
+	{
+		const int imageWidth = 200;
+		const int samplesPerPixel = 16;
+
+		struct PacketScene
+		{
+			std::string name;
+			hittable_list world;
+			point3 eye;
+			point3 lookat;
+			double vfov;
+		};
+		std::vector<PacketScene> scenes;
+		scenes.push_back({ "RandomSpheres", RandomSpheresWorld(), point3(13, 2, 3), point3(0, 0, 0), 20 });
+		// 网格没有重写 HitPacket(), 走逐条调用 hit() 的默认实现; 找不到模型时跳过这一行
+		auto skullWorld = SkullWorld();
+		if (!skullWorld.objects.empty())
+			scenes.push_back({ "Skull", skullWorld, point3(8, 6, -14), point3(0, 3, 0), 30 });
+
+		std::clog << std::left << std::setw(18) << "scene" << std::setw(8) << "accel" << std::setw(10) << "rays"
+			<< std::setw(10) << "mode" << std::setw(12) << "Mrays/s" << std::setw(10) << "hits" << "same hits\n";
+
+		for (const auto& scene : scenes)
+		{
+			BVH4 bvh4(scene.world);
+			BVH8 bvh8(scene.world);
+			auto primary = MakePrimaryRays(scene.eye, scene.lookat, scene.vfov, options.ray_count);
+			auto bounce = MakeBounceRays(bvh8, primary);
+			// 打乱顺序, 相当于各条路径在不同的弹射次数上结束后剩下的射线, 相邻的射线之间没有关联
+			auto shuffled = bounce;
+			{
+				IndependentSampler sampler(3);
+				for (size_t i = shuffled.size(); i > 1; --i)
+				{
+					sampler.StartPixelSample(static_cast<int>(i), 0, 0);
+					std::swap(shuffled[i - 1], shuffled[static_cast<size_t>(sampler.Get1D() * i)]);
+				}
+			}
+
+			struct RaySet
+			{
+				const char* name;
+				const std::vector<Ray>* rays;
+			};
+			struct Accel
+			{
+				const char* name;
+				const hittable* accel;
+			};
+			for (const auto& accel : { Accel{ "BVH4", &bvh4 }, Accel{ "BVH8", &bvh8 } })
+			{
+				for (const auto& set : { RaySet{ "primary", &primary }, RaySet{ "bounce", &bounce }, RaySet{ "shuffled", &shuffled } })
+				{
+					const auto& rays = *set.rays;
+					std::vector<hit_record> reference(rays.size()), recs(rays.size());
+
+					// 取三次中最好的结果减少波动
+					auto measure = [&](auto trace)
+					{
+						double best = 0;
+						size_t hits = 0;
+						for (int repeat = 0; repeat < 3; ++repeat)
+						{
+							auto start = Clock::now();
+							hits = trace();
+							best = std::max(best, rays.size() / SecondsSince(start));
+						}
+						return std::make_pair(best, hits);
+					};
+					auto report = [&](const char* mode, std::pair<double, size_t> result, const char* same)
+					{
+						std::clog << std::left << std::setw(18) << scene.name << std::setw(8) << accel.name
+							<< std::setw(10) << set.name << std::setw(10) << mode << std::setw(12) << result.first / 1e6
+							<< std::setw(10) << result.second << same << '\n';
+					};
+
+					report("single", measure([&]
+						{
+							size_t hits = 0;
+							for (size_t i = 0; i < rays.size(); ++i)
+							{
+								reference[i] = hit_record();
+								hits += accel.accel->hit(rays[i], interval(0.001, infinity), reference[i]);
+							}
+							return hits;
+						}), "-");
+
+					for (bool sorted : { false, true })
+					{
+						RayStream stream(sorted);
+						auto result = measure([&]
+							{ return stream.Intersect(*accel.accel, rays.data(), rays.size(), interval(0.001, infinity), recs.data()); });
+
+						bool same = true;
+						for (size_t i = 0; i < rays.size() && same; ++i)
+							same = recs[i].object == reference[i].object && (!recs[i].object || recs[i].t == reference[i].t);
+						report(sorted ? "stream" : "packet", result, same ? "yes" : "NO");
+					}
+				}
+			}
+		}
+
+		std::clog << '\n' << std::left << std::setw(18) << "camera rays" << std::setw(12) << "render(s)"
+			<< std::setw(12) << "Mrays/s" << "same image\n";
+		auto world = RandomSpheresWorld();
+		hittable_list bvh(make_shared<BVH8>(world));
+		Framebuffer reference;
+		for (bool packets : { false, true })
+		{
+			double best = infinity;
+			Framebuffer image;
+			RenderStats stats;
+			for (int repeat = 0; repeat < 3; ++repeat)
+			{
+				auto camera = RandomSpheresCamera(imageWidth, samplesPerPixel);
+				camera.seed = 1;
+				camera.packet_primary = packets;
+				auto start = Clock::now();
+				image = camera.RenderFramebuffer(bvh);
+				best = std::min(best, SecondsSince(start));
+				stats = camera.Stats();
+			}
+
+			const char* same = "-";
+			if (packets)
+				same = ImageRMSE(image, reference) == 0 ? "yes" : "NO";
+			else
+				reference = std::move(image);
+			std::clog << std::left << std::setw(18) << (packets ? "packet" : "single") << std::setw(12) << best
+				<< std::setw(12) << stats.bounces / best / 1e6 << same << '\n';
+		}
+	}
+	// 逐条路径深度优先与 wavefront 引擎的整幅渲染对比, 单线程以免线程调度的波动
+	// wavefront 一批的路径数为 tile 的像素数乘以每像素样本数
+	void BenchmarkWavefront(const BenchmarkOptions&)
+	{
+		struct WavefrontScene
+		{
+			std::string name;
+			hittable_list world;
+			std::function<Camera(int imageWidth)> makeCamera;
+			std::vector<int> widths;
+		};
+		std::vector<WavefrontScene> scenes;
+		scenes.push_back({ "RandomSpheres", hittable_list(make_shared<BVH8>(RandomSpheresWorld())),
+			[](int imageWidth) { return RandomSpheresCamera(imageWidth, 8); }, { 200, 800 } });
+		// 网格和实例的 BVH 远大于缓存, 射线的访问顺序影响更大; 找不到模型时跳过
+		auto skullField = SkullFieldWorld(100);
+		if (!skullField.objects.empty())
+			scenes.push_back({ "SkullField100", hittable_list(make_shared<BVH8>(skullField)),
+				[](int imageWidth)
+				{
+					auto camera = RandomSpheresCamera(imageWidth, 2);
+					camera.vfov = 40;
+					camera.lookfrom = point3(-615, 20, -615);
+					camera.lookat = point3(-560, 2, -560);
+					camera.defocus_angle = 0;
+					return camera;
+				}, { 400 } });
+
+		struct Engine
+		{
+			const char* name;
+			bool wavefront;
+			bool sorted;
+			bool packets;
+			int tileSize;
+		};
+		const Engine engines[] = {
+			{ "depth-first", false, false, false, 16 },
+			{ "wavefront", true, false, false, 16 },
+			{ "wavefront", true, false, false, 64 },
+			{ "wave+sort", true, true, false, 16 },
+			{ "wave+sort", true, true, false, 64 },
+			{ "wave+sort+packet", true, true, true, 64 },
+		};
+
+		std::clog << std::left << std::setw(16) << "scene" << std::setw(8) << "width" << std::setw(18) << "engine"
+			<< std::setw(6) << "tile" << std::setw(12) << "render(s)" << std::setw(12) << "Mrays/s" << "same image\n";
+
+		for (const auto& scene : scenes)
+		{
+			for (int imageWidth : scene.widths)
+			{
+				Framebuffer reference;
+				for (const auto& engine : engines)
+				{
+					double best = infinity;
+					Framebuffer image;
+					RenderStats stats;
+					for (int repeat = 0; repeat < 2; ++repeat)
+					{
+						auto camera = scene.makeCamera(imageWidth);
+						camera.seed = 1;
+						camera.thread_count = 1;
+						camera.tile_size = engine.tileSize;
+						camera.wavefront = engine.wavefront;
+						camera.wavefront_sort = engine.sorted;
+						camera.packet_primary = engine.packets;
+						auto start = Clock::now();
+						image = camera.RenderFramebuffer(scene.world);
+						best = std::min(best, SecondsSince(start));
+						stats = camera.Stats();
+					}
+
+					const char* same = "-";
+					if (engine.wavefront)
+						same = ImageRMSE(image, reference) == 0 ? "yes" : "NO";
+					else
+						reference = std::move(image);
+					std::clog << std::left << std::setw(16) << scene.name << std::setw(8) << imageWidth
+						<< std::setw(18) << engine.name << std::setw(6) << engine.tileSize << std::setw(12) << best
+						<< std::setw(12) << stats.bounces / best / 1e6 << same << '\n';
+				}
+			}
+		}
+	}
+	// 记录 rays 在 world 中的交点, 只保留命中的射线
+	void RecordHits(const hittable& world, const std::vector<Ray>& rays, std::vector<Ray>& hitRays, std::vector<hit_record>& recs)
+	{
+		hitRays.clear();
+		recs.clear();
+		for (const auto& r : rays)
+		{
+			hit_record rec;
+			if (!world.hit(r, interval(0.001, infinity), rec))
+				continue;
+			rec.object->FinalizeHit(r, rec);
+			hitRays.push_back(r);
+			recs.push_back(rec);
+		}
+	}
+
+	// 对记录下的交点反复调用 ScatterMaterial(), 返回每个交点的纳秒数
+	// checksum 累加散射结果, 两种材质的结果逐位相同时 checksum 也相同
+	double TimeScatter(const std::vector<Ray>& rays, const std::vector<hit_record>& recs,
+		const std::vector<uint32_t>& order, int repeats, double& checksum)
+	{
+		IndependentSampler sampler(3);
+		checksum = 0;
+		auto start = Clock::now();
+		for (int repeat = 0; repeat < repeats; ++repeat)
+		{
+			sampler.StartPixelSample(repeat, 0, 0);
+			for (uint32_t k : order)
+			{
+				color attenuation;
+				Ray scattered;
+				if (ScatterMaterial(*recs[k].mat, rays[k], recs[k], attenuation, scattered, sampler))
+					checksum += attenuation.x() + attenuation.y() + attenuation.z() + scattered.GetDirection().x();
+			}
+		}
+		return SecondsSince(start) * 1e9 / (static_cast<double>(order.size()) * repeats);
+	}
+
+	// 材质的虚函数 (open) 与 std::variant 分派 (closed) 的着色开销: 只计 Scatter 和纹理取值, 不含求交
+	// 交点按射线顺序时材质类型随机交错, 按材质类型排序则相当于 wavefront 的着色队列
+	// 最后是整幅渲染, 两种材质的图像应当逐位相同
+	void BenchmarkVariant(const BenchmarkOptions& options)
+	{
+		auto spheres = RandomSpheresWorld();
+		BVH8 world(spheres);
+		auto rays = MakePrimaryRays(point3(13, 2, 3), point3(0, 0, 0), 20, options.ray_count / 2);
+		auto bounced = MakeBounceRays(world, rays);
+		rays.insert(rays.end(), bounced.begin(), bounced.end());
+
+		struct Path
+		{
+			const char* name;
+			std::vector<Ray> rays;
+			std::vector<hit_record> recs;
+			double nsPerHit[2] = { infinity, infinity };
+			double checksum[2] = {};
+			double renderSeconds = 0;
+			Framebuffer image;
+		};
+		Path paths[2];
+		paths[0].name = "open";
+		paths[1].name = "closed";
+		std::vector<shared_ptr<Material>> openMaterials;
+
+		for (int closed = 0; closed < 2; ++closed)
+		{
+			// 图元的材质原地替换, BVH 不用重建; 原来的材质要保留到计时结束, open 的交点还指向它们
+			if (closed)
+			{
+				for (const auto& object : spheres.objects)
+				{
+					if (auto ball = std::dynamic_pointer_cast<sphere>(object))
+						openMaterials.push_back(ball->GetMaterial());
+				}
+				auto library = MaterialLibrary::Close(spheres);
+				std::clog << "closed world: " << library->MaterialCount() << " materials, "
+					<< library->TextureCount() << " textures\n";
+			}
+			auto& path = paths[closed];
+			RecordHits(world, rays, path.rays, path.recs);
+
+			auto camera = RandomSpheresCamera(400, 16);
+			camera.seed = 1;
+			camera.thread_count = 1;
+			auto start = Clock::now();
+			path.image = camera.RenderFramebuffer(world);
+			path.renderSeconds = SecondsSince(start);
+		}
+
+		// 两组交点相同, 只有材质指针不同; 按 open 的材质类型排序, 两种材质使用同一个顺序
+		const auto& openRecs = paths[0].recs;
+		std::vector<uint32_t> rayOrder(openRecs.size());
+		for (size_t k = 0; k < rayOrder.size(); ++k)
+			rayOrder[k] = static_cast<uint32_t>(k);
+		std::vector<uint32_t> classOrder = rayOrder;
+		auto kind = [&](uint32_t k)
+		{
+			const Material* mat = openRecs[k].mat;
+			if (dynamic_cast<const Lambertian*>(mat))
+				return 0;
+			return dynamic_cast<const Metal*>(mat) ? 1 : 2;
+		};
+		std::stable_sort(classOrder.begin(), classOrder.end(), [&](uint32_t a, uint32_t b) { return kind(a) < kind(b); });
+
+		// 两种材质交替计时, 取最好的一次
+		const int repeats = 5;
+		for (int trial = 0; trial < 5; ++trial)
+		{
+			for (auto& path : paths)
+			{
+				path.nsPerHit[0] = std::min(path.nsPerHit[0], TimeScatter(path.rays, path.recs, rayOrder, repeats, path.checksum[0]));
+				path.nsPerHit[1] = std::min(path.nsPerHit[1], TimeScatter(path.rays, path.recs, classOrder, repeats, path.checksum[1]));
+			}
+		}
+
+		std::clog << openRecs.size() << " hits\n";
+		std::clog << std::left << std::setw(10) << "material" << std::setw(20) << "ns/hit (ray order)"
+			<< std::setw(22) << "ns/hit (class order)" << std::setw(12) << "render(s)" << "same result\n";
+		for (const auto& path : paths)
+		{
+			const char* same = "-";
+			if (&path != &paths[0])
+			{
+				bool equal = path.checksum[0] == paths[0].checksum[0] && path.checksum[1] == paths[0].checksum[1]
+					&& ImageRMSE(path.image, paths[0].image) == 0;
+				same = equal ? "yes" : "NO";
+			}
+			std::clog << std::left << std::setw(10) << path.name << std::setw(20) << path.nsPerHit[0]
+				<< std::setw(22) << path.nsPerHit[1] << std::setw(12) << path.renderSeconds << same << '\n';
+		}
+	}
+	// 平均亮度, 用来看自相交造成的偏差: 误判的交点让路径提前变暗, 整幅图偏暗
+	double MeanLuminance(const Framebuffer& image)
+	{
+		double sum = 0;
+		for (int y = 0; y < image.Height(); ++y)
+			for (int x = 0; x < image.Width(); ++x)
+				sum += Luminance(image.GetPixel(x, y));
+		return sum / (static_cast<double>(image.Width()) * image.Height());
+	}
+
+	// double 与 float 两种构建的精度和速度, 每种构建各运行一次, 结果写在当前目录:
+	// 参考图像只由 double 构建按高采样数渲染, 文件名记下宽高和采样数, 参数改变后不会误用旧的参考图像;
+	// float 构建找不到对应的参考图像时只报告时间, 需要先运行一次 double 构建
+	// 每个场景分别用固定的 0.001 epsilon 和按误差范围偏移 (robust) 两种方式避免自相交
+	// "far" 把同一个场景平移到远离原点的地方, float 的 ulp 接近 0.001, epsilon 不再够用
+	void BenchmarkPrecision(const BenchmarkOptions&)
+	{
+		struct PrecisionScene
+		{
+			std::string name;
+			hittable_list world;
+			Camera camera;
+		};
+		const int imageWidth = 160;
+		const int referenceSpp = 256;
+		const int spp = 32;
+		const vec3 far(10000, 0, 10000);
+
+		std::vector<PrecisionScene> scenes;
+		auto spheres = make_shared<BVH8>(RandomSpheresWorld());
+		scenes.push_back({ "spheres", hittable_list(spheres), RandomSpheresCamera(imageWidth, spp) });
+		auto farCamera = RandomSpheresCamera(imageWidth, spp);
+		farCamera.lookfrom = farCamera.lookfrom + far;
+		farCamera.lookat = farCamera.lookat + far;
+		scenes.push_back({ "spheres far", hittable_list(make_shared<instance>(spheres, Transform::Translate(far))), farCamera });
+		auto skullWorld = SkullWorld();
+		if (!skullWorld.objects.empty())
+		{
+			auto skull = make_shared<BVH8>(skullWorld);
+			scenes.push_back({ "skull", hittable_list(skull), MeshCamera(skull->BoundingBox(), imageWidth, spp) });
+		}
+
+#ifdef RT_FLOAT
+		const char* build = "float";
+#else
+		const char* build = "double";
+#endif
+		std::clog << build << " build: sizeof(vec3) = " << sizeof(vec3) << ", sizeof(hit_record) = " << sizeof(hit_record)
+			<< ", sizeof(Ray) = " << sizeof(Ray) << '\n';
+		std::clog << std::left << std::setw(14) << "scene" << std::setw(10) << "offsets" << std::setw(12) << "render(s)"
+			<< std::setw(12) << "Mrays/s" << std::setw(14) << "mean/ref" << "RMSE\n";
+
+		for (auto& scene : scenes)
+		{
+			scene.camera.seed = 1;
+			scene.camera.thread_count = 1;
+
+			// 与 Camera::Initialize() 相同的图像高度
+			int width = scene.camera.image_width;
+			int height = std::max(1, static_cast<int>(width / scene.camera.aspect_ratio));
+			std::ostringstream name;
+			name << "precision_" << scene.name << '_' << width << 'x' << height << '_' << referenceSpp << "spp.pfm";
+			std::string fileName = name.str();
+			std::replace(fileName.begin(), fileName.end(), ' ', '_');
+
+			Framebuffer reference;
+			std::ifstream in(fileName, std::ios::binary);
+			bool haveReference = reference.ReadPFM(in) && reference.Width() == width && reference.Height() == height;
+			if (!haveReference && std::is_same<Real, double>::value)
+			{
+				auto camera = scene.camera;
+				camera.samples_per_pixel = referenceSpp;
+				camera.seed = 2;
+				camera.robust_offsets = true;
+				reference = camera.RenderFramebuffer(scene.world);
+				std::ofstream out(fileName, std::ios::binary);
+				reference.WritePFM(out);
+				haveReference = true;
+				std::clog << "wrote reference " << fileName << '\n';
+			}
+			else if (!haveReference)
+			{
+				std::clog << "no reference " << fileName << ", run the double build first\n";
+			}
+			double referenceMean = haveReference ? MeanLuminance(reference) : 0;
+
+			for (bool robust : { false, true })
+			{
+				double best = infinity;
+				Framebuffer image;
+				RenderStats stats;
+				for (int repeat = 0; repeat < 3; ++repeat)
+				{
+					auto camera = scene.camera;
+					camera.robust_offsets = robust;
+					auto start = Clock::now();
+					image = camera.RenderFramebuffer(scene.world);
+					best = std::min(best, SecondsSince(start));
+					stats = camera.Stats();
+				}
+				std::clog << std::left << std::setw(14) << scene.name << std::setw(10) << (robust ? "robust" : "epsilon")
+					<< std::setw(12) << best << std::setw(12) << stats.bounces / best / 1e6;
+				if (haveReference)
+					std::clog << std::setw(14) << MeanLuminance(image) / referenceMean << ImageRMSE(image, reference) << '\n';
+				else
+					std::clog << std::setw(14) << "-" << "-\n";
+			}
+		}
+	}
+}
+
+bool RunBenchmark(const std::string& name, const BenchmarkOptions& options)
+{
+	if (name == "bvh")
+		BenchmarkBVH(options);
+	else if (name == "leaf")
+		BenchmarkLeaf(options);
+	else if (name == "build")
+		BenchmarkBuild(options);
+	else if (name == "wide")
+		BenchmarkWide(options);
+	else if (name == "box")
+		BenchmarkBox(options);
+	else if (name == "material")
+		BenchmarkMaterial(options);
+	else if (name == "surface")
+		BenchmarkSurface(options);
+	else if (name == "roulette")
+		BenchmarkRoulette(options);
+	else if (name == "output")
+		BenchmarkOutput(options);
+	else if (name == "adaptive")
+		BenchmarkAdaptive(options);
+	else if (name == "sampler")
+		BenchmarkSampler(options);
+	else if (name == "mesh")
+		BenchmarkMesh(options);
+	else if (name == "instance")
+		BenchmarkInstance(options);
+	else if (name == "tlas")
+		BenchmarkTLAS(options);
+	else if (name == "refit")
+		BenchmarkRefit(options);
+	else if (name == "motion")
+		BenchmarkMotion(options);
+	else if (name == "sphereset")
+		BenchmarkSphereSet(options);
+	else if (name == "packet")
+		BenchmarkPacket(options);
+	else if (name == "wavefront")
+		BenchmarkWavefront(options);
+	else if (name == "variant")
+		BenchmarkVariant(options);
+	else if (name == "precision")
+		BenchmarkPrecision(options);
+	else
+		return false;
+
+	return true;
+}
@@ -0,0 +1,16 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <string>
+
+struct BenchmarkOptions
+{
+	size_t primitive_count = 1000000;	// 大规模场景的图元数
+	size_t ray_count = 1000000;			// 每项测试发射的射线数
+};
+
+// 运行名为 name 的基准测试, 结果输出到 std::clog
+// 返回 false 表示没有这个测试
+bool RunBenchmark(const std::string& name, const BenchmarkOptions& options);
+
+#endif // !BENCHMARK_H
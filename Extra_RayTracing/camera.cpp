@@ -1,25 +1,340 @@
 #include "camera.h"
+#include "material_variant.h"
+#include "Common/ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+
+#ifdef _MSC_VER
+#include <fcntl.h>
+#include <io.h>
+#endif
 
 void Camera::Render(const hittable& world)
+{
+	auto framebuffer = RenderFramebuffer(world);
+
+	bool written;
+	if (output_path.empty()) {
+#ifdef _MSC_VER
+		// P6 is binary, keep the CRT from expanding '\n'.
+		_setmode(_fileno(stdout), _O_BINARY);
+#endif
+		written = framebuffer.WritePPM(std::cout);
+	}
+	else {
+		written = framebuffer.Write(output_path);
+	}
+
+	if (written)
+		std::clog << "\rDone.                 \n";
+	else
+		std::cerr << "\nERROR: Could not write image '" << output_path << "'.\n";
+}
+
+Framebuffer Camera::RenderFramebuffer(const hittable& world)
 {
 	Initialize();
 
-	std::cout << "P3\n" << image_width << ' ' << image_height << "\n255\n";
+	accumulation.assign(static_cast<size_t>(image_width) * image_height, PixelAccumulator());
+	stats = RenderStats();
+
+	scene_key = SceneKey(world);
+	if (!checkpoint_path.empty() && LoadCheckpoint() && show_progress)
+		std::clog << "Resuming from " << TotalSamples() << " samples\n";
+
+	ThreadPool pool(thread_count);
+	if (show_progress)
+		std::clog << "Rendering on " << pool.Size() << " threads\n";
+
+	int pass_size = pass_samples > 0 ? pass_samples : (adaptive_sampling ? adaptive_min_samples : samples_per_pixel);
+	size_t budget = accumulation.size() * samples_per_pixel;
+	auto last_checkpoint = std::chrono::steady_clock::now();
+
+	for (int pass = 1; TotalSamples() < budget; ++pass) {
+		if (RenderPass(world, pool, pass, pass_size) == 0)
+			break;
+
+		if (checkpoint_path.empty())
+			continue;
+
+		bool finished = TotalSamples() >= budget;
+		auto now = std::chrono::steady_clock::now();
+		if (finished || std::chrono::duration<double>(now - last_checkpoint).count() >= checkpoint_interval) {
+			if (!SaveCheckpoint())
+				std::cerr << "\nERROR: Could not write checkpoint '" << checkpoint_path << "'.\n";
+			// Keep a preview of the current quality next to the checkpoint.
+			if (!finished && !output_path.empty())
+				Resolve().Write(output_path);
+			last_checkpoint = now;
+		}
+	}
+
+	// An adaptive render that converged early never reaches the budget, save where it stopped.
+	if (!checkpoint_path.empty() && TotalSamples() < budget && !SaveCheckpoint())
+		std::cerr << "\nERROR: Could not write checkpoint '" << checkpoint_path << "'.\n";
+
+	return Resolve();
+}
+
+size_t Camera::RenderPass(const hittable& world, ThreadPool& pool, int pass, int pass_size)
+{
+	int tilesX = (image_width + tile_size - 1) / tile_size;
+	int tilesY = (image_height + tile_size - 1) / tile_size;
+	int tilesRemaining = tilesX * tilesY;
+	size_t pass_samples_taken = 0;
+	std::mutex progressMutex;
+
+	for (int ty = 0; ty < tilesY; ++ty) {
+		for (int tx = 0; tx < tilesX; ++tx) {
+			pool.Submit([&, tx, ty] {
+				auto tileStats = RenderTile(world, tx * tile_size, ty * tile_size, pass_size);
+
+				std::lock_guard<std::mutex> lock(progressMutex);
+				stats.samples += tileStats.samples;
+				stats.bounces += tileStats.bounces;
+				pass_samples_taken += tileStats.samples;
+				--tilesRemaining;
+				if (show_progress)
+					std::clog << "\rPass " << pass << ", tiles remaining: " << tilesRemaining << ' ' << std::flush;
+			});
+		}
+	}
+	pool.Wait();
+
+	return pass_samples_taken;
+}
+
+RenderStats Camera::RenderTile(const hittable& world, int x0, int y0, int pass_size)
+{
+	RenderStats tileStats;
+	int x1 = std::min(x0 + tile_size, image_width);
+	int y1 = std::min(y0 + tile_size, image_height);
+
+	if (adaptive_sampling && TileConverged(x0, y0, x1, y1))
+		return tileStats;
+
+	int max_samples = adaptive_sampling ? std::max(samples_per_pixel * adaptive_max_scale, adaptive_min_samples)
+	                                    : samples_per_pixel;
+
+	auto sampler = MakeSampler(sampler_type, seed,
+	                           adaptive_sampling ? samples_per_pixel * adaptive_max_scale : samples_per_pixel);
+	if (wavefront)
+		return RenderTileWavefront(world, x0, y0, x1, y1, max_samples, pass_size, *sampler);
+
+	// Camera rays of consecutive samples wait here until a packet is full.
+	struct PendingSample {
+		PixelAccumulator* pixel;
+		int i, j, sample;
+	};
+	PendingSample pending[RayPacket::kSize];
+	RayPacket packet;
+	interval packet_t[RayPacket::kSize];
+	hit_record packet_recs[RayPacket::kSize];
+
+	auto add_sample = [&](PixelAccumulator& pixel, const color& sample_color) {
+		auto luminance = Luminance(sample_color);
+		pixel.sum += Vec3<double>(sample_color);
+		pixel.luminance_sq_sum += luminance * luminance;
+	};
+
+	auto flush = [&] {
+		if (packet.count == 0)
+			return;
+		for (int k = 0; k < packet.count; ++k) {
+			packet_t[k] = HitInterval();
+			packet_recs[k] = hit_record();
+		}
+		world.HitPacket(packet, packet_t, packet_recs, packet.Mask());
+
+		// Shade in the order the samples were taken, the sums come out bit for bit the same.
+		// Bounces start from their own streams, so restarting the sample leaves the path unchanged.
+		for (int k = 0; k < packet.count; ++k) {
+			const auto& s = pending[k];
+			sampler->StartPixelSample(s.i, s.j, s.sample);
+			add_sample(*s.pixel, RayColor(packet.rays[k], world, *sampler, tileStats.bounces, &packet_recs[k]));
+		}
+		packet.Clear();
+	};
+
+	for (int j = y0; j < y1; ++j) {
+		for (int i = x0; i < x1; ++i) {
+			auto& pixel = accumulation[static_cast<size_t>(j) * image_width + i];
+			int sample_end = std::min(pixel.samples + pass_size, max_samples);
+
+			// Samples are added one at a time, so the sum is the same however the render is split into passes.
+			for (int sample = pixel.samples; sample < sample_end; ++sample) {
+				// Each sample has its own stream, so the image does not depend on which thread renders the tile.
+				sampler->StartPixelSample(i, j, sample);
+				Ray r = GetRay(i, j, *sampler);
+				if (!packet_primary) {
+					add_sample(pixel, RayColor(r, world, *sampler, tileStats.bounces));
+					continue;
+				}
+
+				pending[packet.Add(r)] = { &pixel, i, j, sample };
+				if (packet.count == RayPacket::kSize)
+					flush();
+			}
+			tileStats.samples += std::max(sample_end - pixel.samples, 0);
+			pixel.samples = std::max(sample_end, pixel.samples);
+		}
+	}
+	flush();
+	return tileStats;
+}
+
+bool Camera::TileConverged(int x0, int y0, int x1, int y1) const
+{
+	// The variance of a single pixel estimated from a handful of samples is itself very noisy,
+	// a pixel that saw no rare bright path would stop far too early. Pooling the whole tile
+	// gives a stable estimate: the RMS of the per-pixel standard errors of the luminance.
+	double sum = 0;
+	for (int j = y0; j < y1; ++j) {
+		for (int i = x0; i < x1; ++i) {
+			const auto& pixel = accumulation[static_cast<size_t>(j) * image_width + i];
+			int n = pixel.samples;
+			if (n < std::max(adaptive_min_samples, 2))
+				return false;
+
+			auto mean = Luminance(pixel.sum) / n;
+			auto variance = std::max((pixel.luminance_sq_sum - mean * mean * n) / (n - 1), 0.0);
+			sum += variance / n;
+		}
+	}
+	return std::sqrt(sum / ((x1 - x0) * (y1 - y0))) <= adaptive_error;
+}
+
+size_t Camera::TotalSamples() const
+{
+	size_t total = 0;
+	for (const auto& pixel : accumulation)
+		total += pixel.samples;
+	return total;
+}
 
+Framebuffer Camera::Resolve() const
+{
+	Framebuffer framebuffer(image_width, image_height);
 	for (int j = 0; j < image_height; ++j) {
-		std::clog << "\rScanlines remaining: " << (image_height - j) << ' ' << std::flush;
 		for (int i = 0; i < image_width; ++i) {
-			color pixel_color(0, 0, 0);
-			for (int sample = 0; sample < samples_per_pixel; ++sample) {
-				Ray r = GetRay(i, j);
-				pixel_color += RayColor(r, max_depth, world);
-			}
-			write_color(std::cout, pixel_color, samples_per_pixel);
+			const auto& pixel = accumulation[static_cast<size_t>(j) * image_width + i];
+			if (pixel.samples > 0)
+				framebuffer.SetPixel(i, j, color(pixel.sum / pixel.samples));
+		}
+	}
+	return framebuffer;
+}
+
+namespace {
+	// Checkpoint layout: header, then one PixelAccumulator per pixel.
+	// Sample streams are keyed by (seed, pixel, sample index), so the seed and the per-pixel
+	// sample counts are the whole RNG state needed to continue.
+	struct CheckpointHeader {
+		char     magic[4] = { 'R', 'T', 'C', 'P' };
+		uint32_t version = 2;
+		int32_t  width = 0;
+		int32_t  height = 0;
+		uint32_t seed = 0;
+		uint64_t scene_key = 0;
+	};
+}
+
+uint64_t Camera::SceneKey(const hittable& world) const
+{
+	uint64_t key = 0;
+	auto mix = [&key](double value) {
+		uint64_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		key = MixBits(key ^ bits);
+	};
+
+	auto bounds = world.BoundingBox();
+	for (int a = 0; a < 3; ++a) {
+		mix(bounds.axis(a).min);
+		mix(bounds.axis(a).max);
+		mix(lookfrom[a]);
+		mix(lookat[a]);
+		mix(vup[a]);
+	}
+	for (double value : { aspect_ratio, vfov, defocus_angle, focus_dist })
+		mix(value);
+	mix(max_depth);
+	// Stratified patterns depend on the planned sample count, resuming with another count breaks them.
+	mix(static_cast<int>(sampler_type));
+	if (sampler_type == SamplerType::Stratified)
+		mix(adaptive_sampling ? samples_per_pixel * adaptive_max_scale : samples_per_pixel);
+	mix(russian_roulette ? rr_min_depth : -1);
+	mix(robust_offsets ? 1 : 0);
+	// A checkpoint from the double build must not resume in the float build, or the other way round.
+	mix(sizeof(Real));
+	return key;
+}
+
+bool Camera::SaveCheckpoint() const
+{
+	// Write next to the old checkpoint and swap, a crash mid-write keeps the previous one.
+	std::string temp_path = checkpoint_path + ".tmp";
+	{
+		std::ofstream out(temp_path, std::ios::binary);
+		if (!out)
+			return false;
+
+		CheckpointHeader header;
+		header.width = image_width;
+		header.height = image_height;
+		header.seed = seed;
+		header.scene_key = scene_key;
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		for (const auto& pixel : accumulation) {
+			int32_t samples = pixel.samples;
+			out.write(reinterpret_cast<const char*>(pixel.sum.e), sizeof(pixel.sum.e));
+			out.write(reinterpret_cast<const char*>(&pixel.luminance_sq_sum), sizeof(pixel.luminance_sq_sum));
+			out.write(reinterpret_cast<const char*>(&samples), sizeof(samples));
 		}
+		if (!out)
+			return false;
 	}
 
-	std::clog << "\rDone.                 \n";
+	std::remove(checkpoint_path.c_str());
+	return std::rename(temp_path.c_str(), checkpoint_path.c_str()) == 0;
 }
+
+bool Camera::LoadCheckpoint()
+{
+	std::ifstream in(checkpoint_path, std::ios::binary);
+	if (!in)
+		return false;
+
+	CheckpointHeader expected, header;
+	in.read(reinterpret_cast<char*>(&header), sizeof(header));
+	if (!in || std::memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0 || header.version != expected.version)
+		return false;
+	if (header.width != image_width || header.height != image_height || header.seed != seed || header.scene_key != scene_key) {
+		std::cerr << "Checkpoint '" << checkpoint_path << "' was rendered with other settings, starting over.\n";
+		return false;
+	}
+
+	std::vector<PixelAccumulator> pixels(accumulation.size());
+	for (auto& pixel : pixels) {
+		int32_t samples = 0;
+		in.read(reinterpret_cast<char*>(pixel.sum.e), sizeof(pixel.sum.e));
+		in.read(reinterpret_cast<char*>(&pixel.luminance_sq_sum), sizeof(pixel.luminance_sq_sum));
+		in.read(reinterpret_cast<char*>(&samples), sizeof(samples));
+		pixel.samples = samples;
+	}
+	if (!in)
+		return false;
+
+	accumulation = std::move(pixels);
+	return true;
+}
+
 void Camera::Initialize()
 {
 	image_height = static_cast<int>(image_width / aspect_ratio);
@@ -56,60 +371,109 @@ void Camera::Initialize()
 	defocus_disk_v = v * defocus_radius;
 }
 
-Ray Camera::GetRay(int i, int j) const
+Ray Camera::GetRay(int i, int j, Sampler& sampler) const
 {
 	// Get a randomly-sampled camera Ray for the pixel at location i,j, originating from
 		// the camera defocus disk.
 
 	auto pixel_center = pixel00_loc + (i * pixel_delta_u) + (j * pixel_delta_v);
-	auto pixel_sample = pixel_center + PixelSampleSquare();
+	auto pixel_sample = pixel_center + PixelSampleSquare(sampler);
 
-	auto ray_origin = (defocus_angle <= 0) ? center : DefocusDiskSample();
+	// The lens sample is drawn even without defocus, so time always lands on the same dimension.
+	auto lens_sample = DefocusDiskSample(sampler);
+	auto ray_origin = (defocus_angle <= 0) ? center : lens_sample;
 	auto ray_direction = pixel_sample - ray_origin;
-	auto ray_time = random_double();
+	auto ray_time = sampler.Get1D();
 
 	return Ray(ray_origin, ray_direction, ray_time);
 }
 
-vec3 Camera::PixelSampleSquare() const
+vec3 Camera::PixelSampleSquare(Sampler& sampler) const
 {
 	// Returns a random point in the square surrounding a pixel at the origin.
-	auto px = -0.5 + random_double();
-	auto py = -0.5 + random_double();
+	auto px = -0.5 + sampler.Get1D();
+	auto py = -0.5 + sampler.Get1D();
 	return (px * pixel_delta_u) + (py * pixel_delta_v);
 }
 
-vec3 Camera::PixelSampleDisk(double radius) const
+vec3 Camera::PixelSampleDisk(double radius, Sampler& sampler) const
 {
 	// Generate a sample from the disk of given radius around a pixel at the origin.
-	auto p = radius * random_in_unit_disk();
+	auto p = radius * random_in_unit_disk(sampler);
 	return (p[0] * pixel_delta_u) + (p[1] * pixel_delta_v);
 }
 
-point3 Camera::DefocusDiskSample() const
+point3 Camera::DefocusDiskSample(Sampler& sampler) const
 {
 	// Returns a random point in the camera defocus disk.
-	auto p = random_in_unit_disk();
+	auto p = random_in_unit_disk(sampler);
 	return center + (p[0] * defocus_disk_u) + (p[1] * defocus_disk_v);
 }
 
-color Camera::RayColor(const Ray& r, int depth, const hittable& world) const
+color Camera::Background(const Ray& r) const
 {
-	// If we've exceeded the Ray bounce limit, no more light is gathered.
-	if (depth <= 0)
-		return color(0, 0, 0);
+	vec3 unit_direction = unit_vector(r.GetDirection());
+	auto a = 0.5 * (unit_direction.y() + 1.0);
+	return (1.0 - a) * color(1.0, 1.0, 1.0) + a * color(0.5, 0.7, 1.0);
+}
 
-	hit_record rec;
+bool Camera::SurvivesRoulette(color& throughput, int bounce, Sampler& sampler) const
+{
+	// Russian roulette: keep the path with probability q and divide by q, so the
+	// estimate stays unbiased while dim paths stop early.
+	if (russian_roulette && bounce + 1 >= rr_min_depth) {
+		auto q = std::min<Real>(std::max({ throughput.x(), throughput.y(), throughput.z() }), 0.95);
+		if (sampler.Get1D() >= q)
+			return false;
+		throughput /= q;
+	}
+	return true;
+}
+
+Ray Camera::SpawnRay(const hit_record& rec, const Ray& scattered) const
+{
+	if (!robust_offsets)
+		return scattered;
+	return Ray(rec.SpawnOrigin(scattered.GetDirection()), scattered.GetDirection(), scattered.GetTime());
+}
+
+color Camera::RayColor(const Ray& r_in, const hittable& world, Sampler& sampler, size_t& bounces,
+                       const hit_record* first_hit) const
+{
+	// Follow the path iteratively, carrying the product of the attenuations seen so far.
+	Ray r = r_in;
+	color throughput(1, 1, 1);
+
+	for (int bounce = 0; bounce < max_depth; ++bounce) {
+		// Every bounce draws from its own stream.
+		sampler.StartBounce(bounce);
+
+		hit_record rec;
+		bounces++;
+		bool hit;
+		if (bounce == 0 && first_hit) {
+			rec = *first_hit;
+			hit = rec.object != nullptr;
+		}
+		else {
+			hit = world.hit(r, HitInterval(), rec);
+		}
+		if (!hit)
+			return throughput * Background(r);
+		rec.object->FinalizeHit(r, rec);
 
-	if (world.hit(r, interval(0.001, infinity), rec)) {
 		Ray scattered;
 		color attenuation;
-		if (rec.mat->Scatter(r, rec, attenuation, scattered))
-			return attenuation * RayColor(scattered, depth - 1, world);
-		return color(0, 0, 0);
+		if (!ScatterMaterial(*rec.mat, r, rec, attenuation, scattered, sampler))
+			return color(0, 0, 0);
+
+		throughput = throughput * attenuation;
+		r = SpawnRay(rec, scattered);
+
+		if (!SurvivesRoulette(throughput, bounce, sampler))
+			return color(0, 0, 0);
 	}
 
-	vec3 unit_direction = unit_vector(r.GetDirection());
-	auto a = 0.5 * (unit_direction.y() + 1.0);
-	return (1.0 - a) * color(1.0, 1.0, 1.0) + a * color(0.5, 0.7, 1.0);
+	// If we've exceeded the Ray bounce limit, no more light is gathered.
+	return color(0, 0, 0);
 }
@@ -4,16 +4,36 @@
 #include "Common/common.h"
 
 #include "Common/color.h"
+#include "Common/Framebuffer.h"
 #include "hittable.h"
 #include "material.h"
 
+#include <cstdint>
 #include <iostream>
+#include <string>
+#include <vector>
 
 
+// Counters gathered over the last render.
+struct RenderStats {
+    size_t samples = 0;  // Camera rays traced
+    size_t bounces = 0;  // Rays intersected with the world, camera rays included
+};
+
+
+class ThreadPool;
+
 class Camera {
 public:
     void Render(const hittable& world);
 
+    // Renders without writing the image. Each pixel holds the average of its samples.
+    // With a checkpoint_path, resumes from the checkpoint if it matches this camera and
+    // rewrites it as passes finish, so an interrupted render loses at most one interval.
+    Framebuffer RenderFramebuffer(const hittable& world);
+
+    const RenderStats& Stats() const { return stats; }
+
 public:
     double aspect_ratio      = 1.0;  // Ratio of image width over height
     int    image_width       = 100;  // Rendered image width in pixel count
@@ -28,18 +48,105 @@ public:
     double defocus_angle = 0;  // Variation angle of Rays through each pixel
     double focus_dist = 10;    // Distance from camera lookfrom point to plane of perfect focus
 
+    int    thread_count = 0;   // Render threads, 0 uses every hardware thread
+    int    tile_size    = 16;  // Edge length in pixels of a render tile
+    unsigned int seed   = 0;   // Base seed of the per-pixel sample streams
+    SamplerType sampler_type = SamplerType::Independent;  // How sample dimensions are generated
+
+    bool   russian_roulette = true;  // Randomly end paths that carry little energy
+    int    rr_min_depth     = 5;     // Bounces every path takes before roulette starts
+
+    bool   packet_primary = false;  // Trace camera rays in packets of RayPacket::kSize with hittable::HitPacket,
+                                    // with wavefront every bounce is traced in packets
+
+    // Wavefront engine: each bounce of all paths in a tile is traced as one batch, then shaded in
+    // one queue per Material class. The image is the same as the depth-first engine's.
+    bool   wavefront      = false;
+    bool   wavefront_sort = true;   // Sort each batch by ray origin and direction before tracing
+
+    // How scattered rays avoid hitting the surface they leave. Off: they start at the hit point and
+    // ignore hits closer than 0.001. On: they start just outside the floating-point error bounds of the
+    // hit point (hit_record::SpawnOrigin) and take any hit with t > 0. The float build defaults to on,
+    // where a fixed epsilon is no longer safely above the rounding error of large scenes.
+#ifdef RT_FLOAT
+    bool   robust_offsets = true;
+#else
+    bool   robust_offsets = false;
+#endif
+
+    bool   show_progress = true;  // Report tile progress on std::clog
+
+    std::string output_path;  // Image file, its extension picks the format. Empty writes binary PPM to stdout
+
+    int    pass_samples        = 0;   // Samples per pixel added by each progressive pass, 0 renders in one pass
+    std::string checkpoint_path;      // Accumulation buffer is saved here and resumed from
+    double checkpoint_interval = 60;  // Seconds between checkpoints, one is always written after the last pass
+
+    // Adaptive sampling: samples_per_pixel becomes the total budget, averaged over the image.
+    // Every pixel takes adaptive_min_samples, then each tile keeps sampling in passes until
+    // its error drops below adaptive_error or it reaches adaptive_max_scale * samples_per_pixel.
+    bool   adaptive_sampling    = false;
+    double adaptive_error       = 0.02;   // Target RMS standard error of pixel luminance in a tile
+    int    adaptive_min_samples = 16;     // Samples every pixel takes before its error is trusted
+    int    adaptive_max_scale   = 8;      // Cap on samples of one pixel, in multiples of samples_per_pixel
+
 private:
     void Initialize();
 
-    Ray GetRay(int i, int j) const;
+    // Running sums of one pixel.
+    struct PixelAccumulator {
+        Vec3<double> sum = Vec3<double>(0, 0, 0);  // Double even in the float build, so long renders don't lose samples
+        double luminance_sq_sum = 0;  // For the variance estimate of adaptive sampling
+        int    samples = 0;
+    };
+
+    // The t range searched for the next hit, and the ray that continues the path from rec.
+    interval HitInterval() const { return interval(robust_offsets ? 0 : 0.001, infinity); }
+    Ray SpawnRay(const hit_record& rec, const Ray& scattered) const;
+
+    // Returns the number of samples taken, 0 once every pixel is done.
+    size_t RenderPass(const hittable& world, ThreadPool& pool, int pass, int pass_size);
 
-    vec3 PixelSampleSquare() const;
+    RenderStats RenderTile(const hittable& world, int x0, int y0, int pass_size);
 
-    vec3 PixelSampleDisk(double radius) const;
+    // Runs the samples RenderTile would take through the generate, extend, shade and connect
+    // stages of the wavefront engine. Defined in camera_wavefront.cpp.
+    RenderStats RenderTileWavefront(const hittable& world, int x0, int y0, int x1, int y1,
+                                    int max_samples, int pass_size, Sampler& sampler);
 
-    point3 DefocusDiskSample() const;
+    // Whether the tile has reached adaptive_error and can stop sampling.
+    bool TileConverged(int x0, int y0, int x1, int y1) const;
 
-    color RayColor(const Ray& r, int depth, const hittable& world) const;
+    size_t TotalSamples() const;
+
+    Framebuffer Resolve() const;
+
+    // Hash of the camera settings and the world bounds, guards against resuming another scene.
+    uint64_t SceneKey(const hittable& world) const;
+
+    bool SaveCheckpoint() const;
+
+    bool LoadCheckpoint();
+
+    Ray GetRay(int i, int j, Sampler& sampler) const;
+
+    vec3 PixelSampleSquare(Sampler& sampler) const;
+
+    vec3 PixelSampleDisk(double radius, Sampler& sampler) const;
+
+    point3 DefocusDiskSample(Sampler& sampler) const;
+
+    // Radiance of the sky seen along r.
+    color Background(const Ray& r) const;
+
+    // Applies Russian roulette after the scatter of the given bounce. Returns false when the path
+    // ends, otherwise rescales throughput.
+    bool SurvivesRoulette(color& throughput, int bounce, Sampler& sampler) const;
+
+    // Without first_hit, the camera ray is traced here. Otherwise it holds the camera ray's
+    // intersection found by a packet trace, with object == nullptr when the ray missed.
+    color RayColor(const Ray& r, const hittable& world, Sampler& sampler, size_t& bounces,
+                   const hit_record* first_hit = nullptr) const;
 
 private:
     int    image_height;    // Rendered image height
@@ -50,6 +157,11 @@ private:
     vec3   u, v, w;         // Camera frame basis vectors
     vec3   defocus_disk_u;  // Defocus disk horizontal radius
     vec3   defocus_disk_v;  // Defocus disk vertical radius
+
+    std::vector<PixelAccumulator> accumulation;
+    uint64_t scene_key  = 0;          // SceneKey() of the current render
+
+    RenderStats stats;
 };
 
 
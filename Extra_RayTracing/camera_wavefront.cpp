@@ -0,0 +1,137 @@
+#include "camera.h"
+#include "RayStream.h"
+#include "material_variant.h"
+
+#include <algorithm>
+#include <typeindex>
+#include <typeinfo>
+
+// The wavefront engine keeps every path of a tile in flight at once and advances them one
+// bounce at a time through four stages that only talk through queues:
+//   generate  one camera ray per sample,
+//   extend    intersect all live rays as one sorted batch,
+//   shade     run Material::Scatter over one queue per Material class, so the same code stays hot
+//             (closed materials are queued by the alternative their variant holds),
+//   connect   add finished paths to their pixel and compact the survivors into the next batch.
+// Bounce b of a path draws from the sampler stream of bounce b just like RayColor, so every
+// path, and with it the image, comes out bit for bit the same as the depth-first engine.
+
+namespace {
+	// Hits whose material is of one class, as indices into the current batch.
+	struct ShadeQueue {
+		std::type_index type;
+		std::vector<uint32_t> items;
+	};
+
+	std::vector<uint32_t>& QueueFor(std::vector<ShadeQueue>& queues, const std::type_index& type) {
+		for (auto& queue : queues) {
+			if (queue.type == type)
+				return queue.items;
+		}
+		queues.push_back({ type, {} });
+		return queues.back().items;
+	}
+
+	std::type_index ShadeClass(const Material& mat) {
+		if (!mat.IsClosed())
+			return typeid(mat);
+		return std::visit([](const auto& value) { return std::type_index(typeid(value)); },
+		                  static_cast<const ClosedMaterial&>(mat).Value());
+	}
+}
+
+RenderStats Camera::RenderTileWavefront(const hittable& world, int x0, int y0, int x1, int y1,
+                                        int max_samples, int pass_size, Sampler& sampler)
+{
+	RenderStats tileStats;
+
+	struct Path {
+		PixelAccumulator* pixel;
+		int i, j, sample;
+		color throughput;
+		color radiance;  // Stays black unless the path escapes to the sky
+	};
+	std::vector<Path> paths;
+	std::vector<Ray> rays;          // Live rays of the current bounce
+	std::vector<uint32_t> live;     // Path of each ray in rays
+
+	// Generate: paths are stored in the order their samples are accumulated.
+	for (int j = y0; j < y1; ++j) {
+		for (int i = x0; i < x1; ++i) {
+			auto& pixel = accumulation[static_cast<size_t>(j) * image_width + i];
+			int sample_end = std::min(pixel.samples + pass_size, max_samples);
+
+			for (int sample = pixel.samples; sample < sample_end; ++sample) {
+				sampler.StartPixelSample(i, j, sample);
+				live.push_back(static_cast<uint32_t>(paths.size()));
+				rays.push_back(GetRay(i, j, sampler));
+				paths.push_back({ &pixel, i, j, sample, color(1, 1, 1), color(0, 0, 0) });
+			}
+			tileStats.samples += std::max(sample_end - pixel.samples, 0);
+			pixel.samples = std::max(sample_end, pixel.samples);
+		}
+	}
+
+	RayStream stream(wavefront_sort, packet_primary);
+	std::vector<hit_record> recs;
+	std::vector<ShadeQueue> queues;
+	std::vector<Ray> next_rays;
+	std::vector<uint32_t> next_live;
+
+	for (int bounce = 0; bounce < max_depth && !live.empty(); ++bounce) {
+		// Extend.
+		recs.resize(rays.size());
+		stream.Intersect(world, rays.data(), rays.size(), HitInterval(), recs.data());
+		tileStats.bounces += rays.size();
+
+		// Misses take the sky and finish, hits are queued by material class.
+		for (auto& queue : queues)
+			queue.items.clear();
+		for (size_t k = 0; k < rays.size(); ++k) {
+			auto& rec = recs[k];
+			auto& path = paths[live[k]];
+			if (!rec.object) {
+				path.radiance = path.throughput * Background(rays[k]);
+				continue;
+			}
+			rec.object->FinalizeHit(rays[k], rec);
+			QueueFor(queues, ShadeClass(*rec.mat)).push_back(static_cast<uint32_t>(k));
+		}
+
+		// Shade, one material class at a time.
+		next_rays.clear();
+		next_live.clear();
+		for (const auto& queue : queues) {
+			for (uint32_t k : queue.items) {
+				auto& path = paths[live[k]];
+				sampler.StartPixelSample(path.i, path.j, path.sample);
+				sampler.StartBounce(bounce);
+
+				Ray scattered;
+				color attenuation;
+				if (!ScatterMaterial(*recs[k].mat, rays[k], recs[k], attenuation, scattered, sampler))
+					continue;
+
+				path.throughput = path.throughput * attenuation;
+				if (!SurvivesRoulette(path.throughput, bounce, sampler))
+					continue;
+
+				next_rays.push_back(SpawnRay(recs[k], scattered));
+				next_live.push_back(live[k]);
+			}
+		}
+
+		// Connect: the survivors are the next batch.
+		rays.swap(next_rays);
+		live.swap(next_live);
+	}
+
+	// Paths still live after max_depth bounces gather no light. The rest are added in sample
+	// order, so pixel sums match the depth-first engine exactly.
+	for (const auto& path : paths) {
+		auto luminance = Luminance(path.radiance);
+		path.pixel->sum += Vec3<double>(path.radiance);
+		path.pixel->luminance_sq_sum += luminance * luminance;
+	}
+	return tileStats;
+}
@@ -3,16 +3,35 @@
 
 #include "Common/common.h"
 #include "Common/AABB.h"
+#include "Common/RayPacket.h"
+
+#include <cmath>
+#include <cstdint>
 
 class Material;
+class hittable;
 
+// 求交分两步:
+// hit() 只填 t, mat 和命中的图元 object, 遍历过程中会被更近的交点反复覆盖;
+// 找到最近交点后再调用 object->FinalizeHit() 计算 p, normal, front_face 和 u, v, 以及 p 的误差范围
 class hit_record {
   public:
+    const hittable* object = nullptr;
+    // 图元内部的编号, 例如三角形网格中命中的三角形, 供 FinalizeHit() 使用
+    uint32_t primitive = 0;
+    // object 是实例时, 实例内部命中的图元, 由实例的 FinalizeHit() 在局部空间中补全
+    const hittable* instanced = nullptr;
     point3 p;
     vec3 normal;
-    shared_ptr<Material> mat;
-    double t;
-    double u, v;
+    // p 每个分量的绝对误差上界, 真实的交点在 p +- p_error 的盒子里; SpawnOrigin() 据此偏移新射线的起点
+    vec3 p_error;
+    // 几何表面的法线 (不一定朝向射线), 三角形网格的 normal 是插值的着色法线, 两者不同
+    vec3 geometric_normal;
+    // 不持有所有权, 材质由场景中的图元持有, 渲染期间一直有效
+    // 求交时频繁复制 hit_record, 用裸指针避免每次都对引用计数做原子加减
+    const Material* mat = nullptr;
+    Real t;
+    Real u, v;
     bool front_face;
 
     void set_face_normal(const Ray& r, const vec3& outward_normal) {
@@ -22,6 +41,24 @@ class hit_record {
         front_face = dot(r.GetDirection(), outward_normal) < 0;
         normal = front_face ? outward_normal : -outward_normal;
     }
+
+    // 从交点出发、方向为 w 的新射线的起点: 沿几何法线移到误差盒子之外, 位于 w 所在的一侧
+    // 这样的射线用 t > 0 求交就不会再次命中同一个表面, 不需要固定的 epsilon
+    point3 SpawnOrigin(const vec3& w) const {
+        Real d = dot(abs(geometric_normal), p_error);
+        vec3 offset = d * geometric_normal;
+        if (dot(w, geometric_normal) < 0)
+            offset = -offset;
+        point3 po = p + offset;
+        // 加法的舍入可能把点拉回误差盒子里, 再向外挪一个 ulp
+        for (int i = 0; i < 3; ++i) {
+            if (offset[i] > 0)
+                po[i] = std::nextafter(po[i], Real(infinity));
+            else if (offset[i] < 0)
+                po[i] = std::nextafter(po[i], Real(-infinity));
+        }
+        return po;
+    }
 };
 
 
@@ -30,7 +67,30 @@ class hittable {
     virtual ~hittable() = default;
 
     virtual bool hit(const Ray& r, interval ray_t, hit_record& rec) const = 0;
+    // 同时求交 packet 中 mask 选中的射线, 第 i 条射线的区间和记录是 ray_t[i] 和 recs[i]
+    // 与 hit() 相同只填 t, mat, object; 命中的射线同时把 ray_t[i].max 缩短为 recs[i].t,
+    // 连续对多个对象调用时自然保留最近的交点. 返回本次命中的射线的位掩码
+    // 默认逐条调用 hit(), BVH 和球体重写为对整个 packet 的 SIMD 遍历和求交
+    virtual int HitPacket(const RayPacket& packet, interval* ray_t, hit_record* recs, int mask) const {
+        int hits = 0;
+        for (; mask != 0; mask &= mask - 1) {
+            int i = 0;
+            while (!(mask >> i & 1))
+                ++i;
+            if (hit(packet.rays[i], ray_t[i], recs[i])) {
+                ray_t[i].max = recs[i].t;
+                hits |= 1 << i;
+            }
+        }
+        return hits;
+    }
+    // 为 hit() 找到的最近交点补全表面信息, rec.object == this
+    // 聚合体 (列表, BVH) 不会出现在 rec.object 中, 所以默认什么也不做
+    virtual void FinalizeHit(const Ray&, hit_record&) const {}
     virtual AABB BoundingBox() const = 0;
+    // 快门开启 (time = 0) 和关闭 (time = 1) 时的包围盒, 快门内任意时刻的图元都在两者的线性插值之内
+    // BoundingBox() 是整个快门内扫过的范围, 静止的图元两者都等于它
+    virtual void MotionBounds(AABB& start, AABB& end) const { start = end = BoundingBox(); }
 };
 
 
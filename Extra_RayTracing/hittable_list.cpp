@@ -15,4 +15,13 @@ bool hittable_list::hit(const Ray & r, interval ray_t, hit_record & rec) const
     }
 
     return hit_anything;
-}
\ No newline at end of file
+}
+
+int hittable_list::HitPacket(const RayPacket& packet, interval* ray_t, hit_record* recs, int mask) const
+{
+    // 每个对象都会缩短命中射线的 ray_t[i].max, 最后留下的就是最近的交点
+    int hits = 0;
+    for (const auto& object : objects)
+        hits |= object->HitPacket(packet, ray_t, recs, mask);
+    return hits;
+}
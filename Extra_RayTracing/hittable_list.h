@@ -22,6 +22,7 @@ class hittable_list : public hittable {
     }
 
     bool hit(const Ray& r, interval ray_t, hit_record& rec) const override;
+    int HitPacket(const RayPacket& packet, interval* ray_t, hit_record* recs, int mask) const override;
     AABB BoundingBox()const override { return bbox; }
 
 public:
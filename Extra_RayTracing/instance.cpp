@@ -0,0 +1,57 @@
+#include "instance.h"
+
+instance::instance(shared_ptr<hittable> object, const Transform& objectToWorld)
+	:object(std::move(object))
+{
+	SetTransform(objectToWorld);
+}
+
+void instance::SetTransform(const Transform& transform)
+{
+	objectToWorld = transform;
+	worldToObject = transform.Inverse();
+	bbox = transform.ApplyBox(object->BoundingBox());
+}
+
+bool instance::hit(const Ray& r, interval ray_t, hit_record& rec) const
+{
+	// 没有命中时 rec 要保持原样, 它可能是别的图元更早找到的最近交点
+	auto previousInstanced = rec.instanced;
+	rec.instanced = nullptr;
+
+	Ray local = ToObject(r);
+	if (!object->hit(local, ray_t, rec))
+	{
+		rec.instanced = previousInstanced;
+		return false;
+	}
+
+	if (rec.instanced)
+	{
+		// 嵌套的实例: 内层的交点直接在本实例的物体空间中补全, 只留下变换到世界空间的部分
+		rec.object->FinalizeHit(local, rec);
+		rec.instanced = nullptr;
+	}
+	else
+	{
+		rec.instanced = rec.object;
+	}
+	rec.object = this;
+	return true;
+}
+
+void instance::FinalizeHit(const Ray& r, hit_record& rec) const
+{
+	if (rec.instanced)
+	{
+		auto primitive = rec.instanced;
+		rec.instanced = nullptr;
+		primitive->FinalizeHit(ToObject(r), rec);
+	}
+
+	// front_face 在两个空间中相同: dot(M d, M^-T n) = dot(d, n)
+	rec.p_error = objectToWorld.ApplyPointError(rec.p, rec.p_error);
+	rec.p = objectToWorld.ApplyPoint(rec.p);
+	rec.normal = unit_vector(worldToObject.ApplyTransposed(rec.normal));
+	rec.geometric_normal = unit_vector(worldToObject.ApplyTransposed(rec.geometric_normal));
+}
@@ -0,0 +1,39 @@
+#ifndef INSTANCE_H
+#define INSTANCE_H
+
+#include "Common/common.h"
+#include "Common/Transform.h"
+
+#include "hittable.h"
+
+// 实例: 共享的物体 (网格, BVH 等) 加上一个物体空间到世界空间的变换
+// 求交时把射线变换到物体空间, 方向不归一化, 所以两个空间中的 t 相同;
+// 多个实例引用同一个物体时, 几何数据和加速结构只有一份
+class instance final :public hittable
+{
+public:
+	instance(shared_ptr<hittable> object, const Transform& objectToWorld);
+
+	bool hit(const Ray& r, interval ray_t, hit_record& rec)const override;
+	void FinalizeHit(const Ray& r, hit_record& rec)const override;
+	AABB BoundingBox()const override { return bbox; }
+
+	const shared_ptr<hittable>& Object()const { return object; }
+	const Transform& ObjectToWorld()const { return objectToWorld; }
+	// 移动实例, 包围盒随之更新; 包含该实例的顶层 BVH 需要重新 Refit() 或 Rebuild()
+	void SetTransform(const Transform& transform);
+
+private:
+	Ray ToObject(const Ray& r)const
+	{
+		return Ray(worldToObject.ApplyPoint(r.GetOrigin()), worldToObject.ApplyVector(r.GetDirection()), r.GetTime());
+	}
+
+private:
+	shared_ptr<hittable> object;
+	Transform objectToWorld;
+	Transform worldToObject;
+	AABB bbox;
+};
+
+#endif // !INSTANCE_H
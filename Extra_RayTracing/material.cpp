@@ -1,30 +1,35 @@
 #include "material.h"
 
-bool Lambertian::Scatter(const Ray& r_in, const hit_record& rec, color& attenuation, Ray& scattered) const
+bool Lambertian::Scatter(const Ray& r_in, const hit_record& rec, color& attenuation, Ray& scattered, Sampler& sampler) const
+{
+	scattered = ScatterRay(r_in, rec, sampler);
+	attenuation = albedo->Value(rec.u, rec.v, rec.p);
+
+	return true;
+}
+
+Ray Lambertian::ScatterRay(const Ray& r_in, const hit_record& rec, Sampler& sampler)
 {
 	// diffuse
-	auto scatter_direct = rec.normal + random_unit_vector();
+	auto scatter_direct = rec.normal + random_unit_vector(sampler);
 
 	if (scatter_direct.near_zero())
 		scatter_direct = rec.normal;
 
-	scattered = Ray(rec.p, scatter_direct, r_in.GetTime());
-	attenuation = albedo->Value(rec.u, rec.v, rec.p);
-
-	return true;
+	return Ray(rec.p, scatter_direct, r_in.GetTime());
 }
 
-bool Metal::Scatter(const Ray& r_in, const hit_record& rec, color& attenuation, Ray& scattered) const
+bool Metal::Scatter(const Ray& r_in, const hit_record& rec, color& attenuation, Ray& scattered, Sampler& sampler) const
 {
 	// specular
 	vec3 reflected = reflect(unit_vector(r_in.GetDirection()), rec.normal);
 	// 毛玻璃效果
-	scattered = Ray(rec.p, reflected + fuzz * random_in_unit_sphere(), r_in.GetTime());
+	scattered = Ray(rec.p, reflected + fuzz * random_in_unit_sphere(sampler), r_in.GetTime());
 	attenuation = albedo;
 	return (dot(scattered.GetDirection(), rec.normal) > 0);
 }
 
-bool Dielectric::Scatter(const Ray& r_in, const hit_record& rec, color& attenuation, Ray& scattered) const
+bool Dielectric::Scatter(const Ray& r_in, const hit_record& rec, color& attenuation, Ray& scattered, Sampler& sampler) const
 {
 	attenuation = color(1.0, 1.0, 1.0);
 	double refraction_ratio = rec.front_face ? (1.0 / ir) : ir;
@@ -35,7 +40,7 @@ bool Dielectric::Scatter(const Ray& r_in, const hit_record& rec, color& attenuat
 	bool isReflect = refraction_ratio * sin_theta > 1.0;
 	vec3 direction;
 
-	if (isReflect || Reflectance(cos_theta, refraction_ratio) > random_double())
+	if (isReflect || Reflectance(cos_theta, refraction_ratio) > sampler.Get1D())
 		direction = reflect(unit_direction, rec.normal);
 	else
 		direction = refract(unit_direction, rec.normal, refraction_ratio);
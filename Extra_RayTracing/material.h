@@ -13,26 +13,37 @@ class Material {
     virtual ~Material() = default;
 
     virtual bool Scatter(
-        const Ray& r_in, const hit_record& rec, color& attenuation, Ray& scattered
+        const Ray& r_in, const hit_record& rec, color& attenuation, Ray& scattered, Sampler& sampler
     ) const = 0;
+
+    // 是否为 ClosedMaterial (见 material_variant.h), 是则渲染时不经过虚函数, 直接按 std::variant 分派
+    bool IsClosed() const { return closed; }
+
+  protected:
+    bool closed = false;
 };
 
 
-class Lambertian : public Material {
+class Lambertian final : public Material {
   public:
     Lambertian(const color& a) : albedo(make_shared<SolidColor>(a)) {}
     Lambertian(shared_ptr<Texture> a) : albedo(a) {}
-    bool Scatter(const Ray& r_in, const hit_record& rec, color& attenuation, Ray& scattered) const override;
+    bool Scatter(const Ray& r_in, const hit_record& rec, color& attenuation, Ray& scattered, Sampler& sampler) const override;
+
+    const shared_ptr<Texture>& Albedo() const { return albedo; }
+
+    // 漫反射方向, 与反照率无关, 封闭集合中的 Lambertian 使用同一个函数
+    static Ray ScatterRay(const Ray& r_in, const hit_record& rec, Sampler& sampler);
 
   private:
     shared_ptr<Texture> albedo;
 };
 
 
-class Metal : public Material {
+class Metal final : public Material {
 public:
     Metal(const color& a, double f) : albedo(a), fuzz(f < 1 ? f : 1) {}
-    bool Scatter(const Ray& r_in, const hit_record& rec, color& attenuation, Ray& scattered) const override;
+    bool Scatter(const Ray& r_in, const hit_record& rec, color& attenuation, Ray& scattered, Sampler& sampler) const override;
 
 private:
     color albedo;
@@ -40,10 +51,10 @@ private:
 };
 
 
-class Dielectric : public Material {
+class Dielectric final : public Material {
 public:
     Dielectric(double index_of_refraction) : ir(index_of_refraction) {}
-    bool Scatter(const Ray& r_in, const hit_record& rec, color& attenuation, Ray& scattered)const override;
+    bool Scatter(const Ray& r_in, const hit_record& rec, color& attenuation, Ray& scattered, Sampler& sampler) const override;
 private:
     double ir; // Index of Refraction
 
@@ -0,0 +1,177 @@
+#include "material_variant.h"
+
+#include "LinearBVH.h"
+#include "TopLevelBVH.h"
+#include "WideBVH.h"
+#include "instance.h"
+#include "sphere.h"
+#include "triangle_mesh.h"
+
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace
+{
+	struct TextureVisitor
+	{
+		const MaterialLibrary& library;
+		double u, v;
+		const point3& p;
+
+		color operator()(const SolidColor& texture)const { return texture.Color(); }
+		color operator()(const CheckerTextureNode& texture)const
+		{
+			return library.TextureValue(CheckerTexture::IsEven(texture.invScale, p) ? texture.even : texture.odd, u, v, p);
+		}
+		color operator()(const shared_ptr<const ImageTexture>& texture)const { return texture->Value(u, v, p); }
+		color operator()(const shared_ptr<const NoiseTexture>& texture)const { return texture->Value(u, v, p); }
+		color operator()(const OpenTexture& texture)const { return texture.texture->Value(u, v, p); }
+	};
+
+	struct ScatterVisitor
+	{
+		const MaterialLibrary& library;
+		const Ray& r_in;
+		const hit_record& rec;
+		color& attenuation;
+		Ray& scattered;
+		Sampler& sampler;
+
+		// 与 Lambertian::Scatter() 相同: 先采样方向, 再取反照率
+		bool operator()(const LambertianNode& material)const
+		{
+			scattered = Lambertian::ScatterRay(r_in, rec, sampler);
+			attenuation = library.TextureValue(material.albedo, rec.u, rec.v, rec.p);
+			return true;
+		}
+		bool operator()(const Metal& material)const { return material.Scatter(r_in, rec, attenuation, scattered, sampler); }
+		bool operator()(const Dielectric& material)const { return material.Scatter(r_in, rec, attenuation, scattered, sampler); }
+		bool operator()(const OpenMaterial& material)const
+		{
+			return material.material->Scatter(r_in, rec, attenuation, scattered, sampler);
+		}
+	};
+}
+
+ClosedMaterial::ClosedMaterial(MaterialVariant value, const MaterialLibrary& library)
+	:value(std::move(value)), library(&library)
+{
+	closed = true;
+}
+
+bool ClosedMaterial::ScatterClosed(const Ray& r_in, const hit_record& rec, color& attenuation, Ray& scattered, Sampler& sampler) const
+{
+	return std::visit(ScatterVisitor{ *library, r_in, rec, attenuation, scattered, sampler }, value);
+}
+
+color MaterialLibrary::TextureValue(uint32_t id, double u, double v, const point3& p) const
+{
+	return std::visit(TextureVisitor{ *this, u, v, p }, textures[id]);
+}
+
+uint32_t MaterialLibrary::AddTexture(const shared_ptr<Texture>& texture)
+{
+	auto found = std::find(textureSources.begin(), textureSources.end(), texture.get());
+	if (found != textureSources.end())
+		return static_cast<uint32_t>(found - textureSources.begin());
+
+	// 格子纹理的子纹理先加入, 父纹理排在后面
+	auto value = ToVariant(texture);
+	textures.push_back(std::move(value));
+	textureSources.push_back(texture.get());
+	return static_cast<uint32_t>(textures.size() - 1);
+}
+
+TextureVariant MaterialLibrary::ToVariant(const shared_ptr<Texture>& texture)
+{
+	if (auto solid = std::dynamic_pointer_cast<SolidColor>(texture))
+		return *solid;
+	if (auto checker = std::dynamic_pointer_cast<CheckerTexture>(texture))
+		return CheckerTextureNode{ checker->InvScale(), AddTexture(checker->Even()), AddTexture(checker->Odd()) };
+	if (auto image = std::dynamic_pointer_cast<ImageTexture>(texture))
+		return shared_ptr<const ImageTexture>(std::move(image));
+	if (auto noise = std::dynamic_pointer_cast<NoiseTexture>(texture))
+		return shared_ptr<const NoiseTexture>(std::move(noise));
+	return OpenTexture{ texture };
+}
+
+MaterialVariant MaterialLibrary::ToVariant(const shared_ptr<Material>& material)
+{
+	if (auto lambertian = std::dynamic_pointer_cast<Lambertian>(material))
+		return LambertianNode{ AddTexture(lambertian->Albedo()) };
+	if (auto metal = std::dynamic_pointer_cast<Metal>(material))
+		return *metal;
+	if (auto dielectric = std::dynamic_pointer_cast<Dielectric>(material))
+		return *dielectric;
+	return OpenMaterial{ material };
+}
+
+shared_ptr<const MaterialLibrary> MaterialLibrary::Close(hittable_list& world)
+{
+	// 递归进入列表, 扁平的 BVH, 顶层 BVH 和实例; 多个实例共用的网格只收集一次
+	std::vector<shared_ptr<sphere>> spheres;
+	std::vector<shared_ptr<triangle_mesh>> meshes;
+	std::unordered_set<const hittable*> visited;
+	std::function<void(const shared_ptr<hittable>&)> gather = [&](const shared_ptr<hittable>& object)
+	{
+		if (!object || !visited.insert(object.get()).second)
+			return;
+		if (auto ball = std::dynamic_pointer_cast<sphere>(object))
+			spheres.push_back(std::move(ball));
+		else if (auto mesh = std::dynamic_pointer_cast<triangle_mesh>(object))
+			meshes.push_back(std::move(mesh));
+		else if (auto list = std::dynamic_pointer_cast<hittable_list>(object))
+			for (const auto& child : list->objects)
+				gather(child);
+		else if (auto inst = std::dynamic_pointer_cast<instance>(object))
+			gather(inst->Object());
+		else if (auto tlas = std::dynamic_pointer_cast<TopLevelBVH>(object))
+			for (size_t i = 0; i < tlas->InstanceCount(); ++i)
+				gather(tlas->Instance(i).Object());
+		else if (auto bvh = std::dynamic_pointer_cast<LinearBVH>(object))
+			for (const auto& child : bvh->Primitives())
+				gather(child);
+		else if (auto bvh4 = std::dynamic_pointer_cast<BVH4>(object))
+			for (const auto& child : bvh4->Primitives())
+				gather(child);
+		else if (auto bvh8 = std::dynamic_pointer_cast<BVH8>(object))
+			for (const auto& child : bvh8->Primitives())
+				gather(child);
+	};
+	for (const auto& object : world.objects)
+		gather(object);
+
+	// 先收集所有不同的材质, 一次性分配 materials, 之后元素地址不再变化
+	std::vector<shared_ptr<Material>> sources;
+	std::unordered_map<const Material*, uint32_t> ids;
+	auto collect = [&](const shared_ptr<Material>& material)
+	{
+		if (material && !material->IsClosed() && ids.emplace(material.get(), static_cast<uint32_t>(sources.size())).second)
+			sources.push_back(material);
+	};
+	for (const auto& ball : spheres)
+		collect(ball->GetMaterial());
+	for (const auto& mesh : meshes)
+		collect(mesh->GetMaterial());
+
+	auto library = make_shared<MaterialLibrary>();
+	library->materials.reserve(sources.size());
+	for (const auto& material : sources)
+		library->materials.emplace_back(library->ToVariant(material), *library);
+
+	auto closedMaterial = [&](const shared_ptr<Material>& material)
+	{
+		auto found = material ? ids.find(material.get()) : ids.end();
+		if (found == ids.end())
+			return material;
+		return shared_ptr<Material>(library, &library->materials[found->second]);
+	};
+	for (const auto& ball : spheres)
+		ball->SetMaterial(closedMaterial(ball->GetMaterial()));
+	for (const auto& mesh : meshes)
+		mesh->SetMaterial(closedMaterial(mesh->GetMaterial()));
+
+	return library;
+}
@@ -0,0 +1,105 @@
+#ifndef MATERIAL_VARIANT_H
+#define MATERIAL_VARIANT_H
+
+#include "Common/common.h"
+
+#include "hittable_list.h"
+#include "material.h"
+
+#include <cstdint>
+#include <variant>
+#include <vector>
+
+// 封闭集合 (closed world) 的材质和纹理: 场景建好以后, 已知的材质和纹理类型按值存进 std::variant,
+// 着色时用 std::visit 在编译期展开的分派代替 Material::Scatter / Texture::Value 的虚函数调用
+// 材质和纹理连续存放在 MaterialLibrary 中, 纹理之间用下标引用, 不再经过 shared_ptr
+// 不认识的类型用 Open* 包装, 照常走虚函数, 虚函数接口本身保持不变, 新的材质不需要改动这里
+
+// 格子纹理, even / odd 是 MaterialLibrary 纹理数组中的下标
+struct CheckerTextureNode
+{
+	double invScale;
+	uint32_t even;
+	uint32_t odd;
+};
+
+struct OpenTexture
+{
+	shared_ptr<const Texture> texture;
+};
+
+// 图像和噪声纹理本身数据量大, 只保存指针, 但调用的是 final 类的成员函数, 不经过虚函数
+using TextureVariant = std::variant<SolidColor, CheckerTextureNode,
+	shared_ptr<const ImageTexture>, shared_ptr<const NoiseTexture>, OpenTexture>;
+
+// 反照率为纹理数组中的下标
+struct LambertianNode
+{
+	uint32_t albedo;
+};
+
+struct OpenMaterial
+{
+	shared_ptr<const Material> material;
+};
+
+using MaterialVariant = std::variant<LambertianNode, Metal, Dielectric, OpenMaterial>;
+
+class MaterialLibrary;
+
+// MaterialLibrary 中按值存放的一个材质
+// 仍然是 Material 的子类, 可以放进 hit_record::mat; 渲染器通过 ScatterMaterial() 识别它并跳过虚函数
+class ClosedMaterial final :public Material
+{
+public:
+	ClosedMaterial(MaterialVariant value, const MaterialLibrary& library);
+
+	bool Scatter(const Ray& r_in, const hit_record& rec, color& attenuation, Ray& scattered, Sampler& sampler) const override
+	{
+		return ScatterClosed(r_in, rec, attenuation, scattered, sampler);
+	}
+
+	// 与各材质类自己的 Scatter() 运算完全相同, 图像逐位一致
+	bool ScatterClosed(const Ray& r_in, const hit_record& rec, color& attenuation, Ray& scattered, Sampler& sampler) const;
+
+	const MaterialVariant& Value()const { return value; }
+
+private:
+	MaterialVariant value;
+	const MaterialLibrary* library;
+};
+
+class MaterialLibrary
+{
+public:
+	// 把 world 中 sphere 和 triangle_mesh 的材质换成库中的 ClosedMaterial, 同一个材质只转换一次
+	// 会进入 hittable_list, LinearBVH, BVH4 / BVH8, TopLevelBVH 和 instance 内部; 其它对象
+	// (BVHNode, PackSpheres() 生成的 sphere_set) 的材质保持原样, 渲染结果不变
+	// PackSpheres() 复制了材质, 需要在它之前调用; 图元持有指向库中材质的别名指针, 库随最后一个图元释放
+	static shared_ptr<const MaterialLibrary> Close(hittable_list& world);
+
+	color TextureValue(uint32_t id, double u, double v, const point3& p)const;
+
+	size_t MaterialCount()const { return materials.size(); }
+	size_t TextureCount()const { return textures.size(); }
+
+private:
+	uint32_t AddTexture(const shared_ptr<Texture>& texture);
+	TextureVariant ToVariant(const shared_ptr<Texture>& texture);
+	MaterialVariant ToVariant(const shared_ptr<Material>& material);
+
+private:
+	std::vector<TextureVariant> textures;
+	std::vector<ClosedMaterial> materials;
+	std::vector<const Texture*> textureSources;		// textures 中每一项由哪个纹理转换而来, 用于去重
+};
+
+// 渲染器调用材质的入口: ClosedMaterial 直接 std::visit, 其它材质照常调用虚函数
+inline bool ScatterMaterial(const Material& mat, const Ray& r_in, const hit_record& rec, color& attenuation, Ray& scattered, Sampler& sampler)
+{
+	if (mat.IsClosed())
+		return static_cast<const ClosedMaterial&>(mat).ScatterClosed(r_in, rec, attenuation, scattered, sampler);
+	return mat.Scatter(r_in, rec, attenuation, scattered, sampler);
+}
+
+#endif // !MATERIAL_VARIANT_H
@@ -0,0 +1,169 @@
+#include "scene.h"
+
+#include "instance.h"
+#include "material.h"
+#include "sphere.h"
+#include "TopLevelBVH.h"
+#include "triangle_mesh.h"
+#include "Common/Texture.h"
+
+hittable_list RandomSpheresWorld(double motionScale)
+{
+    hittable_list world;
+
+    auto ground_maerial = make_shared<Lambertian>(color(0.5, 0.5, 0.5));
+    auto checker = make_shared<CheckerTexture>(0.32, color(0.2, 0.3, 0.1), color(0.9, 0.9, 0.9));
+    world.add(make_shared<sphere>(point3(0, -1000, 0), 1000, make_shared<Lambertian>(checker)));
+
+    double r = 0.2;
+    for (int i = -11; i < 11; ++i) 
+    {
+        for (int j = -11; j < 11; ++j) 
+        {
+            auto choose_mat = random_double();
+            point3 center(i + 0.9 * random_double(), 0.2, j + 0.9 * random_double());
+
+            if ((center - point3(4, 0.2, 0)).length() > 0.9) 
+            {
+                shared_ptr<Material> material;
+                if (choose_mat < 0.8) 
+                {
+                    //diffuse
+                    auto albedo = color::random() * color::random();
+                    material = make_shared<Lambertian>(albedo);
+                    auto cen2 = center + vec3(0, random_double(0, 0.5f) * motionScale, 0);
+                    world.add(make_shared<sphere>(center, cen2, r, material));
+                }
+                else if (choose_mat < 0.95) 
+                {
+                    auto albedo = color::random() * color::random();
+                    auto fuzz = random_double(0, 0.5);
+                    material = make_shared<Metal>(albedo, fuzz);
+                    world.add(make_shared<sphere>(center, r, material));
+                }
+                else 
+                {
+                    // glass
+                    material = make_shared<Dielectric>(1.5);
+                    world.add(make_shared<sphere>(center, r, material));
+                }
+            }
+        }
+    }
+
+    auto material1 = make_shared<Dielectric>(1.5);
+    world.add(make_shared<sphere>(point3(0, 1, 0), 1.0, material1));
+
+    auto material2 = make_shared<Lambertian>(color(0.4, 0.2, 0.1));
+    world.add(make_shared<sphere>(point3(-4, 1, 0), 1.0, material2));
+
+    auto material3 = make_shared<Metal>(color(0.7, 0.6, 0.5), 0.0);
+    world.add(make_shared<sphere>(point3(4, 1, 0), 1.0, material3));
+
+    return world;
+}
+
+RandomSpheresAnimation::RandomSpheresAnimation(const hittable_list& world)
+{
+    for (const auto& object : world.objects)
+    {
+        auto ball = std::dynamic_pointer_cast<sphere>(object);
+        // 只有半径 0.2 的小球参与动画
+        if (!ball || ball->Radius() > 0.2)
+            continue;
+        motions.push_back({ ball, ball->Center(),
+            random_double(0.1, 0.4), random_double(0.1, 0.5), random_double(0.5, 2.0), random_double(0, 2 * pi) });
+    }
+}
+
+void RandomSpheresAnimation::SetTime(double seconds)
+{
+    for (const auto& m : motions)
+    {
+        double angle = m.phase + m.speed * seconds;
+        auto offset = vec3(m.radius * std::cos(angle), m.height * std::fabs(std::sin(2 * angle)), m.radius * std::sin(angle));
+        m.object->SetCenter(m.base + offset);
+    }
+}
+
+hittable_list TwoSpheresWorld()
+{
+    hittable_list world;
+
+    //auto checker = make_shared<CheckerTexture>(0.8, color(0.2, 0.3, 0.1), color(0.9, 0.9, 0.9));
+    //world.add(make_shared<sphere>(point3(0, -10, 0), 10, make_shared<Lambertian>(checker)));
+    //world.add(make_shared<sphere>(point3(0, 10, 0), 10, make_shared<Lambertian>(checker)));
+
+    auto noise = make_shared<NoiseTexture>(2);
+    world.add(make_shared<sphere>(point3(0, -1000, 0), 1000, make_shared<Lambertian>(noise)));
+    world.add(make_shared<sphere>(point3(0, 2, 0), 2, make_shared<Lambertian>(noise)));
+
+    return world;
+}
+
+hittable_list ClusteredSpheresWorld(size_t count)
+{
+    hittable_list world;
+    world.objects.reserve(count);
+
+    // 少量簇, 每个簇内的小球紧密聚集, 簇与簇之间大片空白
+    const int cluster_count = 64;
+    std::vector<point3> clusters;
+    for (int i = 0; i < cluster_count; ++i)
+        clusters.push_back(vec3::random(-50, 50));
+
+    auto material = make_shared<Lambertian>(color(0.5, 0.5, 0.5));
+    for (size_t i = 0; i < count; ++i)
+    {
+        auto& cluster = clusters[random_int(0, cluster_count - 1)];
+        auto offset = random_in_unit_sphere() * 4.0;
+        world.add(make_shared<sphere>(cluster + offset, random_double(0.01, 0.05), material));
+    }
+
+    return world;
+}
+
+hittable_list SkullWorld()
+{
+    auto skull = LoadTriangleMesh("skull.txt", make_shared<Lambertian>(color(0.8, 0.78, 0.7)));
+    if (!skull)
+        return {};
+
+    hittable_list world;
+
+    auto checker = make_shared<CheckerTexture>(0.8, color(0.2, 0.3, 0.1), color(0.9, 0.9, 0.9));
+    world.add(make_shared<sphere>(point3(0, -1000, 0), 1000, make_shared<Lambertian>(checker)));
+    world.add(skull);
+
+    return world;
+}
+
+hittable_list SkullFieldWorld(int rows)
+{
+    auto skull = LoadTriangleMesh("skull.txt", make_shared<Lambertian>(color(0.8, 0.78, 0.7)));
+    if (!skull)
+        return {};
+
+    hittable_list world;
+
+    auto ground = make_shared<Lambertian>(color(0.5, 0.5, 0.5));
+    world.add(make_shared<sphere>(point3(0, -10000, 0), 10000, ground));
+
+    // 所有实例共用同一个网格和它的 BVH (底层), 每个实例只有一个变换
+    std::vector<shared_ptr<instance>> instances;
+    const double spacing = 12.0;
+    double origin = -0.5 * spacing * (rows - 1);
+    for (int i = 0; i < rows; ++i)
+    {
+        for (int j = 0; j < rows; ++j)
+        {
+            auto transform = Transform::Translate(vec3(origin + i * spacing, 0, origin + j * spacing))
+                * Transform::RotateY(random_double(0, 360))
+                * Transform::Scale(random_double(0.6, 1.2));
+            instances.push_back(make_shared<instance>(skull, transform));
+        }
+    }
+    world.add(make_shared<TopLevelBVH>(std::move(instances)));
+
+    return world;
+}
@@ -0,0 +1,50 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include "Common/common.h"
+
+#include "hittable_list.h"
+
+#include <vector>
+
+class sphere;
+
+// 场景中的几何体, 渲染和基准测试共用
+
+// 地面加 22x22 个随机小球和三个大球 (未建 BVH)
+// motionScale 放大漫反射小球在快门内的位移, 1 为原来的场景
+hittable_list RandomSpheresWorld(double motionScale = 1.0);
+
+// RandomSpheresWorld 的动画: 小球绕各自的初始位置转圈并上下弹跳, 地面和三个大球不动
+// SetTime() 只移动球, 包含它们的 BVH 随后需要 Update() / Refit()
+class RandomSpheresAnimation
+{
+public:
+    explicit RandomSpheresAnimation(const hittable_list& world);
+
+    void SetTime(double seconds);
+
+private:
+    struct Motion
+    {
+        shared_ptr<sphere> object;
+        point3 base;
+        double radius, height, speed, phase;
+    };
+    std::vector<Motion> motions;
+};
+
+// 柏林噪声纹理的地面和一个大球
+hittable_list TwoSpheresWorld();
+
+// count 个聚成若干簇的小球, 用于大规模场景测试
+hittable_list ClusteredSpheresWorld(size_t count);
+
+// 棋盘格地面上的头骨网格 (Models/skull.txt, 6 万个三角形), 找不到模型时返回空的列表
+hittable_list SkullWorld();
+
+// 地面和 rows x rows 个随机旋转缩放的头骨实例, 实例共用一个网格, 放在一个 TopLevelBVH 中
+// 找不到模型时返回空的列表
+hittable_list SkullFieldWorld(int rows);
+
+#endif // !SCENE_H
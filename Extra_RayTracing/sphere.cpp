@@ -1,4 +1,5 @@
 #include "sphere.h"
+#include "Common/SimdLanes.h"
 
 bool sphere::hit(const Ray& r, interval ray_t, hit_record& rec) const
 {
@@ -11,7 +12,8 @@ bool sphere::hit(const Ray& r, interval ray_t, hit_record& rec) const
     // t^2 * Dir·Dir + 2t * Dir·(Ori - C) + (Ori - C)·(Ori - C) - r^2 = 0
     auto a = r.GetDirection().length_squared();
     auto half_b = dot(oc, r.GetDirection());
-    auto c = oc.length_squared() - radius * radius;
+    // radius 以 double 保存, 平方后换成 Real, 整个方程按 Real 求解, HitPacket() 与此相同
+    auto c = oc.length_squared() - static_cast<Real>(radius * radius);
     auto discriminant = half_b * half_b - a * c;
     auto root = (-half_b - sqrt(discriminant)) / a;
     if (discriminant < 0) goto Exit0;
@@ -23,16 +25,98 @@ bool sphere::hit(const Ray& r, interval ray_t, hit_record& rec) const
     }
 
     rec.t = root;
-    rec.p = r.At(rec.t);
-    rec.set_face_normal(r, (rec.p - cen) / radius);
-    GetSphereUV((rec.p - cen) / radius, rec.u, rec.v);
-    rec.mat = mat;
+    rec.mat = mat.get();
+    rec.object = this;
     res = true;
 Exit0:
     return res;
 }
 
-void sphere::GetSphereUV(const point3& p, double& u, double& v)
+int sphere::HitPacket(const RayPacket& packet, interval* ray_t, hit_record* recs, int mask) const
+{
+    using Lanes = RealLanes;
+    using V = Lanes::V;
+    using M = Lanes::M;
+    static_assert(RayPacket::kSize % Lanes::kWidth == 0, "packet size must be a multiple of the SIMD width");
+
+    const V radius2 = Lanes::Set(static_cast<Real>(radius * radius));
+    int hits = 0;
+    for (int g = 0; g < RayPacket::kSize; g += Lanes::kWidth) {
+        int laneMask = (mask >> g) & ((1 << Lanes::kWidth) - 1);
+        if (laneMask == 0)
+            continue;
+
+        alignas(32) Real tMin[Lanes::kWidth], tMax[Lanes::kWidth];
+        for (int k = 0; k < Lanes::kWidth; ++k) {
+            tMin[k] = ray_t[g + k].min;
+            tMax[k] = ray_t[g + k].max;
+        }
+
+        // 与 hit() 相同: cen = center + t * center_vec, 静止的球直接用 center
+        V oc[3];
+        for (int a = 0; a < 3; ++a) {
+            V cen = Lanes::Set(center[a]);
+            if (is_moving)
+                cen = Lanes::Add(cen, Lanes::Mul(Lanes::Load(packet.time + g), Lanes::Set(center_vec[a])));
+            oc[a] = Lanes::Sub(Lanes::Load(packet.origin[a] + g), cen);
+        }
+        V dx = Lanes::Load(packet.direction[0] + g);
+        V dy = Lanes::Load(packet.direction[1] + g);
+        V dz = Lanes::Load(packet.direction[2] + g);
+
+        V a = Lanes::Load(packet.directionLength2 + g);
+        V half_b = Lanes::Add(Lanes::Add(Lanes::Mul(oc[0], dx), Lanes::Mul(oc[1], dy)), Lanes::Mul(oc[2], dz));
+        V c = Lanes::Sub(Lanes::Add(Lanes::Add(Lanes::Mul(oc[0], oc[0]), Lanes::Mul(oc[1], oc[1])),
+            Lanes::Mul(oc[2], oc[2])), radius2);
+        V discriminant = Lanes::Sub(Lanes::Mul(half_b, half_b), Lanes::Mul(a, c));
+        // 判别式为负时 sqrt 得到 NaN, 下面的比较都不成立
+        V sqrtd = Lanes::Sqrt(discriminant);
+        V nearRoot = Lanes::Div(Lanes::Sub(Lanes::Neg(half_b), sqrtd), a);
+        V farRoot = Lanes::Div(Lanes::Add(Lanes::Neg(half_b), sqrtd), a);
+
+        V lo = Lanes::Load(tMin), hi = Lanes::Load(tMax);
+        M nearHit = Lanes::And(Lanes::Less(lo, nearRoot), Lanes::Less(nearRoot, hi));
+        M farHit = Lanes::And(Lanes::Less(lo, farRoot), Lanes::Less(farRoot, hi));
+        int laneHits = Lanes::Bits(Lanes::Or(nearHit, farHit)) & laneMask;
+        if (laneHits == 0)
+            continue;
+
+        alignas(32) Real root[Lanes::kWidth];
+        Lanes::Store(root, Lanes::Select(nearHit, nearRoot, farRoot));
+        for (int k = 0; k < Lanes::kWidth; ++k) {
+            if (!(laneHits >> k & 1))
+                continue;
+            auto& rec = recs[g + k];
+            rec.t = root[k];
+            rec.mat = mat.get();
+            rec.object = this;
+            ray_t[g + k].max = root[k];
+        }
+        hits |= laneHits << g;
+    }
+    return hits;
+}
+
+void sphere::FinalizeHit(const Ray& r, hit_record& rec) const
+{
+    // 法线和 uv 只为最近交点计算一次
+    point3 cen = is_moving ? GetCenter(r.GetTime()) : center;
+    rec.p = r.At(rec.t);
+    vec3 outward_normal = (rec.p - cen) / radius;
+    rec.set_face_normal(r, outward_normal);
+    rec.geometric_normal = outward_normal;
+    rec.p_error = SurfaceError(rec.p, cen, radius);
+    GetSphereUV(outward_normal, rec.u, rec.v);
+}
+
+vec3 sphere::SurfaceError(const point3& p, const point3& center, Real radius)
+{
+    // 求根公式的抵消误差可能很大, 不去分析 t 的误差, 直接量出 p 偏离球面多远
+    Real residual = std::fabs((p - center).length() - radius);
+    return vec3(residual, residual, residual) + ErrorGamma(7) * (abs(p) + abs(center) + vec3(radius, radius, radius));
+}
+
+void sphere::GetSphereUV(const point3& p, Real& u, Real& v)
 {
     // p: a given point on the sphere of radius one, centered at the origin.
     // u: returned value [0,1] of angle around the Y axis from X=-1.
@@ -47,3 +131,20 @@ void sphere::GetSphereUV(const point3& p, double& u, double& v)
     u = phi / (2 * pi);
     v = theta / pi;
 }
+
+void sphere::SetCenter(const point3& _center)
+{
+    center = _center;
+    auto rvec = vec3(radius, radius, radius);
+    bbox = AABB(center - rvec, center + rvec);
+    if (is_moving)
+        bbox = AABB(bbox, AABB(center + center_vec - rvec, center + center_vec + rvec));
+}
+
+void sphere::MotionBounds(AABB& start, AABB& end) const
+{
+    // 球心做线性运动, 两端的包围盒插值得到的正好是中间时刻的包围盒
+    auto rvec = vec3(radius, radius, radius);
+    start = AABB(center - rvec, center + rvec);
+    end = is_moving ? AABB(center + center_vec - rvec, center + center_vec + rvec) : start;
+}
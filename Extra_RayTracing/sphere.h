@@ -27,8 +27,28 @@ class sphere : public hittable {
     }
 
     bool hit(const Ray& r, interval ray_t, hit_record& rec) const override;
+    // 多条射线放在 Real 精度的 SIMD 通道 (RealLanes) 中求解, 每条射线的运算顺序与 hit() 相同, 结果完全一致
+    int HitPacket(const RayPacket& packet, interval* ray_t, hit_record* recs, int mask) const override;
+    void FinalizeHit(const Ray& r, hit_record& rec) const override;
 
     AABB BoundingBox()const override { return bbox; }
+    void MotionBounds(AABB& start, AABB& end)const override;
+
+    // 快门开启时刻的球心
+    point3 Center()const { return center; }
+    double Radius()const { return radius; }
+    // 快门内球心的位移, 静止的球为 0
+    vec3 Velocity()const { return is_moving ? center_vec : vec3(0, 0, 0); }
+    const shared_ptr<Material>& GetMaterial()const { return mat; }
+    void SetMaterial(shared_ptr<Material> _material) { mat = std::move(_material); }
+    // 把球移到新的位置, 快门内的运动保持不变, 用于逐帧的动画
+    // 包含它的 BVH 随后需要 Refit() 或重建
+    void SetCenter(const point3& _center);
+
+    // p 为单位球面上的点, 返回其纹理坐标, sphere_set 也使用同样的映射
+    static void GetSphereUV(const point3& p, Real& u, Real& v);
+    // r.At(t) 得到的交点 p 的误差上界: p 到球面的距离, 加上计算 p 和这个距离的舍入误差
+    static vec3 SurfaceError(const point3& p, const point3& center, Real radius);
 
   private:
     point3 center;
@@ -44,8 +64,6 @@ class sphere : public hittable {
         return center + t * center_vec;
     }
 
-    static void GetSphereUV(const point3& p, double& u, double& v);
-
 };
 
 
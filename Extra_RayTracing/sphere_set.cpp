@@ -0,0 +1,260 @@
+#include "sphere_set.h"
+
+#include "BVHBuilder.h"
+#include "sphere.h"
+#include "Common/SimdLanes.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <unordered_map>
+
+namespace
+{
+	using Lanes = FloatLanes;
+
+	static_assert(sphere_set::kMaxSpheres % Lanes::kWidth == 0, "sphere_set capacity must be a multiple of the SIMD width");
+
+	// float 运算的误差余量按操作数的量级放大若干个 epsilon, 只会多放过几个球, 不会漏掉交点
+	constexpr float kCullTolerance = 8 * std::numeric_limits<float>::epsilon();
+}
+
+sphere_set::sphere_set(shared_ptr<const MaterialTable> materials)
+	:materials(std::move(materials))
+{
+	const float nan = std::numeric_limits<float>::quiet_NaN();
+	for (int i = 0; i < kMaxSpheres; ++i)
+	{
+		cullX[i] = cullY[i] = cullZ[i] = nan;
+		cullVelocityX[i] = cullVelocityY[i] = cullVelocityZ[i] = 0;
+		cullRadius[i] = 0;
+		radius[i] = 0;
+		materialId[i] = 0;
+	}
+}
+
+bool sphere_set::Add(const point3& _center, const vec3& _velocity, double r, uint32_t id)
+{
+	if (count == kMaxSpheres)
+		return false;
+
+	center[count] = _center;
+	velocity[count] = _velocity;
+	radius[count] = r;
+	materialId[count] = id;
+
+	cullX[count] = static_cast<float>(_center.x());
+	cullY[count] = static_cast<float>(_center.y());
+	cullZ[count] = static_cast<float>(_center.z());
+	cullVelocityX[count] = static_cast<float>(_velocity.x());
+	cullVelocityY[count] = static_cast<float>(_velocity.y());
+	cullVelocityZ[count] = static_cast<float>(_velocity.z());
+	// 球心转换成 float 和插值的误差相对于坐标的量级, 折算到半径上
+	double magnitude = std::fabs(_center.x()) + std::fabs(_center.y()) + std::fabs(_center.z())
+		+ std::fabs(_velocity.x()) + std::fabs(_velocity.y()) + std::fabs(_velocity.z()) + r;
+	cullRadius[count] = static_cast<float>(r + kCullTolerance * magnitude);
+
+	auto rvec = vec3(r, r, r);
+	AABB start(_center - rvec, _center + rvec);
+	AABB end(_center + _velocity - rvec, _center + _velocity + rvec);
+	startBox = count == 0 ? start : AABB(startBox, start);
+	endBox = count == 0 ? end : AABB(endBox, end);
+	bbox = AABB(startBox, endBox);
+
+	count++;
+	return true;
+}
+
+void sphere_set::MotionBounds(AABB& start, AABB& end) const
+{
+	start = startBox;
+	end = endBox;
+}
+
+bool sphere_set::HitSphere(int i, const Ray& r, const interval& ray_t, Real& root) const
+{
+	point3 cen = center[i] + r.GetTime() * velocity[i];
+	vec3 oc = r.GetOrigin() - cen;
+	auto a = r.GetDirection().length_squared();
+	auto half_b = dot(oc, r.GetDirection());
+	// 与 sphere::hit() 相同, 半径的平方换成 Real 后再参与运算
+	auto c = oc.length_squared() - static_cast<Real>(radius[i] * radius[i]);
+	auto discriminant = half_b * half_b - a * c;
+	if (discriminant < 0)
+		return false;
+
+	root = (-half_b - sqrt(discriminant)) / a;
+	if (!ray_t.surrounds(root))
+	{
+		root = (-half_b + sqrt(discriminant)) / a;
+		if (!ray_t.surrounds(root))
+			return false;
+	}
+	return true;
+}
+
+bool sphere_set::hit(const Ray& r, interval ray_t, hit_record& rec) const
+{
+	using V = Lanes::V;
+	using M = Lanes::M;
+
+	// 剔除: 球心到射线所在直线的距离不超过半径, 即 |oc x d| <= r |d|,
+	// 并且球沿射线方向占据的范围 (-b -+ r |d|) / |d|^2 与 [tMin, tMax] 重叠, 其中 b = oc . d
+	// 不用判别式 b^2 - |d|^2 (|oc|^2 - r^2): 远处的小球在 float 下两项几乎完全抵消
+	// 叉积和点积的舍入误差都不超过 |oc| |d| 的若干个 epsilon, 比较时放宽这个余量
+	const vec3& origin = r.GetOrigin();
+	const vec3& direction = r.GetDirection();
+	const V ox = Lanes::Set(static_cast<float>(origin.x()));
+	const V oy = Lanes::Set(static_cast<float>(origin.y()));
+	const V oz = Lanes::Set(static_cast<float>(origin.z()));
+	const V dx = Lanes::Set(static_cast<float>(direction.x()));
+	const V dy = Lanes::Set(static_cast<float>(direction.y()));
+	const V dz = Lanes::Set(static_cast<float>(direction.z()));
+	const V time = Lanes::Set(static_cast<float>(r.GetTime()));
+	const double directionLength2 = direction.length_squared();
+	const V directionLength = Lanes::Set(static_cast<float>(std::sqrt(directionLength2)));
+	const V tMinA = Lanes::Set(static_cast<float>(ray_t.min * directionLength2));
+	const V tMaxA = Lanes::Set(static_cast<float>(ray_t.max * directionLength2));
+	const V rangePad = Lanes::Set(static_cast<float>(kCullTolerance * (ray_t.min + ray_t.max) * directionLength2));
+	// |oc| |d| 用各分量绝对值之和的乘积来估计上界
+	const V directionPad = Lanes::Set(static_cast<float>(kCullTolerance
+		* (std::fabs(direction.x()) + std::fabs(direction.y()) + std::fabs(direction.z()))));
+	// 射线起点转换成 float 的误差
+	const V originPad = Lanes::Set(static_cast<float>(kCullTolerance
+		* (std::fabs(origin.x()) + std::fabs(origin.y()) + std::fabs(origin.z()))));
+
+	int candidates = 0;
+	for (int g = 0; g < count; g += Lanes::kWidth)
+	{
+		V ocx = Lanes::Sub(ox, Lanes::Add(Lanes::Load(cullX + g), Lanes::Mul(time, Lanes::Load(cullVelocityX + g))));
+		V ocy = Lanes::Sub(oy, Lanes::Add(Lanes::Load(cullY + g), Lanes::Mul(time, Lanes::Load(cullVelocityY + g))));
+		V ocz = Lanes::Sub(oz, Lanes::Add(Lanes::Load(cullZ + g), Lanes::Mul(time, Lanes::Load(cullVelocityZ + g))));
+		V rad = Lanes::Add(Lanes::Load(cullRadius + g), originPad);
+		V pad = Lanes::Mul(directionPad, Lanes::Add(Lanes::Add(Lanes::Abs(ocx), Lanes::Abs(ocy)), Lanes::Abs(ocz)));
+		V reach = Lanes::Add(Lanes::Mul(rad, directionLength), pad);
+
+		V crossX = Lanes::Sub(Lanes::Mul(ocy, dz), Lanes::Mul(ocz, dy));
+		V crossY = Lanes::Sub(Lanes::Mul(ocz, dx), Lanes::Mul(ocx, dz));
+		V crossZ = Lanes::Sub(Lanes::Mul(ocx, dy), Lanes::Mul(ocy, dx));
+		V perpendicular2 = Lanes::Add(Lanes::Add(Lanes::Mul(crossX, crossX), Lanes::Mul(crossY, crossY)),
+			Lanes::Mul(crossZ, crossZ));
+		M crossesLine = Lanes::LessEqual(perpendicular2, Lanes::Mul(reach, reach));
+
+		// b 的符号与 t 相反
+		V b = Lanes::Add(Lanes::Add(Lanes::Mul(ocx, dx), Lanes::Mul(ocy, dy)), Lanes::Mul(ocz, dz));
+		V extent = Lanes::Add(reach, rangePad);
+		M beforeMax = Lanes::LessEqual(Lanes::Sub(Lanes::Sub(Lanes::Set(0.0f), b), extent), tMaxA);
+		M afterMin = Lanes::LessEqual(tMinA, Lanes::Sub(extent, b));
+		candidates |= Lanes::Bits(Lanes::And(crossesLine, Lanes::And(beforeMax, afterMin))) << g;
+	}
+
+	// 按组内顺序逐个精确求交, double 构建中与逐个调用 sphere::hit() 的结果相同
+	int best = -1;
+	for (; candidates != 0; candidates &= candidates - 1)
+	{
+		int i = 0;
+		while (!(candidates >> i & 1))
+			++i;
+
+		Real root;
+		if (HitSphere(i, r, ray_t, root))
+		{
+			best = i;
+			ray_t.max = root;
+		}
+	}
+	if (best < 0)
+		return false;
+
+	rec.t = ray_t.max;
+	rec.mat = (*materials)[materialId[best]].get();
+	rec.object = this;
+	rec.primitive = static_cast<uint32_t>(best);
+	return true;
+}
+
+void sphere_set::FinalizeHit(const Ray& r, hit_record& rec) const
+{
+	int i = static_cast<int>(rec.primitive);
+	point3 cen = center[i] + r.GetTime() * velocity[i];
+
+	rec.p = r.At(rec.t);
+	vec3 outward_normal = (rec.p - cen) / radius[i];
+	rec.set_face_normal(r, outward_normal);
+	rec.geometric_normal = outward_normal;
+	rec.p_error = sphere::SurfaceError(rec.p, cen, radius[i]);
+	sphere::GetSphereUV(outward_normal, rec.u, rec.v);
+}
+
+hittable_list PackSpheres(const hittable_list& list, int groupSize)
+{
+	groupSize = std::clamp(groupSize, 1, sphere_set::kMaxSpheres);
+
+	hittable_list result;
+	std::vector<shared_ptr<sphere>> spheres;
+	for (const auto& object : list.objects)
+	{
+		if (auto ball = std::dynamic_pointer_cast<sphere>(object))
+			spheres.push_back(std::move(ball));
+		else
+			result.add(object);
+	}
+	if (spheres.empty())
+		return result;
+
+	auto materials = make_shared<sphere_set::MaterialTable>();
+	std::unordered_map<const Material*, uint32_t> materialIds;
+	auto materialId = [&](const shared_ptr<Material>& material)
+	{
+		auto inserted = materialIds.emplace(material.get(), static_cast<uint32_t>(materials->size()));
+		if (inserted.second)
+			materials->push_back(material);
+		return inserted.first->second;
+	};
+
+	// 先按 SAH 建一棵正常的树, 再把图元数不超过 groupSize 的最大子树各自合并成一组:
+	// 分组沿用 SAH 的空间划分, 地面这样的大球不会和远处的小球分到一起
+	BVHBuilder builder(BVHSplitMethod::SAH, groupSize);
+	std::vector<LinearBVHNode> nodes;
+	std::vector<uint32_t> order;
+	builder.Build(spheres.size(), [&](size_t i) { return spheres[i]->BoundingBox(); }, nodes, order);
+
+	// 深度优先排列中子树的图元是连续的一段, 倒序累计每个子树的图元数和起点
+	std::vector<uint32_t> subtreeCount(nodes.size()), subtreeFirst(nodes.size());
+	for (size_t n = nodes.size(); n-- > 0;)
+	{
+		const auto& node = nodes[n];
+		if (node.primitiveCount > 0)
+		{
+			subtreeCount[n] = node.primitiveCount;
+			subtreeFirst[n] = node.primitivesOffset;
+		}
+		else
+		{
+			subtreeCount[n] = subtreeCount[n + 1] + subtreeCount[node.secondChildOffset];
+			subtreeFirst[n] = subtreeFirst[n + 1];
+		}
+	}
+
+	std::vector<uint32_t> stack{ 0 };
+	while (!stack.empty())
+	{
+		uint32_t n = stack.back();
+		stack.pop_back();
+		if (subtreeCount[n] > static_cast<uint32_t>(groupSize))
+		{
+			stack.push_back(nodes[n].secondChildOffset);
+			stack.push_back(n + 1);
+			continue;
+		}
+
+		auto set = make_shared<sphere_set>(materials);
+		for (uint32_t k = subtreeFirst[n]; k < subtreeFirst[n] + subtreeCount[n]; ++k)
+		{
+			const auto& ball = spheres[order[k]];
+			set->Add(ball->Center(), ball->Velocity(), ball->Radius(), materialId(ball->GetMaterial()));
+		}
+		result.add(set);
+	}
+	return result;
+}
@@ -0,0 +1,70 @@
+#ifndef SPHERE_SET_H
+#define SPHERE_SET_H
+
+#include "Common/common.h"
+
+#include "hittable.h"
+#include "hittable_list.h"
+
+#include <cstdint>
+#include <vector>
+
+// 最多 kMaxSpheres 个球组成的一个图元, 球按结构体数组 (SoA) 存放, 代替逐个调用 sphere::hit() 的虚函数
+// 先用 float 一条 SIMD 指令同时对 4 个 (SSE) 或 8 个 (AVX) 球做保守的剔除测试,
+// 只对可能相交的球用 Real 精确求交, 精确求交与 sphere::hit() 的运算完全相同
+// double 构建中结果与逐个调用 sphere::hit() 一致; float 构建中掠射的射线在二次方程里的舍入误差
+// 可能超过剔除的余量, sphere::hit() 给出的个别交点会被剔除, 图像不再逐位一致
+// 由 PackSpheres() 按空间位置分组生成, 作为外层 BVH 叶子中的图元
+class sphere_set :public hittable
+{
+public:
+	static constexpr int kMaxSpheres = 8;
+
+	using MaterialTable = std::vector<shared_ptr<Material>>;
+
+	// 同一批 sphere_set 共享一张材质表, 每个球只存表中的下标
+	explicit sphere_set(shared_ptr<const MaterialTable> materials);
+
+	// velocity 为快门内球心的位移, 已满时返回 false
+	bool Add(const point3& center, const vec3& velocity, double radius, uint32_t materialId);
+
+	bool hit(const Ray& r, interval ray_t, hit_record& rec)const override;
+	// rec.primitive 为命中的球在组内的序号
+	void FinalizeHit(const Ray& r, hit_record& rec)const override;
+	AABB BoundingBox()const override { return bbox; }
+	void MotionBounds(AABB& start, AABB& end)const override;
+
+	int Count()const { return count; }
+
+private:
+	// 第 i 个球的精确求交, 与 sphere::hit() 相同
+	bool HitSphere(int i, const Ray& r, const interval& ray_t, Real& root)const;
+
+private:
+	// 剔除测试用的 float 数据, 半径已经加上了 float 运算误差的余量
+	// 空位的球心为 NaN, 剔除测试总是不通过, 整组可以按 SIMD 宽度对齐处理
+	alignas(32) float cullX[kMaxSpheres];
+	alignas(32) float cullY[kMaxSpheres];
+	alignas(32) float cullZ[kMaxSpheres];
+	alignas(32) float cullVelocityX[kMaxSpheres];
+	alignas(32) float cullVelocityY[kMaxSpheres];
+	alignas(32) float cullVelocityZ[kMaxSpheres];
+	alignas(32) float cullRadius[kMaxSpheres];
+
+	// 精确求交用的数据, 半径与 sphere 相同以 double 保存
+	point3 center[kMaxSpheres];
+	vec3 velocity[kMaxSpheres];
+	double radius[kMaxSpheres];
+	uint32_t materialId[kMaxSpheres];
+	int count = 0;
+
+	shared_ptr<const MaterialTable> materials;
+	AABB bbox;
+	AABB startBox, endBox;
+};
+
+// 把 list 中的 sphere 按 SAH 划分的空间位置分成不超过 groupSize 个的组, 换成 sphere_set, 其它对象原样保留
+// 结果仍需要再建一层 BVH, 每个叶子放一组 (maxLeafSize = 1)
+hittable_list PackSpheres(const hittable_list& list, int groupSize = sphere_set::kMaxSpheres);
+
+#endif // !SPHERE_SET_H
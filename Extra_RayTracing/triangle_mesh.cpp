@@ -0,0 +1,278 @@
+#include "triangle_mesh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <limits>
+
+namespace
+{
+	vec3 LoadVec3(const std::vector<float>& data, uint32_t vertex)
+	{
+		const float* p = &data[static_cast<size_t>(vertex) * 3];
+		return vec3(p[0], p[1], p[2]);
+	}
+
+	// 水密的射线-三角形求交 (Woop, Benthin, Wald 2013, Watertight Ray/Triangle Intersection)
+	// 把射线方向变换到 +z 轴后在 xy 平面上做 2D 边函数测试, 相邻三角形的公共边对同一条射线
+	// 给出完全相同的边函数值, 射线不会从两个三角形的缝隙中漏过去
+	// 与三角形无关的部分 (轴的排列和剪切系数) 每条射线只算一次
+	struct WatertightRay
+	{
+		WatertightRay(const Ray& r)
+			:origin(r.GetOrigin())
+		{
+			const vec3& dir = r.GetDirection();
+			kz = 0;
+			for (int a = 1; a < 3; ++a)
+				if (std::fabs(dir[a]) > std::fabs(dir[kz]))
+					kz = a;
+			kx = (kz + 1) % 3;
+			ky = (kx + 1) % 3;
+			// 保持三角形的环绕方向
+			if (dir[kz] < 0)
+				std::swap(kx, ky);
+
+			shearX = dir[kx] / dir[kz];
+			shearY = dir[ky] / dir[kz];
+			shearZ = 1.0 / dir[kz];
+		}
+
+		// 命中时返回 t 和第二, 第三个顶点的重心坐标
+		bool Intersect(const vec3& p0, const vec3& p1, const vec3& p2, interval ray_t,
+			double& t, double& b1, double& b2)const
+		{
+			vec3 a = p0 - origin;
+			vec3 b = p1 - origin;
+			vec3 c = p2 - origin;
+
+			double ax = a[kx] - shearX * a[kz];
+			double ay = a[ky] - shearY * a[kz];
+			double bx = b[kx] - shearX * b[kz];
+			double by = b[ky] - shearY * b[kz];
+			double cx = c[kx] - shearX * c[kz];
+			double cy = c[ky] - shearY * c[kz];
+
+			// 边函数, 分别是对边顶点的 (未归一化的) 重心坐标
+			double u = cx * by - cy * bx;
+			double v = ax * cy - ay * cx;
+			double w = bx * ay - by * ax;
+
+			// 正反两面都算命中
+			if ((u < 0 || v < 0 || w < 0) && (u > 0 || v > 0 || w > 0))
+				return false;
+
+			double det = u + v + w;
+			if (det == 0)
+				return false;
+
+			double scaledT = u * (shearZ * a[kz]) + v * (shearZ * b[kz]) + w * (shearZ * c[kz]);
+			double invDet = 1.0 / det;
+			t = scaledT * invDet;
+			if (!ray_t.surrounds(t))
+				return false;
+
+			b1 = v * invDet;
+			b2 = w * invDet;
+			return true;
+		}
+
+		point3 origin;
+		int kx, ky, kz;
+		double shearX, shearY, shearZ;
+	};
+
+	// 依次尝试 fileName 本身和当前目录及上级目录中的 Models/fileName
+	std::ifstream OpenModelFile(const std::string& fileName)
+	{
+		std::ifstream in(fileName);
+		const char* prefixes[] = { "Models/", "../Models/", "../../Models/", "../../../Models/" };
+		for (const char* prefix : prefixes)
+		{
+			if (in)
+				break;
+			in = std::ifstream(prefix + fileName);
+		}
+		return in;
+	}
+}
+
+triangle_mesh::triangle_mesh(const std::vector<point3>& inPositions, const std::vector<vec3>& inNormals,
+	std::vector<uint32_t> inIndices, shared_ptr<Material> material,
+	BVHSplitMethod method, size_t maxLeafSize, int threadCount)
+	:mat(std::move(material))
+{
+	positions.reserve(inPositions.size() * 3);
+	for (const auto& p : inPositions)
+	{
+		positions.push_back(static_cast<float>(p.x()));
+		positions.push_back(static_cast<float>(p.y()));
+		positions.push_back(static_cast<float>(p.z()));
+	}
+	if (!inNormals.empty())
+	{
+		normals.reserve(inNormals.size() * 3);
+		for (const auto& n : inNormals)
+		{
+			normals.push_back(static_cast<float>(n.x()));
+			normals.push_back(static_cast<float>(n.y()));
+			normals.push_back(static_cast<float>(n.z()));
+		}
+	}
+
+	size_t triangleCount = inIndices.size() / 3;
+	auto triangleBounds = [&](size_t i)
+	{
+		// 取 float 顶点的包围盒, 与求交时使用的坐标一致
+		vec3 p0 = LoadVec3(positions, inIndices[i * 3]);
+		vec3 p1 = LoadVec3(positions, inIndices[i * 3 + 1]);
+		vec3 p2 = LoadVec3(positions, inIndices[i * 3 + 2]);
+		return AABB(AABB(p0, p1), AABB(p2, p2));
+	};
+
+	BVHBuilder builder(method, maxLeafSize, threadCount);
+	std::vector<uint32_t> order;
+	builder.Build(triangleCount, triangleBounds, nodes, order);
+
+	// 按叶子顺序重排三角形, 叶子中的第 k 个三角形就是 indices 中的第 primitivesOffset + k 个
+	indices.resize(order.size() * 3);
+	for (size_t k = 0; k < order.size(); ++k)
+	{
+		for (int j = 0; j < 3; ++j)
+			indices[k * 3 + j] = inIndices[static_cast<size_t>(order[k]) * 3 + j];
+		bbox = k == 0 ? triangleBounds(order[k]) : AABB(bbox, triangleBounds(order[k]));
+	}
+
+	buildStats = builder.Stats();
+	maxDepth = buildStats.maxDepth;
+}
+
+size_t triangle_mesh::MemoryBytes() const
+{
+	return positions.capacity() * sizeof(float) + normals.capacity() * sizeof(float)
+		+ indices.capacity() * sizeof(uint32_t) + nodes.capacity() * sizeof(LinearBVHNode);
+}
+
+bool triangle_mesh::hit(const Ray& r, interval ray_t, hit_record& rec) const
+{
+	WatertightRay ray(r);
+	bool hitAnything = TraverseLinearBVH(nodes, maxDepth, r, ray_t, [&](const LinearBVHNode& node, interval& t)
+		{
+			bool hitLeaf = false;
+			for (uint32_t i = node.primitivesOffset; i < node.primitivesOffset + node.primitiveCount; ++i)
+			{
+				const uint32_t* triangle = &indices[static_cast<size_t>(i) * 3];
+				double tHit, b1, b2;
+				if (ray.Intersect(LoadVec3(positions, triangle[0]), LoadVec3(positions, triangle[1]),
+					LoadVec3(positions, triangle[2]), t, tHit, b1, b2))
+				{
+					hitLeaf = true;
+					t.max = tHit;
+					rec.t = tHit;
+					rec.u = b1;
+					rec.v = b2;
+					rec.primitive = i;
+				}
+			}
+			return hitLeaf;
+		});
+
+	if (hitAnything)
+	{
+		rec.mat = mat.get();
+		rec.object = this;
+	}
+	return hitAnything;
+}
+
+void triangle_mesh::FinalizeHit(const Ray& r, hit_record& rec) const
+{
+	const uint32_t* triangle = &indices[static_cast<size_t>(rec.primitive) * 3];
+	vec3 p0 = LoadVec3(positions, triangle[0]);
+	vec3 p1 = LoadVec3(positions, triangle[1]);
+	vec3 p2 = LoadVec3(positions, triangle[2]);
+
+	double b1 = rec.u;
+	double b2 = rec.v;
+	double b0 = 1.0 - b1 - b2;
+
+	// 用重心坐标插值得到的点比 r.at(t) 更贴近三角形所在平面
+	// 重心坐标之和为 1, 即使它们本身有误差, 点也还在平面上, 误差只来自插值的舍入
+	rec.p = b0 * p0 + b1 * p1 + b2 * p2;
+	rec.p_error = ErrorGamma(7) * (abs(b0 * p0) + abs(b1 * p1) + abs(b2 * p2));
+
+	vec3 geometricNormal = unit_vector(cross(p1 - p0, p2 - p0));
+	vec3 shadingNormal = geometricNormal;
+	if (!normals.empty())
+	{
+		shadingNormal = unit_vector(b0 * LoadVec3(normals, triangle[0]) + b1 * LoadVec3(normals, triangle[1])
+			+ b2 * LoadVec3(normals, triangle[2]));
+		// 模型的顶点法线指向外侧, 以它为准确定几何法线的朝向, 与三角形的环绕方向无关
+		if (dot(geometricNormal, shadingNormal) < 0)
+			geometricNormal = -geometricNormal;
+	}
+
+	// 正反面由几何法线判断, 着色使用插值法线
+	rec.geometric_normal = geometricNormal;
+	rec.front_face = dot(r.GetDirection(), geometricNormal) < 0;
+	rec.normal = rec.front_face ? shadingNormal : -shadingNormal;
+}
+
+bool LoadModelFile(const std::string& fileName, std::vector<point3>& positions, std::vector<vec3>& normals,
+	std::vector<uint32_t>& indices)
+{
+	auto in = OpenModelFile(fileName);
+	if (!in)
+	{
+		std::cerr << "ERROR: Could not open model file '" << fileName << "'.\n";
+		return false;
+	}
+
+	std::string vertexLabel, triangleLabel;
+	size_t vertexCount = 0, triangleCount = 0;
+	in >> vertexLabel >> vertexCount >> triangleLabel >> triangleCount;
+	if (!in || vertexLabel != "VertexCount:" || triangleLabel != "TriangleCount:")
+	{
+		std::cerr << "ERROR: '" << fileName << "' is not a model file.\n";
+		return false;
+	}
+
+	// 跳过 "VertexList (pos, normal)" 到 "{"
+	in.ignore(std::numeric_limits<std::streamsize>::max(), '{');
+	positions.resize(vertexCount);
+	normals.resize(vertexCount);
+	for (size_t i = 0; i < vertexCount && in; ++i)
+	{
+		double px, py, pz, nx, ny, nz;
+		in >> px >> py >> pz >> nx >> ny >> nz;
+		positions[i] = point3(px, py, pz);
+		normals[i] = vec3(nx, ny, nz);
+	}
+
+	// 跳过 "}", "TriangleList" 到 "{"
+	in.ignore(std::numeric_limits<std::streamsize>::max(), '{');
+	indices.resize(triangleCount * 3);
+	for (auto& index : indices)
+	{
+		if (!(in >> index))
+			break;
+	}
+
+	if (!in || std::any_of(indices.begin(), indices.end(), [&](uint32_t i) { return i >= vertexCount; }))
+	{
+		std::cerr << "ERROR: Failed to read model file '" << fileName << "'.\n";
+		return false;
+	}
+	return true;
+}
+
+shared_ptr<triangle_mesh> LoadTriangleMesh(const std::string& fileName, shared_ptr<Material> material)
+{
+	std::vector<point3> positions;
+	std::vector<vec3> normals;
+	std::vector<uint32_t> indices;
+	if (!LoadModelFile(fileName, positions, normals, indices))
+		return nullptr;
+
+	return make_shared<triangle_mesh>(positions, normals, std::move(indices), std::move(material));
+}
@@ -0,0 +1,60 @@
+#ifndef TRIANGLE_MESH_H
+#define TRIANGLE_MESH_H
+
+#include "Common/common.h"
+
+#include "BVHBuilder.h"
+#include "hittable.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// 三角形网格: 顶点和索引各存一份, 三角形不是单独的 hittable 对象
+// 内部自带一棵 BVH, 叶子直接引用按叶子顺序重排过的三角形, 整个网格对外只是一个图元
+class triangle_mesh :public hittable
+{
+public:
+	// indices 每三个一组构成一个三角形
+	// normals 为空时使用几何法线, 否则与 positions 一一对应, 在三角形内按重心坐标插值
+	// threadCount <= 0 时使用全部硬件线程构建 BVH
+	triangle_mesh(const std::vector<point3>& positions, const std::vector<vec3>& normals,
+		std::vector<uint32_t> indices, shared_ptr<Material> material,
+		BVHSplitMethod method = BVHSplitMethod::SAH, size_t maxLeafSize = BVHNode::DefaultMaxLeafSize,
+		int threadCount = 0);
+
+	bool hit(const Ray& r, interval ray_t, hit_record& rec)const override;
+	// rec.u, rec.v 为命中点的重心坐标 (第二, 第三个顶点的权重)
+	void FinalizeHit(const Ray& r, hit_record& rec)const override;
+	AABB BoundingBox()const override { return bbox; }
+
+	size_t VertexCount()const { return positions.size() / 3; }
+	size_t TriangleCount()const { return indices.size() / 3; }
+	size_t NodeCount()const { return nodes.size(); }
+	// 顶点, 索引和 BVH 节点占用的字节数
+	size_t MemoryBytes()const;
+	const BVHBuildStats& BuildStats()const { return buildStats; }
+	const shared_ptr<Material>& GetMaterial()const { return mat; }
+	void SetMaterial(shared_ptr<Material> material) { mat = std::move(material); }
+
+private:
+	// 顶点数据用 float 存放, 求交时转换为 double
+	std::vector<float> positions;	// xyz xyz ...
+	std::vector<float> normals;		// 与 positions 对应, 可能为空
+	std::vector<uint32_t> indices;	// 按 BVH 叶子顺序排列
+	std::vector<LinearBVHNode> nodes;
+	shared_ptr<Material> mat;
+	AABB bbox;
+	int maxDepth = 0;
+	BVHBuildStats buildStats;
+};
+
+// 读取 Models 目录下的文本模型 (VertexCount, TriangleCount, VertexList (pos, normal), TriangleList)
+// fileName 不是现有路径时依次在当前目录及上级目录的 Models 中查找
+// 读取失败时输出错误并返回 false
+bool LoadModelFile(const std::string& fileName, std::vector<point3>& positions, std::vector<vec3>& normals,
+	std::vector<uint32_t>& indices);
+// 同上, 失败时返回 nullptr
+shared_ptr<triangle_mesh> LoadTriangleMesh(const std::string& fileName, shared_ptr<Material> material);
+
+#endif // !TRIANGLE_MESH_H